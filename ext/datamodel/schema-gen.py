@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+#
+#	This program is free software: you can redistribute it and/or modify
+#	it under the terms of the GNU General Public License as published by
+#	the Free Software Foundation, either version 2 of the License, or
+#	(at your option) any later version.
+#
+#	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+#
+# turns a TR-069 data model document (cwmp-datamodel XML as published by
+# the Broadband Forum) into the schema table of freecwmpd; the lines are
+#
+#	SCHEMA_RANGE(min, max)
+#	SCHEMA_PARAM(path, writable, type, range, ranges, length)
+#	SCHEMA_OBJECT(path, writable)
+#
+# numbers have to fall into one of the SCHEMA_RANGE entries range to
+# range + ranges - 1, strings, base64 and hexBinary are checked against
+# length (0 for any); multi-instance objects that can be added to and
+# deleted from are listed as well, all other objects are implied by their
+# parameters
+
+import sys
+import xml.etree.ElementTree as ET
+
+INT64_MIN = '(-9223372036854775807LL - 1)'
+
+# type, min, max
+TYPES = {
+	'string': ('SCHEMA_STRING', None, None),
+	'int': ('SCHEMA_INT', -2**31, 2**31 - 1),
+	'unsignedInt': ('SCHEMA_UNSIGNED_INT', 0, 2**32 - 1),
+	'long': ('SCHEMA_LONG', -2**63, 2**63 - 1),
+	'unsignedLong': ('SCHEMA_UNSIGNED_LONG', 0, 2**64 - 1),
+	'boolean': ('SCHEMA_BOOLEAN', None, None),
+	'dateTime': ('SCHEMA_DATE_TIME', None, None),
+	'base64': ('SCHEMA_BASE64', None, None),
+	'hexBinary': ('SCHEMA_HEX_BINARY', None, None),
+}
+
+BOUNDS = dict((t, (lo, hi)) for t, lo, hi in TYPES.values())
+
+
+def die(msg):
+	sys.stderr.write('schema-gen: %s\n' % msg)
+	sys.exit(1)
+
+
+def local(tag):
+	return tag.rsplit('}', 1)[-1]
+
+
+def children(node, name):
+	return [c for c in node if local(c.tag) == name]
+
+
+def facets(node, type):
+	"""ranges and length given right below node, None where there are none"""
+	lo, hi = BOUNDS[type]
+	ranges = None
+	length = None
+
+	# several ranges or sizes are alternatives, not restrictions
+	for r in children(node, 'range'):
+		r_lo = r.get('minInclusive')
+		r_hi = r.get('maxInclusive')
+		ranges = (ranges or []) + [(
+			lo if r_lo is None else int(r_lo),
+			hi if r_hi is None else int(r_hi))]
+
+	for s in children(node, 'size'):
+		if s.get('maxLength') is None:
+			length = 0
+		elif length != 0:
+			length = max(length or 0, int(s.get('maxLength')))
+
+	return ranges, length
+
+
+def restrict(base, own):
+	"""facets of a derived type can only narrow those of its base"""
+	ranges, length = base
+	own_ranges, own_length = own
+
+	if own_ranges is not None:
+		if ranges is None:
+			ranges = own_ranges
+		else:
+			ranges = [(max(a, c), min(b, d))
+				  for a, b in ranges for c, d in own_ranges]
+
+	if own_length:
+		length = min(length, own_length) if length else own_length
+
+	return ranges, length
+
+
+def datatype_of(name, datatypes, where, seen):
+	"""type, ranges and length of a named dataType including its bases"""
+	if name not in datatypes:
+		die('%s uses unknown data type %s' % (where, name))
+	if name in seen:
+		die('%s uses the recursive data type %s' % (where, name))
+
+	d = datatypes[name]
+	seen = seen + (name,)
+
+	if d.get('base'):
+		type, ranges, length = datatype_of(d.get('base'), datatypes,
+						   where, seen)
+		return (type,) + restrict((ranges, length), facets(d, type))
+
+	return syntax_of(d, datatypes, where, seen)
+
+
+def syntax_of(node, datatypes, where, seen=()):
+	"""type, ranges and length of a syntax or dataType element"""
+	for c in node:
+		tag = local(c.tag)
+
+		if tag == 'dataType':
+			ref = c.get('ref') or c.get('base')
+			type, ranges, length = datatype_of(ref, datatypes, where,
+							   seen)
+			return (type,) + restrict((ranges, length), facets(c, type))
+
+		if tag in TYPES:
+			type = TYPES[tag][0]
+			return (type,) + facets(c, type)
+
+	die('%s has no supported syntax' % where)
+
+
+def ranges_of(type, ranges, where):
+	"""ranges clipped to the type, the bounds of the type without any"""
+	lo, hi = BOUNDS[type]
+	if lo is None:
+		return []
+
+	if ranges is None:
+		ranges = [(lo, hi)]
+
+	ranges = sorted(set((max(a, lo), min(b, hi)) for a, b in ranges))
+	ranges = [(a, b) for a, b in ranges if a <= b]
+	if not ranges:
+		die('%s has an empty range' % where)
+
+	return ranges
+
+
+def number(n):
+	if n == -2**63:
+		return INT64_MIN
+	if n >= 2**63:
+		return '%dULL' % n
+	return '%dLL' % n
+
+
+def main():
+	if len(sys.argv) != 2:
+		die('usage: schema-gen.py <datamodel.xml>')
+
+	root = ET.parse(sys.argv[1]).getroot()
+
+	datatypes = {}
+	for d in children(root, 'dataType'):
+		datatypes[d.get('name')] = d
+
+	out = [
+		'/* generated by schema-gen.py from %s, do not edit */' %
+		sys.argv[1].rsplit('/', 1)[-1],
+	]
+	range_next = 0
+
+	for model in children(root, 'model'):
+		for obj in children(model, 'object'):
+			name = obj.get('name')
+			if not name or not name.endswith('.'):
+				die('object %s has no full path' % name)
+
+			if name.endswith('.{i}.') and obj.get('access') == 'readWrite':
+				table = name[:-len('{i}.')]
+				out.append('SCHEMA_OBJECT("%s", true)' % table)
+				out.append('SCHEMA_OBJECT("%s", true)' % name)
+
+			for p in children(obj, 'parameter'):
+				path = name + p.get('name')
+				syntax = children(p, 'syntax')
+				if not syntax:
+					die('%s has no syntax' % path)
+
+				type, ranges, length = syntax_of(syntax[0], datatypes, path)
+				ranges = ranges_of(type, ranges, path)
+
+				for lo, hi in ranges:
+					out.append('SCHEMA_RANGE(%s, %s)' %
+						   (number(lo), number(hi)))
+				out.append('SCHEMA_PARAM("%s", %s, %s, %d, %d, %d)' %
+					   (path,
+					    'true' if p.get('access') == 'readWrite' else 'false',
+					    type, range_next, len(ranges), length or 0))
+				range_next += len(ranges)
+
+	sys.stdout.write('\n'.join(out) + '\n')
+
+
+if __name__ == '__main__':
+	main()
@@ -13,17 +13,17 @@ DEFINE_boolean 'last' false 'output only last line ; for parameters that tend to
 DEFINE_boolean 'debug' false 'give debug output' 'd'
 DEFINE_boolean 'dummy' false 'echo system commands' 'D'
 DEFINE_boolean 'force' false 'force getting values for certain parameters' 'f'
-DEFINE_string 'url' '' 'file to download [download only]' 'u'
-DEFINE_string 'size' '' 'size of file to download [download only]' 's'
+DEFINE_string 'provider' '*' 'space separated list of providers to load' 'p'
 
 FLAGS_HELP=`cat << EOF
 USAGE: $0 [flags] command [parameter] [values]
 command:
-  get [value|notification|tags|all]
-  set [value|notification|tag]
-  download
+  get [value|tags|all]
+  set [value|tag]
   factory_reset
   reboot
+  reload [service]
+  upgrade [image]
 EOF`
 
 FLAGS "$@" || exit 1
@@ -39,11 +39,7 @@ fi
 
 case "$1" in
 	set)
-		if [ "$2" = "notification" ]; then
-			__arg1="$3"
-			__arg2="$4"
-			action="set_notification"
-		elif [ "$2" = "tag" ]; then
+		if [ "$2" = "tag" ]; then
 			__arg1="$3"
 			__arg2="$4"
 			action="set_tag"
@@ -58,10 +54,7 @@ case "$1" in
 		fi
 		;;
 	get)
-		if [ "$2" = "notification" ]; then
-			__arg1="$3"
-			action="get_notification"
-		elif [ "$2" = "tags" ]; then
+		if [ "$2" = "tags" ]; then
 			__arg1="$3"
 			action="get_tags"
 		elif [ "$2" = "value" ]; then
@@ -75,15 +68,20 @@ case "$1" in
 			action="get_value"
 		fi
 		;;
-	download)
-		action="download"
-		;;
 	factory_reset)
 		action="factory_reset"
 		;;
 	reboot)
 		action="reboot"
 		;;
+	reload)
+		__arg1="$2"
+		action="reload"
+		;;
+	upgrade)
+		__arg1="$2"
+		action="upgrade"
+		;;
 esac
 
 if [ -z "$action" ]; then
@@ -103,10 +101,21 @@ get_value_functions=""
 set_value_functions=""
 handle_scripts() {
 	local section="$1"
+	local prefix get_functions set_functions
 	config_get prefix "$section" "prefix"
+	# sections owning a prefix are only loaded when asked for (the daemon
+	# routes every parameter to its owner) ; others are always loaded
+	if [ -n "$prefix" -a "${FLAGS_provider}" != "*" ]; then
+		case " ${FLAGS_provider} " in
+			*" $section "*) ;;
+			*) return ;;
+		esac
+	fi
 	config_list_foreach "$section" 'location' load_script
-	config_get get_value_functions "$section" "get_value_function"
-	config_get set_value_functions "$section" "set_value_function"
+	config_get get_functions "$section" "get_value_function"
+	config_get set_functions "$section" "set_value_function"
+	get_value_functions="$get_value_functions $get_functions"
+	set_value_functions="$set_value_functions $set_functions"
 }
 
 config_load freecwmp
@@ -136,16 +145,6 @@ if [ "$action" = "set_value" ]; then
 	done
 fi
 
-if [ "$action" = "get_notification" -o "$action" = "get_all" ]; then
-	freecwmp_get_parameter_notification "x_notification" "$__arg1"
-	freecwmp_notification_output "$__arg1" "$x_notification"
-fi
-
-if [ "$action" = "set_notification" ]; then
-	freecwmp_set_parameter_notification "$__arg1" "$__arg2"
-	/sbin/uci ${UCI_CONFIG_DIR:+-c $UCI_CONFIG_DIR} commit
-fi
-
 if [ "$action" = "get_tags" -o "$action" = "get_all" ]; then
 	freecwmp_get_parameter_tags "x_tags" "$__arg1"
 	freecwmp_tags_output "$__arg1" "$x_tags"
@@ -156,18 +155,6 @@ if [ "$action" = "set_tag" ]; then
 	/sbin/uci ${UCI_CONFIG_DIR:+-c $UCI_CONFIG_DIR} commit
 fi
 
-if [ "$action" = "download" ]; then
-
-	rm /tmp/freecwmp_download 2> /dev/null
-	wget -O /tmp/freecwmp_download "${FLAGS_url}" > /dev/null 2>&1
-
-	dl_size=`ls -l /tmp/freecwmp_download | awk '{ print $5 }'`
-	if [ ! "$dl_size" -eq "${FLAGS_size}" ]; then
-		rm /tmp/freecwmp_download 2> /dev/null
-		exit 1
-	fi
-fi
-
 if [ "$action" = "factory_reset" ]; then
 	if [ ${FLAGS_dummy} -eq ${FLAGS_TRUE} ]; then
 		echo "# factory_reset"
@@ -190,6 +177,44 @@ if [ "$action" = "reboot" ]; then
 	fi
 fi
 
+# sysupgrade keeps the configuration and reboots on its own
+if [ "$action" = "upgrade" ]; then
+	/sbin/uci ${UCI_CONFIG_DIR:+-c $UCI_CONFIG_DIR} set freecwmp.@local[0].event="boot"
+	/sbin/uci ${UCI_CONFIG_DIR:+-c $UCI_CONFIG_DIR} commit
+
+	if [ ${FLAGS_dummy} -eq ${FLAGS_TRUE} ]; then
+		echo "# upgrade $__arg1"
+	else
+		sync
+		/sbin/sysupgrade "$__arg1"
+	fi
+fi
+
+# interface:<name> brings the interface to the state its auto option asks
+# for, however often it was toggled in the meantime
+if [ "$action" = "reload" ]; then
+	if [ ${FLAGS_dummy} -eq ${FLAGS_TRUE} ]; then
+		echo "# reload $__arg1"
+	else
+		case "$__arg1" in
+			wifi)
+				/sbin/wifi
+				;;
+			interface:*)
+				__iface="${__arg1#interface:}"
+				if [ "`/sbin/uci ${UCI_CONFIG_DIR:+-c $UCI_CONFIG_DIR} get network.$__iface.auto 2> /dev/null`" = "0" ]; then
+					ifdown "$__iface"
+				else
+					ifup "$__iface"
+				fi
+				;;
+			*)
+				/etc/init.d/$__arg1 reload
+				;;
+		esac
+	fi
+fi
+
 if [ ${FLAGS_debug} -eq ${FLAGS_TRUE} ]; then
 	echo "[debug] exited at \"`date`\""
 fi
@@ -0,0 +1,154 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+/*
+ * sample plugin, serves Device.X_FREECWMP_Sample. out of memory; the
+ * instance numbers of Entry have holes on purpose
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freecwmp-plugin.h>
+
+#define SAMPLE_PREFIX	"Device.X_FREECWMP_Sample."
+#define SAMPLE_ENTRY	"Entry."
+#define SAMPLE_TEXT_LEN	64
+
+struct sample_entry {
+	unsigned long number;
+	const char *name;
+};
+
+static const struct sample_entry sample_entries[] = {
+	{ 2, "dsl" },
+	{ 5, "wifi" },
+	{ 9, "voip" },
+};
+
+static char greeting[SAMPLE_TEXT_LEN] = "hello";
+static char staged[SAMPLE_TEXT_LEN];
+static int dirty;
+
+#define SAMPLE_ENTRIES	(sizeof(sample_entries) / sizeof(*sample_entries))
+
+static const struct sample_entry *sample_entry_find(unsigned long number)
+{
+	size_t i;
+
+	for (i = 0; i < SAMPLE_ENTRIES; i++) {
+		if (sample_entries[i].number == number)
+			return &sample_entries[i];
+	}
+
+	return NULL;
+}
+
+static int sample_get(const char *path, char **value)
+{
+	const struct sample_entry *e;
+	const char *name = path + strlen(SAMPLE_PREFIX);
+	unsigned long n;
+	char *end;
+
+	if (!strcmp(name, "Greeting")) {
+		*value = strdup(greeting);
+	} else if (!strcmp(name, "EntryNumberOfEntries")) {
+		if (asprintf(value, "%zu", SAMPLE_ENTRIES) == -1)
+			return FREECWMP_PLUGIN_ERROR;
+	} else if (!strncmp(name, SAMPLE_ENTRY, strlen(SAMPLE_ENTRY))) {
+		name += strlen(SAMPLE_ENTRY);
+		n = strtoul(name, &end, 10);
+		e = sample_entry_find(n);
+		if (end == name || !e || strcmp(end, ".Name"))
+			return FREECWMP_PLUGIN_INVALID_NAME;
+		*value = strdup(e->name);
+	} else {
+		return FREECWMP_PLUGIN_INVALID_NAME;
+	}
+
+	return *value ? FREECWMP_PLUGIN_OK : FREECWMP_PLUGIN_ERROR;
+}
+
+static int sample_set(const char *path, const char *value)
+{
+	if (strcmp(path, SAMPLE_PREFIX "Greeting"))
+		return FREECWMP_PLUGIN_INVALID_NAME;
+
+	if (strlen(value) >= sizeof(staged))
+		return FREECWMP_PLUGIN_INVALID_VALUE;
+
+	strcpy(staged, value);
+	dirty = 1;
+	return FREECWMP_PLUGIN_OK;
+}
+
+static int sample_commit(void)
+{
+	if (!dirty)
+		return 0;
+
+	strcpy(greeting, staged);
+	dirty = 0;
+	return 0;
+}
+
+static void sample_abort(void)
+{
+	dirty = 0;
+}
+
+static int sample_instance(const char *object, unsigned long from,
+			   unsigned long *number)
+{
+	size_t i;
+
+	if (strcmp(object, SAMPLE_PREFIX SAMPLE_ENTRY))
+		return FREECWMP_PLUGIN_NONE;
+
+	*number = 0;
+	for (i = 0; i < SAMPLE_ENTRIES; i++) {
+		if (sample_entries[i].number >= from) {
+			*number = sample_entries[i].number;
+			break;
+		}
+	}
+
+	return FREECWMP_PLUGIN_OK;
+}
+
+static const struct freecwmp_plugin_param sample_params[] = {
+	{ SAMPLE_PREFIX, false },
+	{ SAMPLE_PREFIX "Greeting", true },
+	{ SAMPLE_PREFIX "EntryNumberOfEntries", false },
+	{ SAMPLE_PREFIX SAMPLE_ENTRY "{i}.Name", false },
+};
+
+static const struct freecwmp_plugin_provider sample_providers[] = {
+	{
+		.prefix = SAMPLE_PREFIX,
+		.get = sample_get,
+		.set = sample_set,
+		.commit = sample_commit,
+		.abort = sample_abort,
+		.instance = sample_instance,
+	},
+};
+
+const struct freecwmp_plugin freecwmp_plugin = {
+	.abi = FREECWMP_PLUGIN_ABI,
+	.name = "sample",
+	.params = sample_params,
+	.params_num = sizeof(sample_params) / sizeof(*sample_params),
+	.providers = sample_providers,
+	.providers_num = sizeof(sample_providers) / sizeof(*sample_providers),
+};
@@ -0,0 +1,336 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <net/if.h>
+#include <linux/rtnetlink.h>
+
+#include <libfreecwmp.h>
+
+#include "address.h"
+
+#include "config.h"
+#include "freecwmp.h"
+#include "iface.h"
+
+/* addresses an ACS should not be pointed at */
+#define ADDRESS_UNUSABLE	(IFA_F_SECONDARY | IFA_F_TENTATIVE | IFA_F_DEPRECATED)
+
+static int address_native_get(const char *path, char **value);
+
+static const struct address_param address_params[] = {
+	{
+		.native = {
+			.prefix = "InternetGatewayDevice.WANDevice.1.WANConnectionDevice.1.WANIPConnection.1.",
+			.get = address_native_get,
+		},
+		.name = "ExternalIPAddress",
+		.network = "mng",
+		.kind = ADDRESS_IP,
+		.override = "default_wan_device_mng_interface_ip",
+	},
+	{
+		.native = {
+			.prefix = "InternetGatewayDevice.ManagementServer.",
+			.get = address_native_get,
+		},
+		.name = "ConnectionRequestURL",
+		.network = "mng",
+		.kind = ADDRESS_URL,
+		.override = "default_management_server_connection_request_url",
+	},
+};
+
+static struct address *addresses;
+static size_t addresses_num;
+static size_t addresses_size;
+
+static struct address *address_lookup(const struct address *a)
+{
+	size_t i;
+
+	for (i = 0; i < addresses_num; i++) {
+		if (addresses[i].index == a->index &&
+		    addresses[i].family == a->family &&
+		    addresses[i].prefixlen == a->prefixlen &&
+		    !strcmp(addresses[i].ip, a->ip))
+			return &addresses[i];
+	}
+
+	return NULL;
+}
+
+static const char *address_device(int index, char *name)
+{
+	const char *dev = iface_name(index);
+
+	return dev ? dev : if_indextoname(index, name);
+}
+
+/* the connection request listener follows the address of its interface */
+static void address_local(const struct address *a)
+{
+	char name[IFNAMSIZ];
+	const char *dev;
+	char *ip;
+
+	if (a->family != AF_INET)
+		return;
+
+	dev = address_device(a->index, name);
+	if (!dev || strncmp(config->local->interface, dev, IFNAMSIZ))
+		return;
+
+	/* renewals announce the address we are already bound to */
+	if (config->local->ip && !strcmp(config->local->ip, a->ip))
+		return;
+
+	ip = strdup(a->ip);
+	if (!ip) return;
+	free(config->local->ip);
+	config->local->ip = ip;
+
+	freecwmp_log_message(NAME, L_NOTICE, "interface %s has ip %s\n", \
+			     dev, a->ip);
+	freecwmp_address_change();
+}
+
+/* the listener moves on to what is left of its interface, or to any */
+static void address_local_gone(const struct address *a)
+{
+	const struct address *next;
+	char *ip = NULL;
+
+	if (!config->local->ip || strcmp(config->local->ip, a->ip))
+		return;
+
+	next = address_find(config->local->interface, AF_INET);
+	if (next) {
+		ip = strdup(next->ip);
+		if (!ip) return;
+	}
+
+	free(config->local->ip);
+	config->local->ip = ip;
+
+	freecwmp_log_message(NAME, L_NOTICE, "ip %s is gone, using %s\n", \
+			     a->ip, ip ? ip : "*");
+	freecwmp_address_change();
+}
+
+void address_netlink(struct nlmsghdr *nlh)
+{
+	struct ifaddrmsg *ifa = (struct ifaddrmsg *) NLMSG_DATA(nlh);
+	struct rtattr *rta = IFA_RTA(ifa);
+	int len = IFA_PAYLOAD(nlh);
+	void *local = NULL, *addr = NULL;
+	struct address a, *e;
+
+	if (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6)
+		return;
+
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == IFA_LOCAL)
+			local = RTA_DATA(rta);
+		else if (rta->rta_type == IFA_ADDRESS)
+			addr = RTA_DATA(rta);
+	}
+
+	/* on point-to-point links IFA_ADDRESS is the peer, IFA_LOCAL our own */
+	if (local) addr = local;
+	if (!addr) return;
+
+	memset(&a, 0, sizeof(a));
+	a.index = ifa->ifa_index;
+	a.family = ifa->ifa_family;
+	a.prefixlen = ifa->ifa_prefixlen;
+	a.scope = ifa->ifa_scope;
+	a.flags = ifa->ifa_flags;
+	a.seen = true;
+	inet_ntop(a.family, addr, a.ip, sizeof(a.ip));
+
+	e = address_lookup(&a);
+
+	if (nlh->nlmsg_type == RTM_DELADDR) {
+		if (!e) return;
+		*e = addresses[--addresses_num];
+		address_local_gone(&a);
+		return;
+	}
+
+	/* refreshed lifetimes and resyncs report what we already know */
+	if (e) {
+		*e = a;
+		return;
+	}
+
+	if (addresses_num == addresses_size) {
+		size_t size = addresses_size ? addresses_size * 2 : 16;
+
+		e = realloc(addresses, size * sizeof(*addresses));
+		if (!e) {
+			D("couldn't keep track of a new address\n");
+			return;
+		}
+		addresses = e;
+		addresses_size = size;
+	}
+
+	addresses[addresses_num++] = a;
+	address_local(&a);
+}
+
+void address_begin(void)
+{
+	size_t i;
+
+	for (i = 0; i < addresses_num; i++)
+		addresses[i].seen = false;
+}
+
+void address_end(void)
+{
+	size_t i;
+
+	for (i = 0; i < addresses_num; ) {
+		if (!addresses[i].seen)
+			addresses[i] = addresses[--addresses_num];
+		else
+			i++;
+	}
+}
+
+/* first global address of dev that is neither secondary nor on its way out */
+const struct address *address_find(const char *dev, int family)
+{
+	int index;
+	size_t i;
+
+	index = iface_index(dev);
+	if (!index) index = if_nametoindex(dev);
+	if (!index) return NULL;
+
+	for (i = 0; i < addresses_num; i++) {
+		if (addresses[i].index == index &&
+		    addresses[i].family == family &&
+		    addresses[i].scope == RT_SCOPE_UNIVERSE &&
+		    !(addresses[i].flags & ADDRESS_UNUSABLE))
+			return &addresses[i];
+	}
+
+	return NULL;
+}
+
+/* value of "<name>=<value>" in the defaults, NULL if it is not set */
+static char *address_override(const char *name)
+{
+	char line[256], *v, *end;
+	size_t len = strlen(name);
+	FILE *fp;
+
+	fp = fopen(fc_address_defaults, "r");
+	if (!fp) return NULL;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (strncmp(line, name, len) || line[len] != '=')
+			continue;
+
+		v = line + len + 1;
+		v[strcspn(v, "\r\n")] = '\0';
+
+		end = v + strlen(v);
+		if ((*v == '"' || *v == '\'') && end > v + 1 && end[-1] == *v) {
+			end[-1] = '\0';
+			v++;
+		}
+
+		fclose(fp);
+		return *v ? strdup(v) : NULL;
+	}
+
+	fclose(fp);
+	return NULL;
+}
+
+static int address_native_get(const char *path, char **value)
+{
+	const struct address_param *p = NULL;
+	const struct address *a = NULL;
+	char dev[IFNAMSIZ];
+	char *ip;
+	size_t i, len;
+
+	for (i = 0; i < ARRAY_SIZE(address_params); i++) {
+		len = strlen(address_params[i].native.prefix);
+		if (!strncmp(path, address_params[i].native.prefix, len) &&
+		    !strcmp(path + len, address_params[i].name)) {
+			p = &address_params[i];
+			break;
+		}
+	}
+
+	/* everything else below these objects is up to the scripts */
+	if (!p) return PROVIDER_NATIVE_NONE;
+
+	*value = address_override(p->override);
+	if (*value) return PROVIDER_NATIVE_OK;
+
+	/* like the scripts, the URL is built on top of the ip override */
+	ip = p->kind == ADDRESS_URL ?
+		address_override("default_wan_device_mng_interface_ip") : NULL;
+	if (ip) {
+		if (!config->local->port)
+			*value = strdup("");
+		else if (asprintf(value, "http://%s:%s/", ip,
+				  config->local->port) == -1)
+			*value = NULL;
+		free(ip);
+		return *value ? PROVIDER_NATIVE_OK : PROVIDER_NATIVE_ERROR;
+	}
+
+	iface_network_device(p->network, true, dev, sizeof(dev));
+	if (*dev) {
+		a = address_find(dev, AF_INET);
+		if (!a && p->kind == ADDRESS_URL)
+			a = address_find(dev, AF_INET6);
+	}
+
+	if (p->kind == ADDRESS_IP || !a || !config->local->port) {
+		*value = strdup(p->kind == ADDRESS_IP && a ? a->ip : "");
+		return *value ? PROVIDER_NATIVE_OK : PROVIDER_NATIVE_ERROR;
+	}
+
+	if (asprintf(value, a->family == AF_INET6 ?
+		     "http://[%s]:%s/" : "http://%s:%s/",
+		     a->ip, config->local->port) == -1)
+		return PROVIDER_NATIVE_ERROR;
+
+	return PROVIDER_NATIVE_OK;
+}
+
+int address_init(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(address_params); i++) {
+		if (provider_native_register(&address_params[i].native))
+			return -1;
+	}
+
+	return 0;
+}
+
+void address_exit(void)
+{
+	free(addresses);
+	addresses = NULL;
+	addresses_num = addresses_size = 0;
+}
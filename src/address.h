@@ -0,0 +1,61 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_ADDRESS_H__
+#define _FREECWMP_ADDRESS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+
+#include "provider.h"
+
+/* IPv4 and IPv6 address of any link, as the kernel reported it */
+struct address {
+	int index;
+	int family;
+	uint8_t prefixlen;
+	uint8_t scope;
+	uint8_t flags;
+	char ip[INET6_ADDRSTRLEN];
+	bool seen;
+};
+
+enum address_kind {
+	ADDRESS_IP,
+	ADDRESS_URL,
+};
+
+/* parameter derived from the addresses of an uci network interface,
+ * unless the variable override is set in the defaults of the scripts */
+struct address_param {
+	struct provider_native native;
+	const char *name;
+	const char *network;
+	enum address_kind kind;
+	const char *override;
+};
+
+#ifdef DUMMY_MODE
+static char *fc_address_defaults = "./ext/openwrt/scripts/defaults";
+#else
+static char *fc_address_defaults = "/usr/share/freecwmp/defaults";
+#endif
+
+int address_init(void);
+void address_exit(void);
+void address_netlink(struct nlmsghdr *nlh);
+void address_begin(void);
+void address_end(void);
+
+const struct address *address_find(const char *dev, int family);
+
+#endif
+
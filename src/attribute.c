@@ -0,0 +1,317 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libfreecwmp.h>
+
+#include "attribute.h"
+
+#include "config.h"
+#include "freecwmp.h"
+
+struct attribute_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+};
+
+struct attribute_record {
+	uint8_t notification;
+	uint8_t access;
+	uint16_t len;
+};
+
+static struct attribute **buckets;
+static unsigned int buckets_size;
+static unsigned int attributes_num;
+
+static struct attribute *attribute_find(const char *path, size_t len,
+					uint32_t hash)
+{
+	struct attribute *a;
+
+	if (!buckets_size)
+		return NULL;
+
+	for (a = buckets[hash & (buckets_size - 1)]; a; a = a->next) {
+		if (a->hash == hash && a->len == len &&
+		    !memcmp(a->path, path, len))
+			return a;
+	}
+
+	return NULL;
+}
+
+static int attribute_grow(void)
+{
+	struct attribute **b, *a, *next;
+	unsigned int size, i;
+
+	size = buckets_size ? buckets_size * 2 : 64;
+	b = calloc(size, sizeof(*b));
+	if (!b) return -1;
+
+	for (i = 0; i < buckets_size; i++) {
+		for (a = buckets[i]; a; a = next) {
+			next = a->next;
+			a->next = b[a->hash & (size - 1)];
+			b[a->hash & (size - 1)] = a;
+		}
+	}
+
+	free(buckets);
+	buckets = b;
+	buckets_size = size;
+
+	return 0;
+}
+
+static struct attribute *attribute_insert(const char *path, size_t len,
+					  uint8_t notification, uint8_t access)
+{
+	struct attribute *a;
+	uint32_t hash;
+
+	if (len > UINT16_MAX)
+		return NULL;
+
+	hash = freecwmp_hash(path, len);
+	a = attribute_find(path, len, hash);
+	if (a) goto done;
+
+	if (attributes_num >= buckets_size && attribute_grow())
+		return NULL;
+
+	a = calloc(1, sizeof(*a) + len + 1);
+	if (!a) return NULL;
+
+	memcpy(a->path, path, len);
+	a->len = len;
+	a->hash = hash;
+	a->next = buckets[hash & (buckets_size - 1)];
+	buckets[hash & (buckets_size - 1)] = a;
+	attributes_num++;
+
+done:
+	a->notification = notification;
+	a->access = access;
+	return a;
+}
+
+/*
+ * single pass over path: the hash is extended one character at a time and
+ * probed at every dot boundary and at the end, the deepest hit wins
+ */
+void attribute_get(const char *path, uint8_t *notification, uint8_t *access)
+{
+	struct attribute *a, *match;
+	uint32_t hash = FREECWMP_HASH_INIT;
+	size_t i;
+
+	/* the empty path stands for the whole tree */
+	match = attribute_find(path, 0, hash);
+
+	for (i = 0; path[i]; i++) {
+		hash = freecwmp_hash_step(hash, path[i]);
+		if (path[i] != '.' && path[i + 1])
+			continue;
+
+		a = attribute_find(path, i + 1, hash);
+		if (a) match = a;
+	}
+
+	if (notification)
+		*notification = match ? match->notification : NOTIFICATION_OFF;
+	if (access)
+		*access = match ? match->access : 0;
+}
+
+/*
+ * negative values leave the attribute unchanged; changing an object path
+ * applies the change to everything below it
+ */
+int attribute_set(const char *path, int notification, int access)
+{
+	struct attribute *a;
+	uint8_t n, acc;
+	size_t len = strlen(path);
+	unsigned int i;
+
+	attribute_get(path, &n, &acc);
+	if (notification >= 0) n = notification;
+	if (access >= 0) acc = access;
+
+	if (!attribute_insert(path, len, n, acc))
+		return -1;
+
+	if (len && path[len - 1] != '.')
+		return 0;
+
+	for (i = 0; i < buckets_size; i++) {
+		for (a = buckets[i]; a; a = a->next) {
+			if (a->len <= len || memcmp(a->path, path, len))
+				continue;
+			if (notification >= 0) a->notification = notification;
+			if (access >= 0) a->access = access;
+		}
+	}
+
+	return 0;
+}
+
+/* drop everything at or below an object path, returns how many went */
+unsigned int attribute_remove(const char *path)
+{
+	struct attribute **p, *a;
+	size_t len = strlen(path);
+	unsigned int i, n = 0;
+
+	for (i = 0; i < buckets_size; i++) {
+		for (p = &buckets[i]; (a = *p); ) {
+			if (a->len < len || memcmp(a->path, path, len)) {
+				p = &a->next;
+				continue;
+			}
+			*p = a->next;
+			free(a);
+			n++;
+		}
+	}
+
+	attributes_num -= n;
+	return n;
+}
+
+/* the whole table goes into a temporary file which replaces the old one */
+int attribute_save(void)
+{
+	struct attribute_header h = { ATTRIBUTE_MAGIC, ATTRIBUTE_VERSION, 0 };
+	struct attribute_record r;
+	struct attribute *a;
+	unsigned int i;
+	char *tmp;
+	FILE *fp;
+
+	if (freecwmp_mkdir_parent(fc_attributes)) {
+		D("couldn't create directory for %s\n", fc_attributes);
+		return -1;
+	}
+
+	if (asprintf(&tmp, "%s.tmp", fc_attributes) == -1)
+		return -1;
+
+	fp = fopen(tmp, "w");
+	if (!fp) goto error;
+
+	h.count = attributes_num;
+	if (fwrite(&h, sizeof(h), 1, fp) != 1)
+		goto error_close;
+
+	for (i = 0; i < buckets_size; i++) {
+		for (a = buckets[i]; a; a = a->next) {
+			r.notification = a->notification;
+			r.access = a->access;
+			r.len = a->len;
+			if (fwrite(&r, sizeof(r), 1, fp) != 1 ||
+			    (a->len && fwrite(a->path, a->len, 1, fp) != 1))
+				goto error_close;
+		}
+	}
+
+	if (fflush(fp) || fsync(fileno(fp)))
+		goto error_close;
+
+	if (fclose(fp)) goto error;
+	if (rename(tmp, fc_attributes)) goto error;
+
+	free(tmp);
+	return 0;
+
+error_close:
+	fclose(fp);
+error:
+	D("couldn't save parameter attributes\n");
+	remove(tmp);
+	free(tmp);
+	return -1;
+}
+
+static int attribute_load(void)
+{
+	struct attribute_header h;
+	struct attribute_record r;
+	char path[UINT16_MAX];
+	FILE *fp;
+
+	fp = fopen(fc_attributes, "r");
+	if (!fp) return -1;
+
+	if (fread(&h, sizeof(h), 1, fp) != 1 ||
+	    h.magic != ATTRIBUTE_MAGIC || h.version != ATTRIBUTE_VERSION) {
+		D("%s is not a valid attribute file\n", fc_attributes);
+		goto error;
+	}
+
+	while (h.count--) {
+		if (fread(&r, sizeof(r), 1, fp) != 1 ||
+		    (r.len && fread(path, r.len, 1, fp) != 1))
+			goto error;
+
+		if (!attribute_insert(path, r.len, r.notification, r.access))
+			goto error;
+	}
+
+	fclose(fp);
+	return 0;
+
+error:
+	fclose(fp);
+	return -1;
+}
+
+static void attribute_import(char *parameter, int notification)
+{
+	attribute_set(parameter, notification, -1);
+}
+
+int attribute_init(void)
+{
+	if (access(fc_attributes, F_OK) == 0)
+		return attribute_load();
+
+	/* first start, take over what was kept in the uci config */
+	config_get_notifications(attribute_import);
+
+	if (attributes_num)
+		return attribute_save();
+
+	return 0;
+}
+
+void attribute_exit(void)
+{
+	struct attribute *a, *next;
+	unsigned int i;
+
+	for (i = 0; i < buckets_size; i++) {
+		for (a = buckets[i]; a; a = next) {
+			next = a->next;
+			free(a);
+		}
+	}
+
+	free(buckets);
+	buckets = NULL;
+	buckets_size = attributes_num = 0;
+}
+
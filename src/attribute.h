@@ -0,0 +1,58 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_ATTRIBUTE_H__
+#define _FREECWMP_ATTRIBUTE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef DUMMY_MODE
+static char *fc_attributes = "./ext/tmp/freecwmp_attributes";
+#else
+static char *fc_attributes = "/etc/freecwmp/attributes";
+#endif
+
+#define ATTRIBUTE_MAGIC		0x46434154	/* "FCAT" */
+#define ATTRIBUTE_VERSION	1
+
+enum attribute_notification {
+	NOTIFICATION_OFF = 0,
+	NOTIFICATION_PASSIVE = 1,
+	NOTIFICATION_ACTIVE = 2,
+};
+
+/* AccessList entries defined by TR-069 */
+#define ACCESS_SUBSCRIBER	0x01
+
+/*
+ * attributes are kept per path prefix (object path with trailing dot or
+ * parameter name), the deepest prefix of a parameter wins
+ */
+struct attribute {
+	struct attribute *next;
+	uint32_t hash;
+
+	uint8_t notification;
+	uint8_t access;
+
+	uint16_t len;
+	char path[];
+};
+
+int attribute_init(void);
+void attribute_exit(void);
+
+void attribute_get(const char *path, uint8_t *notification, uint8_t *access);
+int attribute_set(const char *path, int notification, int access);
+unsigned int attribute_remove(const char *path);
+int attribute_save(void);
+
+#endif
+
@@ -14,6 +14,9 @@
 
 #include "config.h"
 #include "cwmp.h"
+#include "mapping.h"
+#include "plugin.h"
+#include "provider.h"
 
 static bool first_run = true;
 static struct uci_context *uci_ctx;
@@ -339,6 +342,167 @@ next:
 	return 0;
 }
 
+static int config_init_transfer(void)
+{
+	struct uci_section *s;
+	struct uci_element *e;
+	struct uci_option *o;
+	char *end;
+	unsigned long v;
+
+	config->transfer->max_queued = 16;
+	config->transfer->max_concurrent = 1;
+	config->transfer->bandwidth = 0;
+
+	uci_foreach_element(&uci_freecwmp->sections, e) {
+		s = uci_to_section(e);
+		if (strcmp(s->type, "transfer") == 0)
+			goto section_found;
+	}
+	return 0;
+
+section_found:
+	uci_foreach_element(&s->options, e) {
+		o = uci_to_option(e);
+		if (o->type != UCI_TYPE_STRING)
+			continue;
+
+		v = strtoul(o->v.string, &end, 10);
+		if (*end) {
+			D("in section transfer %s has invalid value...\n", e->name);
+			return -1;
+		}
+
+		if (!strcmp(e->name, "max_queued") && v) {
+			config->transfer->max_queued = v;
+			DD("freecwmp.@transfer[0].max_queued=%lu\n", v);
+		} else if (!strcmp(e->name, "max_concurrent") && v) {
+			config->transfer->max_concurrent = v;
+			DD("freecwmp.@transfer[0].max_concurrent=%lu\n", v);
+		} else if (!strcmp(e->name, "bandwidth")) {
+			config->transfer->bandwidth = v;
+			DD("freecwmp.@transfer[0].bandwidth=%lu\n", v);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * every scripts section that declares prefixes is a provider; sections
+ * without prefixes are always loaded by the script, if they bring value
+ * functions they have to be asked for every parameter
+ */
+static int config_init_scripts(void)
+{
+	struct uci_section *s;
+	struct uci_element *e1, *e2, *e3;
+	bool prefix, functions;
+
+	provider_clear();
+
+	uci_foreach_element(&uci_freecwmp->sections, e1) {
+		s = uci_to_section(e1);
+		if (strcmp(s->type, "scripts"))
+			continue;
+
+		prefix = functions = false;
+
+		uci_foreach_element(&s->options, e2) {
+			if (!strcmp((uci_to_option(e2))->e.name, "prefix") &&
+			    (uci_to_option(e2))->type == UCI_TYPE_LIST) {
+				uci_foreach_element(&((uci_to_option(e2))->v.list), e3) {
+					if (provider_add(e3->name, s->e.name))
+						return -1;
+					DD("freecwmp.%s.prefix=%s\n", s->e.name, e3->name);
+					prefix = true;
+				}
+				continue;
+			}
+
+			if (!strcmp((uci_to_option(e2))->e.name, "get_value_function") ||
+			    !strcmp((uci_to_option(e2))->e.name, "set_value_function"))
+				functions = true;
+		}
+
+		if (functions && !prefix && provider_add("", s->e.name))
+			return -1;
+	}
+
+	provider_sort();
+
+	return 0;
+}
+
+/* a broken mapping section only costs its own parameter */
+static int config_init_mappings(void)
+{
+	struct uci_section *s;
+	struct uci_element *e;
+	const char *parameter, *uci, *c;
+	bool writable, hidden;
+
+	mapping_clear();
+
+	uci_foreach_element(&uci_freecwmp->sections, e) {
+		s = uci_to_section(e);
+		if (strcmp(s->type, "mapping"))
+			continue;
+
+		parameter = uci_lookup_option_string(uci_ctx, s, "parameter");
+		uci = uci_lookup_option_string(uci_ctx, s, "uci");
+		if (!parameter || !uci) {
+			D("mapping section %s lacks parameter or uci\n", s->e.name);
+			continue;
+		}
+
+		c = uci_lookup_option_string(uci_ctx, s, "writable");
+		writable = c && atoi(c);
+		c = uci_lookup_option_string(uci_ctx, s, "hidden");
+		hidden = c && atoi(c);
+
+		if (mapping_add(parameter, uci,
+				uci_lookup_option_string(uci_ctx, s, "type"),
+				uci_lookup_option_string(uci_ctx, s, "default"),
+				uci_lookup_option_string(uci_ctx, s, "service"),
+				writable, hidden))
+			continue;
+
+		DD("freecwmp.%s.uci=%s\n", s->e.name, uci);
+	}
+
+	mapping_sort();
+
+	return 0;
+}
+
+/* plugins are only loaded at start, later sections wait for a restart */
+static int config_init_plugins(void)
+{
+	struct uci_section *s;
+	struct uci_element *e;
+	const char *path;
+
+	uci_foreach_element(&uci_freecwmp->sections, e) {
+		s = uci_to_section(e);
+		if (strcmp(s->type, "plugin"))
+			continue;
+
+		path = uci_lookup_option_string(uci_ctx, s, "path");
+		if (!path) {
+			D("plugin section %s lacks path\n", s->e.name);
+			continue;
+		}
+
+		if (plugin_add(path))
+			return -1;
+
+		DD("freecwmp.%s.path=%s\n", s->e.name, path);
+	}
+
+	return 0;
+}
+
 int config_get_cwmp(char *parameter, char **value)
 {
 	struct uci_section *s;
@@ -372,6 +536,219 @@ int config_get_cwmp(char *parameter, char **value)
 	return 2;
 }
 
+/* notification lists kept by older versions in the notifications section */
+void config_get_notifications(void (*cb)(char *parameter, int notification))
+{
+	struct uci_section *s;
+	struct uci_element *e1, *e2, *e3;
+	struct uci_option *o;
+	int notification;
+
+	uci_foreach_element(&uci_freecwmp->sections, e1) {
+		s = uci_to_section(e1);
+		if (strcmp(s->type, "notifications"))
+			continue;
+
+		uci_foreach_element(&s->options, e2) {
+			o = uci_to_option(e2);
+			if (o->type != UCI_TYPE_LIST)
+				continue;
+
+			if (!strcmp(o->e.name, "passive"))
+				notification = 1;
+			else if (!strcmp(o->e.name, "active"))
+				notification = 2;
+			else
+				continue;
+
+			uci_foreach_element(&o->v.list, e3) {
+				DD("freecwmp.@notifications[0].%s=%s\n", o->e.name, e3->name);
+				cb(e3->name, notification);
+			}
+		}
+	}
+}
+
+/*
+ * access to the uci packages (network, dhcp, firewall, ...) that back
+ * natively handled objects; they share the context of the freecwmp
+ * package and stay loaded until they are explicitly reloaded
+ */
+struct uci_package *config_uci_load(const char *package, bool reload)
+{
+	struct uci_package *p;
+
+	if (!uci_ctx) return NULL;
+
+	p = uci_lookup_package(uci_ctx, package);
+	if (p && !reload)
+		return p;
+
+	if (p) uci_unload(uci_ctx, p);
+
+	p = NULL;
+	if (uci_load(uci_ctx, package, &p)) {
+		D("couldn't load uci package %s\n", package);
+		return NULL;
+	}
+
+	return p;
+}
+
+static int config_uci_lookup(struct uci_ptr *ptr, const char *package,
+			     const char *section, const char *option,
+			     const char *value)
+{
+	memset(ptr, 0, sizeof(*ptr));
+	ptr->package = package;
+	ptr->section = section;
+	ptr->option = option;
+	ptr->value = value;
+
+	if (!config_uci_load(package, false))
+		return -1;
+
+	if (uci_lookup_ptr(uci_ctx, ptr, NULL, false))
+		return -1;
+
+	return 0;
+}
+
+/* value is NULL when the option is not set */
+int config_uci_get(const char *package, const char *section,
+		   const char *option, char **value)
+{
+	struct uci_ptr ptr;
+
+	*value = NULL;
+
+	if (config_uci_lookup(&ptr, package, section, option, NULL))
+		return -1;
+
+	if (!(ptr.flags & UCI_LOOKUP_COMPLETE) || !ptr.o ||
+	    ptr.o->type != UCI_TYPE_STRING)
+		return 0;
+
+	*value = strdup(ptr.o->v.string);
+	return *value ? 0 : -1;
+}
+
+/* with option NULL a section of type value is created */
+int config_uci_set(const char *package, const char *section,
+		   const char *option, const char *value)
+{
+	struct uci_ptr ptr;
+
+	if (config_uci_lookup(&ptr, package, section, option, value))
+		return -1;
+
+	if (uci_set(uci_ctx, &ptr))
+		return -1;
+
+	return 0;
+}
+
+/* with option NULL the whole section is removed */
+int config_uci_delete(const char *package, const char *section,
+		      const char *option)
+{
+	struct uci_ptr ptr;
+
+	if (config_uci_lookup(&ptr, package, section, option, NULL))
+		return -1;
+
+	if (!(ptr.flags & UCI_LOOKUP_COMPLETE))
+		return 0;
+
+	if (uci_delete(uci_ctx, &ptr))
+		return -1;
+
+	return 0;
+}
+
+int config_uci_commit(const char *package)
+{
+	struct uci_package *p;
+
+	p = uci_lookup_package(uci_ctx, package);
+	if (!p) return 0;
+
+	if (uci_commit(uci_ctx, &p, false)) {
+		D("couldn't commit uci package %s\n", package);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * the same with the package.section.option notation of the uci command
+ * line, sections may be given as @type[index]
+ */
+static int config_uci_lookup_path(struct uci_ptr *ptr, char *path)
+{
+	memset(ptr, 0, sizeof(*ptr));
+
+	if (!uci_ctx) return -1;
+
+	if (uci_lookup_ptr(uci_ctx, ptr, path, true))
+		return -1;
+
+	return 0;
+}
+
+/* value is NULL when the option or its section is not there */
+int config_uci_get_path(const char *path, char **value)
+{
+	struct uci_ptr ptr;
+	char *c;
+	int rc = 0;
+
+	*value = NULL;
+
+	c = strdup(path);
+	if (!c) return -1;
+
+	if (config_uci_lookup_path(&ptr, c) ||
+	    !(ptr.flags & UCI_LOOKUP_COMPLETE) || !ptr.o ||
+	    ptr.o->type != UCI_TYPE_STRING)
+		goto out;
+
+	*value = strdup(ptr.o->v.string);
+	if (!*value) rc = -1;
+
+out:
+	free(c);
+	return rc;
+}
+
+/* an empty value removes the option */
+int config_uci_set_path(const char *path, const char *value)
+{
+	struct uci_ptr ptr;
+	char *c;
+	int rc = -1;
+
+	c = strdup(path);
+	if (!c) return -1;
+
+	if (config_uci_lookup_path(&ptr, c) || !ptr.s || !ptr.option)
+		goto out;
+
+	if (!*value) {
+		rc = (ptr.flags & UCI_LOOKUP_COMPLETE) ?
+		     uci_delete(uci_ctx, &ptr) : 0;
+		goto out;
+	}
+
+	ptr.value = value;
+	rc = uci_set(uci_ctx, &ptr);
+
+out:
+	free(c);
+	return rc ? -1 : 0;
+}
+
 static struct uci_package *
 config_init_package(const char *c)
 {
@@ -390,6 +767,9 @@ config_init_package(const char *c)
 
 		config->local = calloc(1, sizeof(struct local));
 		if (!config->local) goto error;
+
+		config->transfer = calloc(1, sizeof(struct transfer_limits));
+		if (!config->transfer) goto error;
 	}
 
 	if (!ctx) {
@@ -419,6 +799,7 @@ error:
 	FREE(config->acs);
 	FREE(config->device);
 	FREE(config->local);
+	FREE(config->transfer);
 	FREE(config);
 
 	return NULL;
@@ -437,6 +818,10 @@ void config_load(void)
 	if (config_init_local()) goto error;
 	if (config_init_acs()) goto error;
 	if (config_init_device()) goto error;
+	if (config_init_transfer()) goto error;
+	if (config_init_scripts()) goto error;
+	if (config_init_mappings()) goto error;
+	if (first_run && config_init_plugins()) goto error;
 
 	first_run = false;
 	return;
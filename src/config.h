@@ -16,6 +16,18 @@
 
 void config_load(void);
 int config_get_cwmp(char *parameter, char **value);
+void config_get_notifications(void (*cb)(char *parameter, int notification));
+
+struct uci_package *config_uci_load(const char *package, bool reload);
+int config_uci_get(const char *package, const char *section,
+		   const char *option, char **value);
+int config_uci_set(const char *package, const char *section,
+		   const char *option, const char *value);
+int config_uci_delete(const char *package, const char *section,
+		      const char *option);
+int config_uci_commit(const char *package);
+int config_uci_get_path(const char *path, char **value);
+int config_uci_set_path(const char *path, const char *value);
 
 struct acs {
 	char *scheme;
@@ -47,10 +59,18 @@ struct local {
 	char *ubus_socket;
 };
 
+/* optional, a missing transfer section keeps the defaults */
+struct transfer_limits {
+	unsigned int max_queued;
+	unsigned int max_concurrent;
+	unsigned long bandwidth;	/* kbit/s shared by all transfers, 0 is unlimited */
+};
+
 struct core_config {
 	struct acs *acs;
 	struct device *device;
 	struct local *local;
+	struct transfer_limits *transfer;
 };
 
 extern struct core_config *config;
@@ -7,32 +7,46 @@
  *	Copyright (C) 2011-2012 Luka Perkov <freecwmp@lukaperkov.net>
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <libfreecwmp.h>
 #include <libubox/uloop.h>
 
 #include "cwmp.h"
 
+#include "attribute.h"
 #include "config.h"
+#include "deferred.h"
 #include "external.h"
 #include "freecwmp.h"
 #include "http.h"
+#include "instance.h"
+#include "provider.h"
+#include "scheduler.h"
+#include "time.h"
+#include "transfer.h"
 #include "xml.h"
 
 struct cwmp_internal *cwmp;
 
-static struct uloop_timeout inform_timer = { .cb = cwmp_do_inform };
-static struct uloop_timeout periodic_inform_timer = { .cb = cwmp_periodic_inform };
+static struct scheduler_timer inform_timer = { .cb = cwmp_do_inform };
+static struct scheduler_timer retry_timer = { .cb = cwmp_do_inform };
+static struct scheduler_timer periodic_inform_timer = { .cb = cwmp_periodic_inform };
+static struct scheduler_timer heartbeat_timer = { .cb = cwmp_heartbeat };
+
+static LIST_HEAD(schedule_informs);
 
 pthread_mutex_t event_lock;
 pthread_mutex_t notification_lock;
 
-static void cwmp_periodic_inform(struct uloop_timeout *timeout)
+static void cwmp_periodic_inform(struct scheduler_timer *timer)
 {
 	if (cwmp->periodic_inform_enabled && cwmp->periodic_inform_interval) {
-		uloop_timeout_set(&periodic_inform_timer, cwmp->periodic_inform_interval * 1000);
+		cwmp_periodic_inform_schedule();
 		cwmp_add_event(PERIODIC, NULL);
 	}
 
@@ -40,11 +54,330 @@ static void cwmp_periodic_inform(struct uloop_timeout *timeout)
 		cwmp_inform();
 }
 
-static void cwmp_do_inform(struct uloop_timeout *timeout)
+/* deterministic per-device offset into the given interval */
+static uint64_t cwmp_interval_offset(uint64_t interval, bool spread)
+{
+	char *serial = config->device->serial_number;
+
+	if (!spread || !serial)
+		return 0;
+
+	return freecwmp_hash(serial, strlen(serial)) % interval;
+}
+
+/* seconds until the next multiple of interval counted from anchor */
+static uint64_t cwmp_interval_delay(time_t anchor, uint64_t interval,
+				    bool spread)
+{
+	time_t now = time(NULL);
+	uint64_t delay;
+
+	anchor += cwmp_interval_offset(interval, spread);
+
+	if (now < anchor)
+		delay = (anchor - now) % interval;
+	else
+		delay = interval - (now - anchor) % interval;
+
+	return delay ? delay : interval;
+}
+
+/*
+ * periodic informs are anchored to PeriodicInformTime (or to the epoch when
+ * it is unknown) so that the schedule does not depend on when the daemon
+ * was started or when the interval was changed
+ */
+static void cwmp_periodic_inform_schedule(void)
+{
+	uint64_t delay;
+
+	scheduler_timer_cancel(&periodic_inform_timer);
+
+	if (!cwmp->periodic_inform_enabled || !cwmp->periodic_inform_interval)
+		return;
+
+	delay = cwmp_interval_delay(cwmp->periodic_inform_time,
+				    cwmp->periodic_inform_interval,
+				    cwmp->periodic_inform_spread);
+
+	DD("next periodic inform in %llu seconds\n", (unsigned long long) delay);
+	scheduler_timer_set(&periodic_inform_timer, delay * 1000);
+}
+
+static void cwmp_heartbeat(struct scheduler_timer *timer)
+{
+	cwmp_heartbeat_schedule();
+	cwmp_heartbeat_inform();
+}
+
+static void cwmp_heartbeat_schedule(void)
+{
+	uint64_t delay;
+
+	scheduler_timer_cancel(&heartbeat_timer);
+
+	if (!cwmp->heartbeat_enabled || !cwmp->heartbeat_interval)
+		return;
+
+	delay = cwmp_interval_delay(cwmp->heartbeat_time,
+				    cwmp->heartbeat_interval,
+				    cwmp->heartbeat_spread);
+
+	DD("next heartbeat in %llu seconds\n", (unsigned long long) delay);
+	scheduler_timer_set(&heartbeat_timer, delay * 1000);
+}
+
+static void cwmp_do_inform(struct scheduler_timer *timer)
 {
 	cwmp_inform();
 }
 
+static void cwmp_retry_seed(void)
+{
+	static bool seeded = false;
+	unsigned int seed;
+	FILE *fp;
+
+	if (seeded) return;
+
+	/*
+	 * devices booting at the same moment must not pick the same retry
+	 * intervals, so don't rely on time alone
+	 */
+	seed = time(NULL) ^ getpid();
+	fp = fopen("/dev/urandom", "r");
+	if (fp) {
+		unsigned int r;
+		if (fread(&r, sizeof(r), 1, fp) == 1)
+			seed ^= r;
+		fclose(fp);
+	}
+
+	srandom(seed);
+	seeded = true;
+}
+
+static void cwmp_retry_load(void)
+{
+	FILE *fp;
+	int count;
+
+	fp = fopen(fc_retry_state, "r");
+	if (!fp) return;
+
+	if (fscanf(fp, "%d", &count) == 1 && count > 0)
+		cwmp->retry_count = count;
+
+	fclose(fp);
+}
+
+static void cwmp_retry_save(void)
+{
+	FILE *fp;
+
+	if (!cwmp->retry_count) {
+		if (access(fc_retry_state, F_OK) == 0)
+			remove(fc_retry_state);
+		return;
+	}
+
+	fp = fopen(fc_retry_state, "w");
+	if (!fp) {
+		D("couldn't save retry state\n");
+		return;
+	}
+
+	fprintf(fp, "%d\n", cwmp->retry_count);
+	fclose(fp);
+}
+
+/*
+ * wait interval for the given retry count as defined by TR-069 session
+ * retry policy; the interval is picked at random from the range
+ * [ m * (k/1000)^(n-1), m * (k/1000)^n ] where m is the minimum wait
+ * interval and k the interval multiplier
+ */
+static uint64_t cwmp_retry_interval(int count)
+{
+	uint64_t min, max;
+	int i;
+
+	if (count > CWMP_RETRY_MAX_COUNT)
+		count = CWMP_RETRY_MAX_COUNT;
+
+	min = (uint64_t) cwmp->retry_min_wait_interval * 1000;
+	for (i = 1; i < count; i++)
+		min = min * cwmp->retry_interval_multiplier / 1000;
+	max = min * cwmp->retry_interval_multiplier / 1000;
+
+	return min + random() % (max - min + 1);
+}
+
+static void cwmp_retry_config(void)
+{
+	char *c = NULL;
+	unsigned int v;
+
+	cwmp->retry_min_wait_interval = CWMP_RETRY_MIN_WAIT_INTERVAL;
+	cwmp->retry_interval_multiplier = CWMP_RETRY_INTERVAL_MULTIPLIER;
+
+	config_get_cwmp("InternetGatewayDevice.ManagementServer.CWMPRetryMinimumWaitInterval", &c);
+	if (c) {
+		v = atoi(c);
+		if (v >= 1 && v <= 65535)
+			cwmp->retry_min_wait_interval = v;
+		free(c);
+		c = NULL;
+	}
+
+	config_get_cwmp("InternetGatewayDevice.ManagementServer.CWMPRetryIntervalMultiplier", &c);
+	if (c) {
+		v = atoi(c);
+		if (v >= 1000 && v <= 65535)
+			cwmp->retry_interval_multiplier = v;
+		free(c);
+		c = NULL;
+	}
+}
+
+static void cwmp_schedule_inform_save(void)
+{
+	struct schedule_inform *si;
+	char *tmp;
+	FILE *fp;
+
+	if (list_empty(&schedule_informs)) {
+		if (access(fc_schedule_inform_state, F_OK) == 0)
+			remove(fc_schedule_inform_state);
+		return;
+	}
+
+	if (asprintf(&tmp, "%s.tmp", fc_schedule_inform_state) == -1)
+		return;
+
+	fp = fopen(tmp, "w");
+	if (!fp) {
+		D("couldn't save scheduled informs\n");
+		goto done;
+	}
+
+	list_for_each_entry(si, &schedule_informs, list)
+		fprintf(fp, "%lld %s\n", (long long) si->time,
+			si->key ? si->key : "");
+
+	if (fclose(fp) || rename(tmp, fc_schedule_inform_state)) {
+		D("couldn't save scheduled informs\n");
+		remove(tmp);
+	}
+
+done:
+	free(tmp);
+}
+
+static int cwmp_schedule_inform_add(time_t t, char *key)
+{
+	struct schedule_inform *si;
+	time_t now = time(NULL);
+
+	si = calloc(1, sizeof(*si));
+	if (!si) return -1;
+
+	si->time = t;
+	si->key = key && *key ? strdup(key) : NULL;
+	si->timer.cb = cwmp_schedule_inform_fire;
+	list_add_tail(&si->list, &schedule_informs);
+
+	scheduler_timer_set(&si->timer,
+			    t > now ? (uint64_t) (t - now) * 1000 : 0);
+	return 0;
+}
+
+/* schedules survive daemon restarts, overdue ones fire right away */
+static void cwmp_schedule_inform_load(void)
+{
+	static bool loaded = false;
+	char buf[256], *c;
+	long long t;
+	FILE *fp;
+	int n;
+
+	if (loaded) return;
+	loaded = true;
+
+	fp = fopen(fc_schedule_inform_state, "r");
+	if (!fp) return;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		c = strchr(buf, '\n');
+		if (c) *c = '\0';
+
+		n = 0;
+		if (sscanf(buf, "%lld %n", &t, &n) < 1 || !n)
+			continue;
+
+		cwmp_schedule_inform_add((time_t) t, buf + n);
+	}
+
+	fclose(fp);
+}
+
+/* (re)queue the events of all schedules that fired but were not reported */
+static void cwmp_schedule_inform_events(void)
+{
+	struct schedule_inform *si;
+
+	list_for_each_entry(si, &schedule_informs, list) {
+		if (!si->fired)
+			continue;
+		cwmp_add_event(SCHEDULED, NULL);
+		cwmp_add_event(EVENT_M_SCHEDULE_INFORM, si->key);
+	}
+}
+
+/* the ACS acknowledged the inform, drop everything that was reported */
+static void cwmp_schedule_inform_delivered(void)
+{
+	struct schedule_inform *si, *tmp;
+	bool changed = false;
+
+	list_for_each_entry_safe(si, tmp, &schedule_informs, list) {
+		if (!si->fired)
+			continue;
+		cwmp_remove_event(EVENT_M_SCHEDULE_INFORM, si->key);
+		list_del(&si->list);
+		free(si->key);
+		free(si);
+		changed = true;
+	}
+
+	if (!changed)
+		return;
+
+	cwmp_remove_event(SCHEDULED, NULL);
+	cwmp_schedule_inform_save();
+}
+
+static void cwmp_schedule_inform_fire(struct scheduler_timer *timer)
+{
+	struct schedule_inform *si;
+
+	si = container_of(timer, struct schedule_inform, timer);
+	si->fired = true;
+	cwmp_schedule_inform_events();
+
+	/* schedules expiring at the same tick share one session */
+	scheduler_timer_set(&inform_timer, 0);
+}
+
+int cwmp_schedule_inform(unsigned int delay, char *key)
+{
+	if (cwmp_schedule_inform_add(time(NULL) + delay, key))
+		return -1;
+
+	cwmp_schedule_inform_save();
+	return 0;
+}
+
 void cwmp_init(void)
 {
 	char *c = NULL;
@@ -52,18 +385,71 @@ void cwmp_init(void)
 	config_get_cwmp("InternetGatewayDevice.ManagementServer.PeriodicInformInterval", &c);
 	if (c) {
 		cwmp->periodic_inform_interval = atoi(c);
-		uloop_timeout_set(&periodic_inform_timer, cwmp->periodic_inform_interval * 1000);
 		free(c);
 		c = NULL;
 	}
 
 	config_get_cwmp("InternetGatewayDevice.ManagementServer.PeriodicInformEnable", &c);
 	if (c) {
-		cwmp->periodic_inform_enabled = atoi(c);
+		cwmp->periodic_inform_enabled = freecwmp_true(c);
+		free(c);
+		c = NULL;
+	}
+
+	config_get_cwmp("InternetGatewayDevice.ManagementServer.PeriodicInformTime", &c);
+	if (c) {
+		cwmp->periodic_inform_time = mix_parse_time(c);
 		free(c);
 		c = NULL;
 	}
 
+	config_get_cwmp("InternetGatewayDevice.ManagementServer.X_freecwmp_org__PeriodicInformSpread", &c);
+	if (c) {
+		cwmp->periodic_inform_spread = atoi(c);
+		free(c);
+		c = NULL;
+	}
+
+	cwmp_periodic_inform_schedule();
+
+	config_get_cwmp("InternetGatewayDevice.ManagementServer.HeartbeatPolicy.Enable", &c);
+	if (c) {
+		cwmp->heartbeat_enabled = freecwmp_true(c);
+		free(c);
+		c = NULL;
+	}
+
+	config_get_cwmp("InternetGatewayDevice.ManagementServer.HeartbeatPolicy.ReportingInterval", &c);
+	if (c) {
+		cwmp->heartbeat_interval = atoi(c);
+		if (cwmp->heartbeat_interval < CWMP_HEARTBEAT_MIN_INTERVAL)
+			cwmp->heartbeat_interval = CWMP_HEARTBEAT_MIN_INTERVAL;
+		free(c);
+		c = NULL;
+	}
+
+	config_get_cwmp("InternetGatewayDevice.ManagementServer.HeartbeatPolicy.InitiationTime", &c);
+	if (c) {
+		cwmp->heartbeat_time = mix_parse_time(c);
+		free(c);
+		c = NULL;
+	}
+
+	config_get_cwmp("InternetGatewayDevice.ManagementServer.HeartbeatPolicy.X_freecwmp_org__Spread", &c);
+	if (c) {
+		cwmp->heartbeat_spread = atoi(c);
+		free(c);
+		c = NULL;
+	}
+
+	cwmp_heartbeat_schedule();
+
+	cwmp_retry_config();
+	cwmp_retry_seed();
+	cwmp_retry_load();
+
+	cwmp_schedule_inform_load();
+
 	pthread_mutex_init(&event_lock, NULL);
 	pthread_mutex_init(&notification_lock, NULL);
 
@@ -87,6 +473,13 @@ int cwmp_inform(void)
 		goto error;
 	}
 
+	cwmp_schedule_inform_events();
+	transfer_queue_events();
+
+	/* uci sections may have been changed behind our back since last time */
+	if (instance_sync())
+		D("syncing instance numbers failed\n");
+
 	if (xml_prepare_inform_message(&msg_out)) {
 		D("xml message creating failed\n");
 		goto error;
@@ -106,6 +499,15 @@ int cwmp_inform(void)
 	FREE(msg_out);
 
 	cwmp->retry_count = 0;
+	cwmp_retry_save();
+	scheduler_timer_cancel(&retry_timer);
+
+	cwmp_schedule_inform_delivered();
+
+	if (transfer_complete()) {
+		D("sending transfer complete failed\n");
+		goto error;
+	}
 
 	if (cwmp_handle_messages()) {
 		D("handling xml message failed\n");
@@ -115,6 +517,7 @@ int cwmp_inform(void)
 	cwmp_clear_notifications();
 	http_client_exit();
 	xml_exit();
+	deferred_run();
 
 	return 0;
 
@@ -124,15 +527,67 @@ error:
 
 	http_client_exit();
 	xml_exit();
+	deferred_run();
 
 	cwmp->retry_count++;
-	if (cwmp->retry_count < 100) {
-		uloop_timeout_set(&inform_timer, 10000 * cwmp->retry_count);
-	} else {
-		/* try every 20 minutes */
-		uloop_timeout_set(&inform_timer, 1200000);
+	cwmp_retry_save();
+	scheduler_timer_set(&retry_timer, cwmp_retry_interval(cwmp->retry_count));
+
+	return -1;
+}
+
+/*
+ * heartbeat sessions carry only the HEARTBEAT event and no parameters;
+ * they neither touch the event queue nor the retry state, a failed
+ * heartbeat is simply superseded by the next one
+ */
+int cwmp_heartbeat_inform(void)
+{
+	char *msg_in, *msg_out;
+	msg_in = msg_out = NULL;
+
+	if (http_client_init()) {
+		D("initializing http client failed\n");
+		goto error;
 	}
 
+	if (xml_prepare_heartbeat_message(&msg_out)) {
+		D("xml message creating failed\n");
+		goto error;
+	}
+
+	if (http_send_message(msg_out, &msg_in)) {
+		D("sending http message failed\n");
+		goto error;
+	}
+
+	if (msg_in && xml_parse_inform_response_message(msg_in)) {
+		D("parse xml message from ACS failed\n");
+		goto error;
+	}
+
+	FREE(msg_in);
+	FREE(msg_out);
+
+	if (cwmp_handle_messages()) {
+		D("handling xml message failed\n");
+		goto error;
+	}
+
+	http_client_exit();
+	xml_exit();
+	deferred_run();
+
+	return 0;
+
+error:
+	FREE(msg_in);
+	FREE(msg_out);
+
+	http_client_exit();
+	xml_exit();
+	deferred_run();
+
 	return -1;
 }
 
@@ -178,11 +633,49 @@ error:
 	return -1;
 }
 
+/* start a session with whatever is queued, without touching the events */
+void cwmp_request_inform(void)
+{
+	scheduler_timer_set(&inform_timer, 0);
+}
+
 void cwmp_connection_request(int code)
 {
 	cwmp_clear_events();
 	cwmp_add_event(code, NULL);
-	uloop_timeout_set(&inform_timer, 500);
+	scheduler_timer_set(&inform_timer, 500);
+}
+
+const char *cwmp_str_event_code(int code)
+{
+	switch (code) {
+		case EVENT_HEARTBEAT:
+			return "14 HEARTBEAT";
+		case EVENT_M_SCHEDULE_INFORM:
+			return "M ScheduleInform";
+		case EVENT_M_DOWNLOAD:
+			return "M Download";
+		case EVENT_M_UPLOAD:
+			return "M Upload";
+		default:
+			return freecwmp_str_event_code(code);
+	}
+}
+
+/*
+ * single events are queued once; multiple ("M ...") events may be queued
+ * several times as long as they carry distinct command keys
+ */
+static bool cwmp_event_match(struct event *e, int code, char *key)
+{
+	if (e->code != code)
+		return false;
+
+	if (code != EVENT_M_SCHEDULE_INFORM && code != EVENT_M_DOWNLOAD &&
+	    code != EVENT_M_UPLOAD)
+		return true;
+
+	return !strcmp(e->key ? e->key : "", key ? key : "");
 }
 
 void cwmp_add_event(int code, char *key)
@@ -195,7 +688,7 @@ void cwmp_add_event(int code, char *key)
 
 	list_for_each(p, &cwmp->events) {
 		e = list_entry(p, struct event, list);
-		if (e->code == code) {
+		if (cwmp_event_match(e, code, key)) {
 			uniq = false;
 			break;
 		}
@@ -218,6 +711,23 @@ void cwmp_add_event(int code, char *key)
 	}
 }
 
+void cwmp_remove_event(int code, char *key)
+{
+	struct event *n, *p;
+
+	pthread_mutex_lock(&event_lock);
+
+	list_for_each_entry_safe(n, p, &cwmp->events, list) {
+		if (!cwmp_event_match(n, code, key))
+			continue;
+		list_del(&n->list);
+		free(n->key);
+		free(n);
+	}
+
+	pthread_mutex_unlock(&event_lock);
+}
+
 void cwmp_clear_events(void)
 {
 	struct event *n, *p;
@@ -235,9 +745,10 @@ void cwmp_clear_events(void)
 
 void cwmp_add_notification(char *parameter, char *value)
 {
-	char *c = NULL;
-	external_get_action("notification", parameter, &c);
-	if (!c) return;
+	uint8_t notification;
+
+	attribute_get(parameter, &notification, NULL);
+	if (notification == NOTIFICATION_OFF) return;
 
 	struct notification *n = NULL;
 	struct list_head *l, *p;
@@ -272,7 +783,7 @@ void cwmp_add_notification(char *parameter, char *value)
 
 
 	cwmp_add_event(VALUE_CHANGE, NULL);
-	if (!strncmp(c, "2", 1)) {
+	if (notification == NOTIFICATION_ACTIVE) {
 		cwmp_inform();
 	}
 }
@@ -293,17 +804,94 @@ void cwmp_clear_notifications(void)
 	pthread_mutex_unlock(&notification_lock);
 }
 
-int cwmp_set_parameter_write_handler(char *name, char *value)
+/*
+ * only values the daemon has at hand are compared, asking the scripts
+ * would cost a fork per parameter; write-only parameters such as
+ * passwords read back empty, so an empty current value never matches
+ */
+bool cwmp_parameter_unchanged(char *name, char *value)
+{
+	char *current = NULL;
+	bool unchanged;
+
+	if (provider_native_get(name, &current) &&
+	    config_get_cwmp(name, &current))
+		return false;
+
+	unchanged = current && *current && !strcmp(current, value);
+	free(current);
+
+	return unchanged;
+}
+
+/* runtime state that follows a parameter, once its new value is committed */
+void cwmp_parameter_applied(char *name, char *value)
 {
 	if((strcmp(name, "InternetGatewayDevice.ManagementServer.PeriodicInformEnable")) == 0) {
-		cwmp->periodic_inform_enabled = atoi(value);
+		cwmp->periodic_inform_enabled = freecwmp_true(value);
+		cwmp_periodic_inform_schedule();
 	}
 
 	if((strcmp(name, "InternetGatewayDevice.ManagementServer.PeriodicInformInterval")) == 0) {
 		cwmp->periodic_inform_interval = atoi(value);
-		uloop_timeout_set(&periodic_inform_timer, cwmp->periodic_inform_interval * 1000);
+		cwmp_periodic_inform_schedule();
+	}
+
+	if((strcmp(name, "InternetGatewayDevice.ManagementServer.PeriodicInformTime")) == 0) {
+		cwmp->periodic_inform_time = mix_parse_time(value);
+		cwmp_periodic_inform_schedule();
+	}
+
+	if((strcmp(name, "InternetGatewayDevice.ManagementServer.X_freecwmp_org__PeriodicInformSpread")) == 0) {
+		cwmp->periodic_inform_spread = atoi(value);
+		cwmp_periodic_inform_schedule();
+	}
+
+	if((strcmp(name, "InternetGatewayDevice.ManagementServer.HeartbeatPolicy.Enable")) == 0) {
+		cwmp->heartbeat_enabled = freecwmp_true(value);
+		cwmp_heartbeat_schedule();
 	}
 
+	if((strcmp(name, "InternetGatewayDevice.ManagementServer.HeartbeatPolicy.ReportingInterval")) == 0) {
+		cwmp->heartbeat_interval = atoi(value);
+		if (cwmp->heartbeat_interval < CWMP_HEARTBEAT_MIN_INTERVAL)
+			cwmp->heartbeat_interval = CWMP_HEARTBEAT_MIN_INTERVAL;
+		cwmp_heartbeat_schedule();
+	}
+
+	if((strcmp(name, "InternetGatewayDevice.ManagementServer.HeartbeatPolicy.InitiationTime")) == 0) {
+		cwmp->heartbeat_time = mix_parse_time(value);
+		cwmp_heartbeat_schedule();
+	}
+
+	if((strcmp(name, "InternetGatewayDevice.ManagementServer.HeartbeatPolicy.X_freecwmp_org__Spread")) == 0) {
+		cwmp->heartbeat_spread = atoi(value);
+		cwmp_heartbeat_schedule();
+	}
+
+	if((strcmp(name, "InternetGatewayDevice.ManagementServer.CWMPRetryMinimumWaitInterval")) == 0) {
+		if (atoi(value) >= 1 && atoi(value) <= 65535)
+			cwmp->retry_min_wait_interval = atoi(value);
+	}
+
+	if((strcmp(name, "InternetGatewayDevice.ManagementServer.CWMPRetryIntervalMultiplier")) == 0) {
+		if (atoi(value) >= 1000 && atoi(value) <= 65535)
+			cwmp->retry_interval_multiplier = atoi(value);
+	}
+}
+
+/*
+ * stage a value with its provider; PROVIDER_NATIVE_INVALID_NAME and
+ * PROVIDER_NATIVE_INVALID_VALUE refuse the parameter, -1 the session
+ */
+int cwmp_set_parameter_write_handler(char *name, char *value)
+{
+	int rc;
+
+	rc = provider_native_set(name, value);
+	if (rc != PROVIDER_NATIVE_NONE)
+		return rc;
+
 	return external_set_action_write("value", name, value);
 }
 
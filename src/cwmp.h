@@ -12,6 +12,32 @@
 
 #include <libubox/uloop.h>
 
+#include "scheduler.h"
+
+#ifdef DUMMY_MODE
+static char *fc_retry_state = "./ext/tmp/freecwmp_retry";
+static char *fc_schedule_inform_state = "./ext/tmp/freecwmp_schedule_inform";
+#else
+static char *fc_retry_state = "/tmp/freecwmp_retry";
+static char *fc_schedule_inform_state = "/tmp/freecwmp_schedule_inform";
+#endif
+
+/* TR-069 session retry defaults (CWMPRetry* parameters) */
+#define CWMP_RETRY_MIN_WAIT_INTERVAL	5
+#define CWMP_RETRY_INTERVAL_MULTIPLIER	2000
+#define CWMP_RETRY_MAX_COUNT		10
+
+/* HeartbeatPolicy.ReportingInterval lower bound */
+#define CWMP_HEARTBEAT_MIN_INTERVAL	20
+
+/* event codes libfreecwmp does not know about */
+enum cwmp_event_code {
+	EVENT_HEARTBEAT = 0x100,
+	EVENT_M_SCHEDULE_INFORM,
+	EVENT_M_DOWNLOAD,
+	EVENT_M_UPLOAD,
+};
+
 struct event {
 	struct list_head list;
 
@@ -19,6 +45,15 @@ struct event {
 	char *key;
 };
 
+struct schedule_inform {
+	struct list_head list;
+	struct scheduler_timer timer;
+
+	time_t time;
+	bool fired;
+	char *key;
+};
+
 struct notification {
 	struct list_head list;
 
@@ -30,7 +65,15 @@ struct notification {
 struct cwmp_internal {
 	int periodic_inform_enabled;
 	uint64_t periodic_inform_interval;
+	time_t periodic_inform_time;
+	bool periodic_inform_spread;
+	int heartbeat_enabled;
+	uint64_t heartbeat_interval;
+	time_t heartbeat_time;
+	bool heartbeat_spread;
 	int retry_count;
+	unsigned int retry_min_wait_interval;
+	unsigned int retry_interval_multiplier;
 	struct list_head events;
 	struct list_head notifications;
 };
@@ -39,23 +82,34 @@ extern struct cwmp_internal *cwmp;
 extern pthread_mutex_t event_lock;
 extern pthread_mutex_t notification_lock;
 
-static void cwmp_periodic_inform(struct uloop_timeout *timeout);
-static void cwmp_do_inform(struct uloop_timeout *timeout);
+static void cwmp_periodic_inform(struct scheduler_timer *timer);
+static void cwmp_periodic_inform_schedule(void);
+static void cwmp_do_inform(struct scheduler_timer *timer);
+static void cwmp_heartbeat(struct scheduler_timer *timer);
+static void cwmp_heartbeat_schedule(void);
+static void cwmp_schedule_inform_fire(struct scheduler_timer *timer);
 
 void cwmp_init(void);
 void cwmp_exit(void);
 
 int cwmp_inform(void);
+void cwmp_request_inform(void);
+int cwmp_heartbeat_inform(void);
 int cwmp_handle_messages(void);
 void cwmp_connection_request(int code);
+int cwmp_schedule_inform(unsigned int delay, char *key);
 
+const char *cwmp_str_event_code(int code);
 void cwmp_add_event(int code, char *key);
+void cwmp_remove_event(int code, char *key);
 void cwmp_clear_events(void);
 
 void cwmp_add_notification(char *parameter, char *value);
 void cwmp_clear_notifications(void);
 
+bool cwmp_parameter_unchanged(char *name, char *value);
 int cwmp_set_parameter_write_handler(char *name, char *value);
+void cwmp_parameter_applied(char *name, char *value);
 
 #endif
 
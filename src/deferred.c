@@ -0,0 +1,205 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libfreecwmp.h>
+
+#include "deferred.h"
+
+#include "external.h"
+#include "freecwmp.h"
+#include "scheduler.h"
+
+static void deferred_reload_next(struct scheduler_timer *timer);
+
+/* queued within the current session */
+static LIST_HEAD(deferred);
+
+/* reloads left from past sessions, run one at a time */
+static LIST_HEAD(reloads);
+static struct scheduler_timer reload_timer = {
+	.cb = deferred_reload_next,
+};
+static uint64_t reload_last;
+
+static struct deferred *deferred_find(struct list_head *head,
+				      enum deferred_type type, const char *arg)
+{
+	struct deferred *d;
+
+	list_for_each_entry(d, head, list) {
+		if (d->type == type && !strcmp(d->arg, arg))
+			return d;
+	}
+
+	return NULL;
+}
+
+/*
+ * the network comes first so the services reloaded after it find their
+ * interfaces already set up
+ */
+static void deferred_insert(struct deferred *d, struct list_head *head)
+{
+	if (d->type == DEFERRED_RELOAD && !strcmp(d->arg, "network"))
+		list_add(&d->list, head);
+	else
+		list_add_tail(&d->list, head);
+}
+
+static void deferred_free_all(struct list_head *head)
+{
+	struct deferred *d;
+
+	while (!list_empty(head)) {
+		d = list_first_entry(head, struct deferred, list);
+		list_del(&d->list);
+		free(d);
+	}
+}
+
+/* every action is queued once, no matter how many parameters asked for it */
+int deferred_add(enum deferred_type type, const char *arg)
+{
+	struct deferred *d;
+
+	if (!arg)
+		arg = "";
+
+	if (deferred_find(&deferred, type, arg))
+		return 0;
+
+	d = calloc(1, sizeof(*d) + strlen(arg) + 1);
+	if (!d) return -1;
+
+	d->type = type;
+	strcpy(d->arg, arg);
+	deferred_insert(d, &deferred);
+
+	return 0;
+}
+
+/* pick up the reloads the set scripts asked for */
+int deferred_add_requested(void)
+{
+	char line[64];
+	FILE *fp;
+	int rc = 0;
+
+	fp = fopen(fc_deferred_reload, "r");
+	if (!fp) return 0;
+
+	while (fgets(line, sizeof(line), fp)) {
+		line[strcspn(line, "\n")] = '\0';
+		if (*line && deferred_add(DEFERRED_RELOAD, line))
+			rc = -1;
+	}
+
+	fclose(fp);
+	remove(fc_deferred_reload);
+
+	return rc;
+}
+
+static void deferred_execute(struct deferred *d)
+{
+	switch (d->type) {
+	case DEFERRED_RELOAD:
+		external_reload(d->arg);
+		break;
+	case DEFERRED_REBOOT:
+		external_simple("reboot");
+		break;
+	case DEFERRED_UPGRADE:
+		external_upgrade(d->arg);
+		break;
+	case DEFERRED_FACTORY_RESET:
+		external_simple("factory_reset");
+		break;
+	}
+}
+
+static void deferred_reload_next(struct scheduler_timer *timer)
+{
+	struct deferred *d;
+
+	if (list_empty(&reloads))
+		return;
+
+	d = list_first_entry(&reloads, struct deferred, list);
+	list_del(&d->list);
+
+	reload_last = scheduler_msecs();
+	deferred_execute(d);
+	free(d);
+
+	if (!list_empty(&reloads))
+		scheduler_timer_set(&reload_timer, DEFERRED_RELOAD_SPACING);
+}
+
+/*
+ * reloads are spaced out, so back to back sessions do not bounce services
+ * in quick succession; a reload still waiting covers later requests too
+ */
+static void deferred_reload_schedule(void)
+{
+	struct deferred *d, *tmp;
+	uint64_t now, delay = 0;
+
+	list_for_each_entry_safe(d, tmp, &deferred, list) {
+		list_del(&d->list);
+		if (deferred_find(&reloads, d->type, d->arg))
+			free(d);
+		else
+			deferred_insert(d, &reloads);
+	}
+
+	if (list_empty(&reloads) || reload_timer.pending)
+		return;
+
+	now = scheduler_msecs();
+	if (reload_last && now < reload_last + DEFERRED_RELOAD_SPACING)
+		delay = reload_last + DEFERRED_RELOAD_SPACING - now;
+
+	scheduler_timer_set(&reload_timer, delay);
+}
+
+/* called after the session is closed, whether it went well or not */
+void deferred_run(void)
+{
+	struct deferred *d;
+	enum deferred_type heaviest = DEFERRED_RELOAD;
+
+	list_for_each_entry(d, &deferred, list) {
+		if (d->type > heaviest)
+			heaviest = d->type;
+	}
+
+	if (heaviest == DEFERRED_RELOAD) {
+		deferred_reload_schedule();
+		return;
+	}
+
+	/* whatever was waiting to be reloaded comes up fresh anyway */
+	scheduler_timer_cancel(&reload_timer);
+	deferred_free_all(&reloads);
+
+	list_for_each_entry(d, &deferred, list) {
+		if (d->type == heaviest) {
+			deferred_execute(d);
+			break;
+		}
+	}
+
+	deferred_free_all(&deferred);
+}
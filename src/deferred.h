@@ -0,0 +1,48 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_DEFERRED_H__
+#define _FREECWMP_DEFERRED_H__
+
+#include <libubox/list.h>
+
+/* services the set scripts want reloaded, one name per line */
+#ifdef DUMMY_MODE
+static char *fc_deferred_reload = "./ext/tmp/freecwmp_reload";
+#else
+static char *fc_deferred_reload = "/tmp/freecwmp_reload";
+#endif
+
+/* least time between the start of two reloads, in ms */
+#define DEFERRED_RELOAD_SPACING	5000
+
+/*
+ * disruptive work requested within a session, carried out once the
+ * session is over; ordered by weight, a queued action makes all lighter
+ * ones pointless
+ */
+enum deferred_type {
+	DEFERRED_RELOAD,
+	DEFERRED_REBOOT,
+	DEFERRED_UPGRADE,	/* flashes the image given as arg, then reboots */
+	DEFERRED_FACTORY_RESET,
+};
+
+struct deferred {
+	struct list_head list;
+	enum deferred_type type;
+	char arg[];
+};
+
+int deferred_add(enum deferred_type type, const char *arg);
+int deferred_add_requested(void);
+void deferred_run(void);
+
+#endif
+
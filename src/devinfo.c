@@ -0,0 +1,367 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libfreecwmp.h>
+
+#include "devinfo.h"
+
+#include "freecwmp.h"
+#include "provider.h"
+#include "scheduler.h"
+
+static int devinfo_igd_get(const char *path, char **value);
+static int devinfo_native_get(const char *path, char **value);
+
+/* everything else of DeviceInfo is up to the mappings and the scripts */
+static const struct provider_native devinfo_natives[] = {
+	{
+		.prefix = "InternetGatewayDevice.DeviceInfo.",
+		.get = devinfo_igd_get,
+	},
+	{
+		.prefix = DEVINFO_PREFIX,
+		.get = devinfo_native_get,
+	},
+};
+
+/* shared by all reads, nothing here keeps a file around */
+static char buffer[DEVINFO_BUFFER_SIZE];
+
+static struct devinfo_process *processes;
+static size_t processes_num;
+static size_t processes_size;
+static uint64_t processes_sampled;
+
+static struct devinfo_cpu cpu_last;
+static uint64_t cpu_sampled;
+static unsigned int cpu_usage;
+
+static long clock_ticks;
+
+/* proc files are generated on read, a single read gets all of them */
+static int devinfo_read(const char *file)
+{
+	char path[DEVINFO_PATH_MAX];
+	ssize_t len;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", fc_devinfo_proc, file);
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+
+	len = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+
+	if (len < 0) return -1;
+
+	buffer[len] = '\0';
+	return 0;
+}
+
+static int devinfo_uptime(unsigned long *uptime)
+{
+	if (devinfo_read("uptime"))
+		return -1;
+
+	*uptime = strtoul(buffer, NULL, 10);
+	return 0;
+}
+
+static int devinfo_meminfo(const char *key, unsigned long *kib)
+{
+	char *c;
+
+	if (devinfo_read("meminfo"))
+		return -1;
+
+	c = strstr(buffer, key);
+	if (!c) return -1;
+
+	*kib = strtoul(c + strlen(key), NULL, 10);
+	return 0;
+}
+
+/* user nice system idle iowait irq softirq steal */
+static int devinfo_cpu_read(struct devinfo_cpu *cpu)
+{
+	uint64_t v;
+	char *c, *end;
+	int i;
+
+	if (devinfo_read("stat") || strncmp(buffer, "cpu ", 4))
+		return -1;
+
+	memset(cpu, 0, sizeof(*cpu));
+
+	for (c = buffer + 4, i = 0; i < 8; c = end, i++) {
+		v = strtoull(c, &end, 10);
+		if (end == c)
+			break;
+
+		cpu->total += v;
+		if (i != 3 && i != 4)
+			cpu->busy += v;
+	}
+
+	return i < 4 ? -1 : 0;
+}
+
+/* the first sample can only tell the average since boot */
+static int devinfo_cpu_usage(unsigned int *usage)
+{
+	uint64_t now = scheduler_msecs();
+	struct devinfo_cpu cpu;
+	uint64_t busy, total;
+
+	if (cpu_sampled && now - cpu_sampled < DEVINFO_CPU_MSECS) {
+		*usage = cpu_usage;
+		return 0;
+	}
+
+	if (devinfo_cpu_read(&cpu))
+		return -1;
+
+	busy = cpu.busy - cpu_last.busy;
+	total = cpu.total - cpu_last.total;
+	if (total)
+		cpu_usage = busy * 100 / total;
+
+	cpu_last = cpu;
+	cpu_sampled = now;
+
+	*usage = cpu_usage;
+	return 0;
+}
+
+static const char *devinfo_state(char state)
+{
+	switch (state) {
+	case 'R':
+		return "Running";
+	case 'S':
+		return "Sleeping";
+	case 'D':
+		return "Uninterruptible";
+	case 'T':
+	case 't':
+		return "Stopped";
+	case 'Z':
+	case 'X':
+		return "Zombie";
+	default:
+		return "Idle";
+	}
+}
+
+/* pid (comm) state ... in one pass, comm may contain anything */
+static int devinfo_process_parse(struct devinfo_process *p)
+{
+	unsigned long utime, stime, vsize;
+	long priority;
+	char *start, *end, state;
+	size_t len;
+
+	start = strchr(buffer, '(');
+	end = strrchr(buffer, ')');
+	if (!start || !end || end < start)
+		return -1;
+
+	if (sscanf(end + 1, " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+		   "%lu %lu %*d %*d %ld %*d %*d %*d %*u %lu",
+		   &state, &utime, &stime, &priority, &vsize) != 5)
+		return -1;
+
+	len = end - start - 1;
+	if (len >= sizeof(p->command))
+		len = sizeof(p->command) - 1;
+	memcpy(p->command, start + 1, len);
+	p->command[len] = '\0';
+
+	p->state = state;
+	p->priority = priority < 0 ? 0 : priority > 99 ? 99 : priority;
+	p->size = vsize / 1024;
+	p->cpu_time = (utime + stime) * 1000 / clock_ticks;
+
+	return 0;
+}
+
+static int devinfo_processes_refresh(void)
+{
+	uint64_t now = scheduler_msecs();
+	struct devinfo_process *p;
+	char file[DEVINFO_PATH_MAX];
+	struct dirent *d;
+	DIR *dir;
+
+	if (processes_sampled && now - processes_sampled < DEVINFO_CACHE_MSECS)
+		return 0;
+
+	dir = opendir(fc_devinfo_proc);
+	if (!dir) return -1;
+
+	processes_num = 0;
+
+	while ((d = readdir(dir))) {
+		if (!isdigit(*d->d_name))
+			continue;
+
+		if (processes_num == processes_size) {
+			size_t size = processes_size ? processes_size * 2 : 64;
+			p = realloc(processes, size * sizeof(*processes));
+			if (!p) {
+				closedir(dir);
+				return -1;
+			}
+			processes = p;
+			processes_size = size;
+		}
+
+		/* processes may be gone by the time we get to them */
+		snprintf(file, sizeof(file), "%s/stat", d->d_name);
+		if (devinfo_read(file))
+			continue;
+
+		p = &processes[processes_num];
+		p->pid = atoi(d->d_name);
+		if (devinfo_process_parse(p))
+			continue;
+
+		processes_num++;
+	}
+
+	closedir(dir);
+	processes_sampled = now;
+
+	return 0;
+}
+
+static int devinfo_process_get(const char *name, char **value)
+{
+	const struct devinfo_process *p;
+	unsigned long n;
+	char *end;
+
+	if (devinfo_processes_refresh())
+		return PROVIDER_NATIVE_ERROR;
+
+	n = strtoul(name, &end, 10);
+	if (end == name || *end != '.' || !n || n > processes_num)
+		return PROVIDER_NATIVE_INVALID_NAME;
+
+	p = &processes[n - 1];
+	name = end + 1;
+
+	if (!strcmp(name, "PID")) {
+		if (asprintf(value, "%d", (int) p->pid) == -1)
+			return PROVIDER_NATIVE_ERROR;
+	} else if (!strcmp(name, "Command")) {
+		*value = strdup(p->command);
+	} else if (!strcmp(name, "Size")) {
+		if (asprintf(value, "%lu", p->size) == -1)
+			return PROVIDER_NATIVE_ERROR;
+	} else if (!strcmp(name, "Priority")) {
+		if (asprintf(value, "%ld", p->priority) == -1)
+			return PROVIDER_NATIVE_ERROR;
+	} else if (!strcmp(name, "CPUTime")) {
+		if (asprintf(value, "%lu", p->cpu_time) == -1)
+			return PROVIDER_NATIVE_ERROR;
+	} else if (!strcmp(name, "State")) {
+		*value = strdup(devinfo_state(p->state));
+	} else {
+		return PROVIDER_NATIVE_INVALID_NAME;
+	}
+
+	return *value ? PROVIDER_NATIVE_OK : PROVIDER_NATIVE_ERROR;
+}
+
+static int devinfo_get(const char *name, char **value)
+{
+	unsigned long v;
+	unsigned int usage;
+
+	if (!strcmp(name, "UpTime")) {
+		if (devinfo_uptime(&v))
+			return PROVIDER_NATIVE_ERROR;
+	} else if (!strcmp(name, "MemoryStatus.Total")) {
+		if (devinfo_meminfo("MemTotal:", &v))
+			return PROVIDER_NATIVE_ERROR;
+	} else if (!strcmp(name, "MemoryStatus.Free")) {
+		if (devinfo_meminfo("MemFree:", &v))
+			return PROVIDER_NATIVE_ERROR;
+	} else if (!strcmp(name, "ProcessStatus.CPUUsage")) {
+		if (devinfo_cpu_usage(&usage))
+			return PROVIDER_NATIVE_ERROR;
+		v = usage;
+	} else if (!strcmp(name, "ProcessStatus.ProcessNumberOfEntries")) {
+		if (devinfo_processes_refresh())
+			return PROVIDER_NATIVE_ERROR;
+		v = processes_num;
+	} else if (!strncmp(name, DEVINFO_PROCESS, strlen(DEVINFO_PROCESS))) {
+		return devinfo_process_get(name + strlen(DEVINFO_PROCESS), value);
+	} else {
+		return PROVIDER_NATIVE_NONE;
+	}
+
+	if (asprintf(value, "%lu", v) == -1)
+		return PROVIDER_NATIVE_ERROR;
+
+	return PROVIDER_NATIVE_OK;
+}
+
+static int devinfo_igd_get(const char *path, char **value)
+{
+	const char *name = path + strlen(devinfo_natives[0].prefix);
+
+	if (strcmp(name, "UpTime"))
+		return PROVIDER_NATIVE_NONE;
+
+	return devinfo_get(name, value);
+}
+
+static int devinfo_native_get(const char *path, char **value)
+{
+	return devinfo_get(path + strlen(DEVINFO_PREFIX), value);
+}
+
+int devinfo_init(void)
+{
+	size_t i;
+
+	clock_ticks = sysconf(_SC_CLK_TCK);
+	if (clock_ticks <= 0)
+		clock_ticks = 100;
+
+	for (i = 0; i < ARRAY_SIZE(devinfo_natives); i++) {
+		if (provider_native_register(&devinfo_natives[i]))
+			return -1;
+	}
+
+	return 0;
+}
+
+void devinfo_exit(void)
+{
+	free(processes);
+	processes = NULL;
+	processes_num = processes_size = 0;
+	processes_sampled = 0;
+
+	memset(&cpu_last, 0, sizeof(cpu_last));
+	cpu_sampled = 0;
+	cpu_usage = 0;
+}
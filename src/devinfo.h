@@ -0,0 +1,55 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_DEVINFO_H__
+#define _FREECWMP_DEVINFO_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef DUMMY_MODE
+static char *fc_devinfo_proc = "./ext/tmp/proc";
+#else
+static char *fc_devinfo_proc = "/proc";
+#endif
+
+#define DEVINFO_PREFIX		"Device.DeviceInfo."
+#define DEVINFO_PROCESS		"ProcessStatus.Process."
+
+/* a walk over the process table asks for every process, one scan serves them all */
+#define DEVINFO_CACHE_MSECS	1000
+
+/* CPUUsage is the load since the previous sample taken at least this long ago */
+#define DEVINFO_CPU_MSECS	1000
+
+/* large enough for /proc/meminfo and the first line of /proc/stat */
+#define DEVINFO_BUFFER_SIZE	2048
+#define DEVINFO_PATH_MAX	64
+#define DEVINFO_COMMAND_LEN	32
+
+struct devinfo_process {
+	pid_t pid;
+	char command[DEVINFO_COMMAND_LEN];
+	char state;
+	long priority;
+	unsigned long size;		/* KiB of virtual memory */
+	unsigned long cpu_time;		/* ms spent in user and kernel mode */
+};
+
+/* jiffies of the cpu line of /proc/stat, summed up since boot */
+struct devinfo_cpu {
+	uint64_t busy;
+	uint64_t total;
+};
+
+int devinfo_init(void);
+void devinfo_exit(void);
+
+#endif
+
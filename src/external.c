@@ -23,30 +23,60 @@
 #include "external.h"
 
 #include "freecwmp.h"
+#include "provider.h"
 
 static struct uloop_process uproc;
 
+/* providers needed to handle action on name; tags are handled by the
+ * common functions alone */
+static char *external_providers(char *action, char *name)
+{
+	if (strcmp(action, "value") && strcmp(action, "all"))
+		return strdup("");
+
+	return provider_lookup(name);
+}
+
 int external_get_action(char *action, char *name, char **value)
 {
+	char *providers;
+
+	providers = external_providers(action, name);
+	if (!providers)
+		return -1;
+
+	if (!*providers && strcmp(action, "tags")) {
+		/* nobody owns this parameter, don't bother running the script */
+		DD("no provider for '%s'\n", name);
+		free(providers);
+		return 0;
+	}
+
 	freecwmp_log_message(NAME, L_NOTICE,
 			     "executing get %s '%s'\n", action, name);
 
 	int pfds[2];
-	if (pipe(pfds) < 0)
+	if (pipe(pfds) < 0) {
+		free(providers);
 		return -1;
+	}
 
-	if ((uproc.pid = fork()) == -1)
+	if ((uproc.pid = fork()) == -1) {
+		free(providers);
 		goto error;
+	}
 
 	if (uproc.pid == 0) {
 		/* child */
 
-		const char *argv[8];
+		const char *argv[10];
 		int i = 0;
 		argv[i++] = "/bin/sh";
 		argv[i++] = fc_script;
 		argv[i++] = "--newline";
 		argv[i++] = "--value";
+		argv[i++] = "--provider";
+		argv[i++] = providers;
 		argv[i++] = "get";
 		argv[i++] = action;
 		argv[i++] = name;
@@ -64,9 +94,10 @@ int external_get_action(char *action, char *name, char **value)
 
 	/* parent */
 	close(pfds[1]);
+	free(providers);
 
 	int status;
-	while (wait(&status) != uproc.pid) {
+	while (waitpid(uproc.pid, &status, 0) != uproc.pid) {
 		DD("waiting for child to exit");
 	}
 
@@ -98,8 +129,117 @@ error:
 	return -1;
 }
 
+/*
+ * the whole subtree below a partial name in one run of the script; empty
+ * values are asked for as well, so every parameter the scripts know shows
+ * up exactly once
+ */
+int external_get_values(char *name, external_value_cb cb, void *priv)
+{
+	char *providers, *line = NULL, *value, *c;
+	size_t size = 0;
+	int pfds[2], status, rc = 0;
+	FILE *fp;
+
+	providers = external_providers("value", name);
+	if (!providers)
+		return -1;
+
+	if (!*providers) {
+		free(providers);
+		return 0;
+	}
+
+	freecwmp_log_message(NAME, L_NOTICE,
+			     "executing get value '%s'\n", name);
+
+	if (pipe(pfds) < 0) {
+		free(providers);
+		return -1;
+	}
+
+	if ((uproc.pid = fork()) == -1) {
+		free(providers);
+		close(pfds[0]);
+		close(pfds[1]);
+		return -1;
+	}
+
+	if (uproc.pid == 0) {
+		/* child */
+
+		const char *argv[9];
+		int i = 0;
+		argv[i++] = "/bin/sh";
+		argv[i++] = fc_script;
+		argv[i++] = "--empty";
+		argv[i++] = "--provider";
+		argv[i++] = providers;
+		argv[i++] = "get";
+		argv[i++] = "value";
+		argv[i++] = name;
+		argv[i++] = NULL;
+
+		close(pfds[0]);
+		dup2(pfds[1], 1);
+		close(pfds[1]);
+
+		execvp(argv[0], (char **) argv);
+		exit(ESRCH);
+	}
+
+	/* parent, reads while the script writes so it never blocks on a full pipe */
+	close(pfds[1]);
+	free(providers);
+
+	fp = fdopen(pfds[0], "r");
+	if (!fp) {
+		close(pfds[0]);
+		rc = -1;
+	}
+
+	while (fp && getline(&line, &size, fp) != -1) {
+		line[strcspn(line, "\n")] = '\0';
+
+		c = strchr(line, ' ');
+		if (!c) continue;
+		*c++ = '\0';
+
+		/* skip the delimiter and the blank that follows it */
+		value = c + strcspn(c, " ");
+		if (*value)
+			value++;
+
+		if (!rc && cb(line, value, priv))
+			rc = -1;
+	}
+
+	free(line);
+	if (fp)
+		fclose(fp);
+
+	while (waitpid(uproc.pid, &status, 0) != uproc.pid) {
+		DD("waiting for child to exit");
+	}
+
+	return rc;
+}
+
 int external_set_action_write(char *action, char *name, char *value)
 {
+	char *providers;
+
+	providers = external_providers(action, name);
+	if (!providers)
+		return -1;
+
+	if (!*providers && !strcmp(action, "value")) {
+		/* nobody owns this parameter, so there is no such name */
+		DD("no provider for '%s'\n", name);
+		free(providers);
+		return PROVIDER_NATIVE_INVALID_NAME;
+	}
+
 	freecwmp_log_message(NAME, L_NOTICE,
 		"adding to set %s script '%s'\n", action, name);
 
@@ -107,32 +247,42 @@ int external_set_action_write(char *action, char *name, char *value)
 
 	if (access(fc_script_set_actions, R_OK | W_OK | X_OK) != -1) {
 		fp = fopen(fc_script_set_actions, "a");
-		if (!fp) return -1;
+		if (!fp) goto error;
 	} else {
 		fp = fopen(fc_script_set_actions, "w");
-		if (!fp) return -1;
+		if (!fp) goto error;
 
 		fprintf(fp, "#!/bin/sh\n");
 
 		if (chmod(fc_script_set_actions,
 			strtol("0700", 0, 8)) < 0) {
-			return -1;
+			fclose(fp);
+			goto error;
 		}
 	}
 
 #ifdef DUMMY_MODE
-	fprintf(fp, "/bin/sh `pwd`/%s set %s %s %s\n", fc_script, action, name, value);
+	fprintf(fp, "/bin/sh `pwd`/%s --provider '%s' set %s %s %s\n", fc_script, providers, action, name, value);
 #else
-	fprintf(fp, "/bin/sh %s set %s %s %s\n", fc_script, action, name, value);
+	fprintf(fp, "/bin/sh %s --provider '%s' set %s %s %s\n", fc_script, providers, action, name, value);
 #endif
 
 	fclose(fp);
+	free(providers);
 
 	return 0;
+
+error:
+	free(providers);
+	return -1;
 }
 
 int external_set_action_execute()
 {
+	/* every value went to a native provider */
+	if (access(fc_script_set_actions, F_OK) == -1)
+		return 0;
+
 	freecwmp_log_message(NAME, L_NOTICE, "executing set script\n");
 
 	if ((uproc.pid = fork()) == -1) {
@@ -156,7 +306,7 @@ int external_set_action_execute()
 
 	/* parent */
 	int status;
-	while (wait(&status) != uproc.pid) {
+	while (waitpid(uproc.pid, &status, 0) != uproc.pid) {
 		DD("waiting for child to exit");
 	}
 
@@ -168,22 +318,28 @@ int external_set_action_execute()
 	return 0;
 }
 
-int external_simple(char *arg)
+/* the collected set script is dropped without running it */
+void external_set_action_discard(void)
 {
-	freecwmp_log_message(NAME, L_NOTICE, 
-		"executing %s request\n", arg);
+	if (remove(fc_script_set_actions) && errno != ENOENT)
+		D("removing %s failed\n", fc_script_set_actions);
+}
 
+static int external_run(char *arg, char *value)
+{
 	if ((uproc.pid = fork()) == -1)
 		return -1;
 
 	if (uproc.pid == 0) {
 		/* child */
 
-		const char *argv[4];
+		const char *argv[5];
 		int i = 0;
 		argv[i++] = "/bin/sh";
 		argv[i++] = fc_script;
 		argv[i++] = arg;
+		if (value)
+			argv[i++] = value;
 		argv[i++] = NULL;
 
 		execvp(argv[0], (char **) argv);
@@ -194,7 +350,7 @@ int external_simple(char *arg)
 
 	/* parent */
 	int status;
-	while (wait(&status) != uproc.pid) {
+	while (waitpid(uproc.pid, &status, 0) != uproc.pid) {
 		DD("waiting for child to exit");
 	}
 
@@ -203,45 +359,26 @@ int external_simple(char *arg)
 	return 0;
 }
 
-int external_download(char *url, char *size)
+int external_simple(char *arg)
 {
-	freecwmp_log_message(NAME, L_NOTICE,
-		"executing download url '%s'\n", url);
-
-	if ((uproc.pid = fork()) == -1)
-		return -1;
-
-	if (uproc.pid == 0) {
-		/* child */
-
-		const char *argv[8];
-		int i = 0;
-		argv[i++] = "/bin/sh";
-		argv[i++] = fc_script;
-		argv[i++] = "download";
-		argv[i++] = "--url";
-		argv[i++] = url;
-		argv[i++] = "--size";
-		argv[i++] = size;
-		argv[i++] = NULL;
+	freecwmp_log_message(NAME, L_NOTICE, 
+		"executing %s request\n", arg);
 
-		execvp(argv[0], (char **) argv);
-		exit(ESRCH);
+	return external_run(arg, NULL);
+}
 
-	} else if (uproc.pid < 0)
-		return -1;
+int external_reload(char *service)
+{
+	freecwmp_log_message(NAME, L_NOTICE,
+		"reloading service %s\n", service);
 
-	/* parent */
-	int status;
-	while (wait(&status) != uproc.pid) {
-		DD("waiting for child to exit");
-	}
+	return external_run("reload", service);
+}
 
-	if (WIFEXITED(status) && !WEXITSTATUS(status))
-		return 0;
-	else
-		return 1;
+int external_upgrade(char *image)
+{
+	freecwmp_log_message(NAME, L_NOTICE,
+		"upgrading firmware from %s\n", image);
 
-	return 0;
+	return external_run("upgrade", image);
 }
-
@@ -17,11 +17,18 @@ static char *fc_script = "/usr/sbin/freecwmp";
 #endif
 static char *fc_script_set_actions = "/tmp/freecwmp_set_action_values.sh";
 
+/* one call per "<name> <delimiter> <value>" line of the script */
+typedef int (*external_value_cb)(const char *name, const char *value,
+				 void *priv);
+
 int external_get_action(char *action, char *name, char **value);
+int external_get_values(char *name, external_value_cb cb, void *priv);
 int external_set_action_write(char *action, char *name, char *value);
 int external_set_action_execute();
+void external_set_action_discard(void);
 int external_simple(char *arg);
-int external_download(char *url, char *size);
+int external_reload(char *service);
+int external_upgrade(char *image);
 
 #endif
 
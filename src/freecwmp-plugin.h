@@ -0,0 +1,81 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_PLUGIN_H__
+#define _FREECWMP_PLUGIN_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * interface between freecwmpd and shared object providers; a plugin
+ * exports one struct freecwmp_plugin under FREECWMP_PLUGIN_SYMBOL and
+ * nothing of the daemon is visible to it; any incompatible change of
+ * the structures below bumps FREECWMP_PLUGIN_ABI, plugins built for
+ * another version are refused
+ */
+#define FREECWMP_PLUGIN_ABI	1
+#define FREECWMP_PLUGIN_SYMBOL	"freecwmp_plugin"
+
+enum freecwmp_plugin_result {
+	FREECWMP_PLUGIN_OK = 0,
+	FREECWMP_PLUGIN_ERROR = -1,
+	/* not handled here, the next provider of the path is asked */
+	FREECWMP_PLUGIN_NONE = 1,
+	FREECWMP_PLUGIN_INVALID_NAME = 2,
+	FREECWMP_PLUGIN_INVALID_VALUE = 3,
+};
+
+/*
+ * parameters and objects the plugin adds to the data model; object
+ * paths end with a dot, multi-instance objects use {i} and need either
+ * an instance() callback or an <Object>NumberOfEntries parameter
+ */
+struct freecwmp_plugin_param {
+	const char *path;
+	bool writable;
+};
+
+/*
+ * callbacks for every path starting with prefix, all of them optional;
+ * get() is only asked for single parameters, never for object paths,
+ * and its values are allocated with malloc() and freed by the daemon;
+ * set() only stages the value, commit() applies everything staged once
+ * the whole request has been accepted and abort() drops it when the
+ * request is refused; instance() reports the lowest existing instance
+ * number not below from (0 when there is none) of the object path
+ * given with its trailing dot
+ */
+struct freecwmp_plugin_provider {
+	const char *prefix;
+	int (*get)(const char *path, char **value);
+	int (*set)(const char *path, const char *value);
+	int (*commit)(void);
+	void (*abort)(void);
+	int (*instance)(const char *object, unsigned long from,
+			unsigned long *number);
+};
+
+/* init() runs before anything is registered, a failure unloads the plugin */
+struct freecwmp_plugin {
+	unsigned int abi;
+	const char *name;
+
+	const struct freecwmp_plugin_param *params;
+	size_t params_num;
+
+	const struct freecwmp_plugin_provider *providers;
+	size_t providers_num;
+
+	int (*init)(void);
+	void (*exit)(void);
+};
+
+#endif
+
@@ -7,6 +7,8 @@
  *	Copyright (C) 2011-2012 Luka Perkov <freecwmp@lukaperkov.net>
  */
 
+#include <errno.h>
+#include <libgen.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
@@ -14,27 +16,41 @@
 #include <limits.h>
 #include <locale.h>
 #include <unistd.h>
-#include <net/if.h>
-#include <arpa/inet.h>
-#include <linux/netlink.h>
-#include <linux/rtnetlink.h>
+#include <sys/stat.h>
 
 #include <libfreecwmp.h>
 #include <libubox/uloop.h>
 
 #include "freecwmp.h"
 
+#include "address.h"
+#include "attribute.h"
 #include "config.h"
 #include "cwmp.h"
+#include "deferred.h"
+#include "devinfo.h"
+#include "hosts.h"
+#include "http.h"
+#include "iface.h"
+#include "instance.h"
+#include "mapping.h"
+#include "netlink.h"
+#include "plugin.h"
+#include "route.h"
+#include "scheduler.h"
+#include "schema.h"
+#include "transfer.h"
 #include "ubus.h"
 
-static void freecwmp_kickoff(struct uloop_timeout *);
-static void freecwmp_do_reload(struct uloop_timeout *timeout);
-static void netlink_new_msg(struct uloop_fd *ufd, unsigned events);
+static void freecwmp_kickoff(struct scheduler_timer *timer);
+static void freecwmp_do_address_change(struct scheduler_timer *timer);
+static void freecwmp_do_reload(struct scheduler_timer *timer);
 
-static struct uloop_fd netlink_event = { .cb = netlink_new_msg };
-static struct uloop_timeout netlink_timer = { .cb = freecwmp_kickoff };
-static struct uloop_timeout reload_timer = { .cb = freecwmp_do_reload };
+static struct scheduler_timer kickoff_timer = { .cb = freecwmp_kickoff };
+static struct scheduler_timer address_timer = { .cb = freecwmp_do_address_change };
+static struct scheduler_timer reload_timer = { .cb = freecwmp_do_reload };
+
+static bool started;
 
 static void
 print_help(void)
@@ -45,156 +61,62 @@ print_help(void)
 }
 
 static void
-freecwmp_kickoff(struct uloop_timeout *timeout)
+freecwmp_kickoff(struct scheduler_timer *timer)
 {
-	cwmp_exit();
+	started = true;
 	cwmp_init();
 	if (ubus_init()) D("ubus initialization failed\n");
 	cwmp_inform();
 }
 
-static void freecwmp_do_reload(struct uloop_timeout *timeout)
+/*
+ * events, notifications and the ubus connection survive an address
+ * change; only the listener moves and the ACS learns the new URL from
+ * the forced parameters of a single VALUE CHANGE session
+ */
+static void freecwmp_do_address_change(struct scheduler_timer *timer)
 {
-	config_load();
+	if (http_server_rebind())
+		D("rebinding the connection request listener failed\n");
+
+	cwmp_add_event(VALUE_CHANGE, NULL);
+	cwmp_request_inform();
 }
 
-void freecwmp_reload(void)
+static void freecwmp_do_reload(struct scheduler_timer *timer)
 {
-	uloop_timeout_set(&reload_timer, 100);
+	config_load();
 }
 
-
-static void
-freecwmp_netlink_interface(struct nlmsghdr *nlh)
+/* state files live in directories that may not exist on first start */
+int freecwmp_mkdir_parent(const char *path)
 {
-	struct ifaddrmsg *ifa = (struct ifaddrmsg *) NLMSG_DATA(nlh);
-	struct rtattr *rth = IFA_RTA(ifa);
-	int rtl = IFA_PAYLOAD(nlh);
-	char if_name[IFNAMSIZ], if_addr[INET_ADDRSTRLEN];
-
-	memset(&if_name, 0, sizeof(if_name));
-	memset(&if_addr, 0, sizeof(if_addr));
-
-	while (rtl && RTA_OK(rth, rtl)) {
-		if (rth->rta_type != IFA_LOCAL) {
-			rth = RTA_NEXT(rth, rtl);
-			continue;
-		}
+	char *dir, *c;
+	int rc = 0;
 
-		uint32_t addr = htonl(* (uint32_t *)RTA_DATA(rth));
-		if (htonl(13) == 13) {
-			// running on big endian system
-		} else {
-			// running on little endian system
-			addr = __builtin_bswap32(addr);
-		}
+	c = strdup(path);
+	if (!c) return -1;
 
-		if_indextoname(ifa->ifa_index, if_name);
-		if (strncmp(config->local->interface, if_name, IFNAMSIZ)) {
-			rth = RTA_NEXT(rth, rtl);
-			continue;
-		}
-
-		inet_ntop(AF_INET, &(addr), if_addr, INET_ADDRSTRLEN);
-
-		FREE(config->local->ip);
-		config->local->ip = strdup(if_addr);
-		break;
-	}
+	dir = dirname(c);
+	if (mkdir(dir, 0755) && errno != EEXIST)
+		rc = -1;
 
-	if (strlen(if_addr) == 0) return;
-
-	freecwmp_log_message(NAME, L_NOTICE, "interface %s has ip %s\n", \
-			     if_name, if_addr);
-	uloop_timeout_set(&netlink_timer, 2500);
+	free(c);
+	return rc;
 }
 
-static void
-netlink_new_msg(struct uloop_fd *ufd, unsigned events)
+void freecwmp_reload(void)
 {
-	struct nlmsghdr *nlh;
-	char buffer[BUFSIZ];
-	int msg_size;
-
-	memset(&buffer, 0, sizeof(buffer));
-
-	nlh = (struct nlmsghdr *)buffer;
-	if ((msg_size = recv(ufd->fd, nlh, BUFSIZ, 0)) == -1) {
-		DD("error receiving netlink message");
-		return;
-	}
-
-	while (msg_size > sizeof(*nlh)) {
-		int len = nlh->nlmsg_len;
-		int req_len = len - sizeof(*nlh);
-
-		if (req_len < 0 || len > msg_size) {
-			DD("error reading netlink message");
-			return;
-		}
-
-		if (!NLMSG_OK(nlh, msg_size)) {
-			DD("netlink message is not NLMSG_OK");
-			return;
-		}
-
-		if (nlh->nlmsg_type == RTM_NEWADDR)
-			freecwmp_netlink_interface(nlh);
-
-		msg_size -= NLMSG_ALIGN(len);
-		nlh = (struct nlmsghdr*)((char*)nlh + NLMSG_ALIGN(len));
-	}
+	scheduler_timer_set(&reload_timer, 100);
 }
 
-static int
-netlink_init(void)
+/* act on the address once it had time to settle, bursts coalesce */
+void freecwmp_address_change(void)
 {
-	struct {
-		struct nlmsghdr hdr;
-		struct ifaddrmsg msg;
-	} req;
-	struct sockaddr_nl addr;
-	int sock[2];
-
-	memset(&addr, 0, sizeof(addr));
-	memset(&req, 0, sizeof(req));
-
-	if ((sock[0] = socket(PF_NETLINK, SOCK_RAW, NETLINK_ROUTE)) == -1) {
-		D("couldn't open NETLINK_ROUTE socket");
-		return -1;
-	}
-
-	addr.nl_family = AF_NETLINK;
-	addr.nl_groups = RTMGRP_IPV4_IFADDR;
-	if ((bind(sock[0], (struct sockaddr *)&addr, sizeof(addr))) == -1) {
-		D("couldn't bind netlink socket");
-		return -1;
-	}
-
-	netlink_event.fd = sock[0];
-	uloop_fd_add(&netlink_event, ULOOP_READ | ULOOP_EDGE_TRIGGER);
-
-	if ((sock[1] = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE)) == -1) {
-		D("couldn't open NETLINK_ROUTE socket");
-		return -1;
-	}
-
-	req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
-	req.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ROOT;
-	req.hdr.nlmsg_type = RTM_GETADDR;
-	req.msg.ifa_family = AF_INET;
-
-	if ((send(sock[1], &req, req.hdr.nlmsg_len, 0)) == -1) {
-		D("couldn't send netlink socket");
-		return -1;
-	}
-
-	struct uloop_fd dummy_event = { .fd = sock[1] };
-	netlink_new_msg(&dummy_event, 0);
-
-	return 0;
+	scheduler_timer_set(started ? &address_timer : &kickoff_timer, 2500);
 }
 
+
 int main (int argc, char **argv)
 {
 	freecwmp_log_message(NAME, L_NOTICE, "daemon started\n");
@@ -242,9 +164,49 @@ int main (int argc, char **argv)
 	INIT_LIST_HEAD(&cwmp->events);
 	INIT_LIST_HEAD(&cwmp->notifications);
 
+	/* the scripts queue the services they want reloaded in here */
+	setenv("FREECWMP_RELOAD", fc_deferred_reload, 1);
+
 	config_load();
 
+	if (schema_init()) {
+		D("schema initialization failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (attribute_init())
+		D("loading parameter attributes failed\n");
+
+	if (instance_init())
+		D("loading instance numbers failed\n");
+
+	if (hosts_init())
+		D("registering the hosts provider failed\n");
+
+	if (route_init())
+		D("registering the routing provider failed\n");
+
+	if (iface_init())
+		D("registering the interface providers failed\n");
+
+	if (address_init())
+		D("registering the address providers failed\n");
+
+	if (devinfo_init())
+		D("registering the device info providers failed\n");
+
+	if (mapping_init())
+		D("registering the mapping provider failed\n");
+
+	if (plugin_init())
+		D("loading some of the plugins failed\n");
+
 	uloop_init();
+	scheduler_init();
+
+	/* queued transfers are re-armed, the timer wheel has to be up */
+	if (transfer_init())
+		D("loading transfer state failed\n");
 
 	if (netlink_init()) {
 		D("netlink initialization failed\n");
@@ -286,7 +248,21 @@ int main (int argc, char **argv)
 	uloop_run();
 
 	ubus_exit();
+	netlink_exit();
+	scheduler_exit();
 	uloop_done();
+
+	transfer_exit();
+	plugin_exit();
+	mapping_exit();
+	devinfo_exit();
+	address_exit();
+	iface_exit();
+	route_exit();
+	hosts_exit();
+	instance_exit();
+	attribute_exit();
+	schema_exit();
 	
 	closelog();
 
@@ -10,6 +10,11 @@
 #ifndef _FREECWMP_FREECWMP_H__
 #define _FREECWMP_FREECWMP_H__
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 #define NAME	"freecwmpd"
 
 #define FREE(x) if (!x) { free(x) ; x = NULL; }
@@ -32,7 +37,35 @@ static inline void no_debug(int level, const char *fmt, ...)
 {
 }
 
+/* 32 bit FNV-1a, step by step from FREECWMP_HASH_INIT or in one go */
+#define FREECWMP_HASH_INIT	2166136261u
+
+static inline uint32_t freecwmp_hash_step(uint32_t hash, unsigned char c)
+{
+	return (hash ^ c) * 16777619u;
+}
+
+static inline uint32_t freecwmp_hash(const void *data, size_t len)
+{
+	const unsigned char *c = data;
+	uint32_t hash = FREECWMP_HASH_INIT;
+
+	while (len--)
+		hash = freecwmp_hash_step(hash, *c++);
+
+	return hash;
+}
+
+/* xsd:boolean and the spellings uci accepts for it */
+static inline bool freecwmp_true(const char *v)
+{
+	return !strcmp(v, "1") || !strcmp(v, "true") || !strcmp(v, "yes") ||
+	       !strcmp(v, "on") || !strcmp(v, "enabled");
+}
+
 void freecwmp_reload(void);
+void freecwmp_address_change(void);
+int freecwmp_mkdir_parent(const char *path);
 
 #endif
 
@@ -0,0 +1,442 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libfreecwmp.h>
+
+#include "hosts.h"
+
+#include "config.h"
+#include "freecwmp.h"
+#include "instance.h"
+#include "provider.h"
+#include "scheduler.h"
+
+#define HOSTS_PREFIX	"Device.Hosts."
+#define HOSTS_HOST	HOSTS_PREFIX "Host."
+
+static int hosts_native_get(const char *path, char **value);
+static int hosts_native_instance(const char *object, unsigned long from,
+				 unsigned long *number);
+
+static const struct provider_native hosts_native = {
+	.prefix = HOSTS_PREFIX,
+	.get = hosts_native_get,
+	.instance = hosts_native_instance,
+};
+
+static struct hosts_entry *hosts;
+static size_t hosts_num;
+static size_t hosts_size;
+
+/* open addressing on the IP address, slots hold the entry index + 1 */
+static uint32_t *hosts_by_ip;
+static size_t hosts_buckets;
+
+static struct hosts_stamp config_stamp;
+static struct hosts_stamp leases_stamp;
+static uint64_t arp_checked;
+
+static size_t hosts_slot(const char *ip)
+{
+	return freecwmp_hash(ip, strlen(ip)) & (hosts_buckets - 1);
+}
+
+static bool hosts_stamp_equal(const struct hosts_stamp *a,
+			      const struct hosts_stamp *b)
+{
+	return a->exists == b->exists && a->dev == b->dev &&
+	       a->ino == b->ino && a->size == b->size &&
+	       a->mtime.tv_sec == b->mtime.tv_sec &&
+	       a->mtime.tv_nsec == b->mtime.tv_nsec;
+}
+
+/* true when the file is not the one that was read last time */
+static bool hosts_stamp_update(const char *path, struct hosts_stamp *stamp)
+{
+	struct hosts_stamp now;
+	struct stat st;
+
+	memset(&now, 0, sizeof(now));
+	if (!stat(path, &st)) {
+		now.exists = true;
+		now.dev = st.st_dev;
+		now.ino = st.st_ino;
+		now.size = st.st_size;
+		now.mtime = st.st_mtim;
+	}
+
+	if (hosts_stamp_equal(&now, stamp))
+		return false;
+
+	*stamp = now;
+	return true;
+}
+
+static struct hosts_entry *hosts_append(void)
+{
+	struct hosts_entry *h;
+	size_t size;
+
+	if (hosts_num == hosts_size) {
+		size = hosts_size ? 2 * hosts_size : 64;
+		h = realloc(hosts, size * sizeof(*h));
+		if (!h) return NULL;
+		hosts = h;
+		hosts_size = size;
+	}
+
+	h = &hosts[hosts_num++];
+	memset(h, 0, sizeof(*h));
+	return h;
+}
+
+static void hosts_copy(char *dst, const char *src, size_t len)
+{
+	snprintf(dst, len, "%s", src);
+}
+
+/* the same hosts as the script used to count: sections with a mac */
+static int hosts_load_config(bool reload)
+{
+	struct uci_package *p;
+	struct uci_element *e, *o;
+	struct uci_section *s;
+	struct uci_option *opt;
+	struct hosts_entry *h;
+
+	p = config_uci_load("dhcp", reload);
+	if (!p) return 0;
+
+	uci_foreach_element(&p->sections, e) {
+		s = uci_to_section(e);
+		if (strcmp(s->type, "host"))
+			continue;
+
+		h = NULL;
+		uci_foreach_element(&s->options, o) {
+			opt = uci_to_option(o);
+			if (opt->type != UCI_TYPE_STRING || strcmp(o->name, "mac"))
+				continue;
+			h = hosts_append();
+			if (!h) return -1;
+			hosts_copy(h->mac, opt->v.string, sizeof(h->mac));
+		}
+		if (!h) continue;
+
+		uci_foreach_element(&s->options, o) {
+			opt = uci_to_option(o);
+			if (opt->type != UCI_TYPE_STRING)
+				continue;
+			if (!strcmp(o->name, "ip"))
+				hosts_copy(h->ip, opt->v.string, sizeof(h->ip));
+			else if (!strcmp(o->name, "name"))
+				hosts_copy(h->name, opt->v.string, sizeof(h->name));
+		}
+	}
+
+	return 0;
+}
+
+/* dnsmasq writes "<expires> <mac> <ip> <hostname> <client id>" lines */
+static int hosts_load_leases(void)
+{
+	char line[256], mac[HOSTS_MAC_LEN], ip[HOSTS_IP_LEN];
+	char name[HOSTS_NAME_LEN];
+	struct hosts_entry *h;
+	long expires;
+	FILE *fp;
+
+	fp = fopen(fc_hosts_leases, "r");
+	if (!fp) return 0;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%ld %17s %45s %63s", &expires, mac, ip,
+			   name) != 4)
+			continue;
+
+		h = hosts_append();
+		if (!h) {
+			fclose(fp);
+			return -1;
+		}
+
+		hosts_copy(h->mac, mac, sizeof(h->mac));
+		hosts_copy(h->ip, ip, sizeof(h->ip));
+		if (strcmp(name, "*"))
+			hosts_copy(h->name, name, sizeof(h->name));
+		h->dynamic = true;
+		h->expires = expires;
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+static int hosts_index(void)
+{
+	size_t i, slot, buckets = 16;
+
+	while (buckets < 2 * hosts_num)
+		buckets <<= 1;
+
+	if (buckets != hosts_buckets) {
+		free(hosts_by_ip);
+		hosts_by_ip = malloc(buckets * sizeof(*hosts_by_ip));
+		if (!hosts_by_ip) {
+			hosts_buckets = 0;
+			return -1;
+		}
+		hosts_buckets = buckets;
+	}
+
+	memset(hosts_by_ip, 0, hosts_buckets * sizeof(*hosts_by_ip));
+
+	for (i = 0; i < hosts_num; i++) {
+		if (!*hosts[i].ip)
+			continue;
+		slot = hosts_slot(hosts[i].ip);
+		while (hosts_by_ip[slot])
+			slot = (slot + 1) & (hosts_buckets - 1);
+		hosts_by_ip[slot] = i + 1;
+	}
+
+	return 0;
+}
+
+/*
+ * a host keeps its number as long as its section or lease exists; hosts
+ * with the same mac are told apart by the order they are seen in
+ */
+static int hosts_claim(struct hosts_entry *h)
+{
+	char key[40];
+	unsigned int n = 0;
+	int rc;
+
+	do {
+		snprintf(key, sizeof(key), "%s_%s_%u",
+			 h->dynamic ? "lease" : "host", h->mac, n++);
+		rc = instance_claim(HOSTS_HOST, key, &h->number);
+	} while (rc == INSTANCE_INVALID_NAME);
+
+	return rc;
+}
+
+static int hosts_number_cmp(const void *a, const void *b)
+{
+	const struct hosts_entry *ha = a, *hb = b;
+
+	return ha->number < hb->number ? -1 : ha->number > hb->number;
+}
+
+static int hosts_number(void)
+{
+	size_t i;
+
+	instance_claim_begin(HOSTS_HOST);
+
+	for (i = 0; i < hosts_num; i++) {
+		if (hosts_claim(&hosts[i]))
+			return -1;
+	}
+
+	if (instance_claim_end(HOSTS_HOST))
+		return -1;
+
+	qsort(hosts, hosts_num, sizeof(*hosts), hosts_number_cmp);
+	return 0;
+}
+
+/* position of the first host numbered from or above */
+static size_t hosts_find(unsigned long from)
+{
+	size_t lo = 0, hi = hosts_num, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (hosts[mid].number < from)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* a host is active while the kernel has a complete neighbour entry for it */
+static void hosts_load_arp(void)
+{
+	char line[256], ip[HOSTS_IP_LEN];
+	unsigned int type, flags;
+	size_t i, slot;
+	FILE *fp;
+
+	for (i = 0; i < hosts_num; i++)
+		hosts[i].active = false;
+
+	fp = fopen(fc_hosts_arp, "r");
+	if (!fp) return;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%45s 0x%x 0x%x", ip, &type, &flags) != 3 ||
+		    !(flags & 0x2))
+			continue;
+
+		/* the same address may be both a static host and a lease */
+		slot = hosts_slot(ip);
+		while (hosts_by_ip[slot]) {
+			i = hosts_by_ip[slot] - 1;
+			if (!strcmp(hosts[i].ip, ip))
+				hosts[i].active = true;
+			slot = (slot + 1) & (hosts_buckets - 1);
+		}
+	}
+
+	fclose(fp);
+}
+
+/*
+ * the table is only rebuilt when the uci config or the leases file has
+ * changed since it was read, everything else is answered from memory
+ */
+static int hosts_refresh(void)
+{
+	bool config, leases;
+	uint64_t now;
+
+	config = hosts_stamp_update(fc_hosts_config, &config_stamp);
+	leases = hosts_stamp_update(fc_hosts_leases, &leases_stamp);
+
+	if (config || leases || !hosts_buckets) {
+		hosts_num = 0;
+		if (hosts_load_config(config) || hosts_load_leases() ||
+		    hosts_number() || hosts_index()) {
+			/* start over on the next request */
+			memset(&config_stamp, 0, sizeof(config_stamp));
+			memset(&leases_stamp, 0, sizeof(leases_stamp));
+			hosts_num = 0;
+			return -1;
+		}
+		arp_checked = 0;
+	}
+
+	now = scheduler_msecs();
+	if (!arp_checked || now - arp_checked >= HOSTS_ARP_INTERVAL) {
+		hosts_load_arp();
+		arp_checked = now;
+	}
+
+	return 0;
+}
+
+static int hosts_native_get(const char *path, char **value)
+{
+	const char *p = path + strlen(HOSTS_PREFIX);
+	struct hosts_entry *h;
+	unsigned long n;
+	const char *v;
+	char *end;
+	long remaining;
+	size_t i;
+
+	if (hosts_refresh())
+		return PROVIDER_NATIVE_ERROR;
+
+	if (!strcmp(p, "HostNumberOfEntries")) {
+		if (asprintf(value, "%zu", hosts_num) == -1)
+			return PROVIDER_NATIVE_ERROR;
+		return PROVIDER_NATIVE_OK;
+	}
+
+	if (strncmp(p, "Host.", 5))
+		return PROVIDER_NATIVE_INVALID_NAME;
+
+	p += 5;
+	n = strtoul(p, &end, 10);
+	if (end == p || *end != '.')
+		return PROVIDER_NATIVE_INVALID_NAME;
+
+	i = hosts_find(n);
+	if (i == hosts_num || hosts[i].number != n)
+		return PROVIDER_NATIVE_INVALID_NAME;
+
+	h = &hosts[i];
+	p = end + 1;
+
+	if (!strcmp(p, "PhysAddress")) {
+		v = h->mac;
+	} else if (!strcmp(p, "IPAddress") ||
+		   !strcmp(p, "IPv4Address.1.IPAddress")) {
+		v = h->ip;
+	} else if (!strcmp(p, "AddressSource")) {
+		v = h->dynamic ? "DHCP" : "Static";
+	} else if (!strcmp(p, "HostName")) {
+		v = h->name;
+	} else if (!strcmp(p, "Active")) {
+		v = h->active ? "1" : "0";
+	} else if (!strcmp(p, "IPv4AddressNumberOfEntries")) {
+		v = *h->ip ? "1" : "0";
+	} else if (!strcmp(p, "IPv6AddressNumberOfEntries")) {
+		v = "0";
+	} else if (!strcmp(p, "LeaseTimeRemaining")) {
+		remaining = -1;
+		if (h->dynamic && h->expires) {
+			remaining = h->expires - time(NULL);
+			if (remaining < 0)
+				remaining = 0;
+		}
+		if (asprintf(value, "%ld", remaining) == -1)
+			return PROVIDER_NATIVE_ERROR;
+		return PROVIDER_NATIVE_OK;
+	} else {
+		return PROVIDER_NATIVE_INVALID_NAME;
+	}
+
+	*value = strdup(v);
+	return *value ? PROVIDER_NATIVE_OK : PROVIDER_NATIVE_ERROR;
+}
+
+static int hosts_native_instance(const char *object, unsigned long from,
+				 unsigned long *number)
+{
+	size_t i;
+
+	if (strcmp(object, HOSTS_HOST))
+		return PROVIDER_NATIVE_NONE;
+
+	if (hosts_refresh())
+		return PROVIDER_NATIVE_ERROR;
+
+	i = hosts_find(from);
+	*number = i < hosts_num ? hosts[i].number : 0;
+	return PROVIDER_NATIVE_OK;
+}
+
+int hosts_init(void)
+{
+	return provider_native_register(&hosts_native);
+}
+
+void hosts_exit(void)
+{
+	free(hosts);
+	hosts = NULL;
+	hosts_num = hosts_size = 0;
+
+	free(hosts_by_ip);
+	hosts_by_ip = NULL;
+	hosts_buckets = 0;
+
+	memset(&config_stamp, 0, sizeof(config_stamp));
+	memset(&leases_stamp, 0, sizeof(leases_stamp));
+}
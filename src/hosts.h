@@ -0,0 +1,62 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_HOSTS_H__
+#define _FREECWMP_HOSTS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifdef DUMMY_MODE
+static char *fc_hosts_leases = "./ext/tmp/dhcp.leases";
+static char *fc_hosts_config = "./ext/openwrt/config/dhcp";
+static char *fc_hosts_arp = "./ext/tmp/arp";
+#else
+static char *fc_hosts_leases = "/var/dhcp.leases";
+static char *fc_hosts_config = "/etc/config/dhcp";
+static char *fc_hosts_arp = "/proc/net/arp";
+#endif
+
+/* the neighbour table changes all the time, it is re-read at most this often */
+#define HOSTS_ARP_INTERVAL	2000
+
+#define HOSTS_MAC_LEN	18
+#define HOSTS_IP_LEN	46
+#define HOSTS_NAME_LEN	64
+
+/*
+ * static uci hosts and the dnsmasq leases, ordered by the number each of
+ * them claimed when it was first seen
+ */
+struct hosts_entry {
+	unsigned long number;
+	char mac[HOSTS_MAC_LEN];
+	char ip[HOSTS_IP_LEN];
+	char name[HOSTS_NAME_LEN];
+	bool dynamic;
+	bool active;
+	time_t expires;		/* 0 is an infinite lease */
+};
+
+/* identifies a version of a source file, any change means re-reading it */
+struct hosts_stamp {
+	bool exists;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+};
+
+int hosts_init(void);
+void hosts_exit(void);
+
+#endif
+
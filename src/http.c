@@ -11,6 +11,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -243,12 +244,25 @@ http_send_message(char *msg_out, char **msg_in)
 	return 0;
 }
 
+/* scripts run by the daemon must not keep the listener bound */
+static int
+http_server_listen(void)
+{
+	int fd;
+
+	fd = usock(USOCK_TCP | USOCK_SERVER, config->local->ip, config->local->port);
+	if (fd >= 0)
+		fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+
+	return fd;
+}
+
 void
 http_server_init(void)
 {
 	http_s.http_event.cb = http_new_client;
 
-	http_s.http_event.fd = usock(USOCK_TCP | USOCK_SERVER, config->local->ip, config->local->port);
+	http_s.http_event.fd = http_server_listen();
 	uloop_fd_add(&http_s.http_event, ULOOP_READ | ULOOP_EDGE_TRIGGER);
 
 	DDF("+++ HTTP SERVER CONFIGURATION +++\n");
@@ -262,6 +276,54 @@ http_server_init(void)
 	freecwmp_log_message(NAME, L_NOTICE, "http server initialized");
 }
 
+/*
+ * move the connection request listener to the current address; the new
+ * socket is opened before the old one is closed, unless they collide
+ */
+int
+http_server_rebind(void)
+{
+	int fd;
+
+	fd = http_server_listen();
+
+	if (http_s.http_event.registered) {
+		uloop_fd_delete(&http_s.http_event);
+		close(http_s.http_event.fd);
+	}
+
+	/* the old socket may have held the very address we need */
+	if (fd < 0)
+		fd = http_server_listen();
+
+	if (fd < 0) {
+		D("binding http server to '%s' failed\n",
+		  config->local->ip ? config->local->ip : "*");
+		return -1;
+	}
+
+	http_s.http_event.cb = http_new_client;
+	http_s.http_event.fd = fd;
+	uloop_fd_add(&http_s.http_event, ULOOP_READ | ULOOP_EDGE_TRIGGER);
+
+	freecwmp_log_message(NAME, L_NOTICE, "http server bound to %s\n",
+			     config->local->ip ? config->local->ip : "*");
+
+	return 0;
+}
+
+/*
+ * for children that don't exec: a rebind of the parent fails with
+ * EADDRINUSE as long as any of them holds the old socket; the epoll set
+ * is shared with the parent, so the fd is only closed, not deleted
+ */
+void
+http_server_fork(void)
+{
+	if (http_s.http_event.registered)
+		close(http_s.http_event.fd);
+}
+
 static void
 http_new_client(struct uloop_fd *ufd, unsigned events)
 {
@@ -299,7 +361,8 @@ http_new_client(struct uloop_fd *ufd, unsigned events)
 			FILE *fp;
 			char buffer[BUFSIZ];
 			int8_t auth_status = 0;
-			
+
+			http_server_fork();
 			fp = fdopen(client, "r+");
 
 			DDF("+++ RECEIVED HTTP REQUEST +++\n");
@@ -53,6 +53,8 @@ void http_client_exit(void);
 int8_t http_send_message(char *msg_out, char **msg_in);
 
 void http_server_init(void);
+int http_server_rebind(void);
+void http_server_fork(void);
 static void http_new_client(struct uloop_fd *ufd, unsigned events);
 static void http_del_client(struct uloop_process *uproc, int ret);
 
@@ -0,0 +1,491 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/rtnetlink.h>
+
+#include <libfreecwmp.h>
+
+#include "iface.h"
+
+#include "config.h"
+#include "freecwmp.h"
+#include "netlink.h"
+#include "scheduler.h"
+
+#ifndef IFF_LOWER_UP
+#define IFF_LOWER_UP	0x10000
+#endif
+
+#define IFACE_PATH_MAX	128
+
+static int iface_native_get(const char *path, char **value);
+
+static const struct iface_param connection_params[] = {
+	{ "EthernetBytesSent", IFACE_TX_BYTES },
+	{ "EthernetBytesReceived", IFACE_RX_BYTES },
+	{ "EthernetPacketsSent", IFACE_TX_PACKETS },
+	{ "EthernetPacketsReceived", IFACE_RX_PACKETS },
+	{ "EthernetErrorsSent", IFACE_TX_ERRORS },
+	{ "EthernetErrorsReceived", IFACE_RX_ERRORS },
+	{ "EthernetDiscardPacketsSent", IFACE_TX_DROPPED },
+	{ "EthernetDiscardPacketsReceived", IFACE_RX_DROPPED },
+};
+
+static const struct iface_param common_params[] = {
+	{ "PhysicalLinkStatus", IFACE_LINK_STATUS },
+	{ "TotalBytesSent", IFACE_TX_BYTES },
+	{ "TotalBytesReceived", IFACE_RX_BYTES },
+	{ "TotalPacketsSent", IFACE_TX_PACKETS },
+	{ "TotalPacketsReceived", IFACE_RX_PACKETS },
+};
+
+static const struct iface_param ethernet_params[] = {
+	{ "Status", IFACE_STATUS },
+	{ "MACAddress", IFACE_MAC },
+	{ "Stats.BytesSent", IFACE_TX_BYTES },
+	{ "Stats.BytesReceived", IFACE_RX_BYTES },
+	{ "Stats.PacketsSent", IFACE_TX_PACKETS },
+	{ "Stats.PacketsReceived", IFACE_RX_PACKETS },
+};
+
+static const struct iface_object iface_objects[] = {
+	{
+		.native = {
+			.prefix = "InternetGatewayDevice.WANDevice.1.WANConnectionDevice.1.WANIPConnection.1.Stats.",
+			.get = iface_native_get,
+		},
+		.network = "mng",
+		.l3 = true,
+		.params = connection_params,
+		.params_num = ARRAY_SIZE(connection_params),
+	},
+	{
+		.native = {
+			.prefix = "InternetGatewayDevice.WANDevice.1.WANConnectionDevice.2.WANPPPConnection.1.Stats.",
+			.get = iface_native_get,
+		},
+		.network = "wan",
+		.l3 = true,
+		.params = connection_params,
+		.params_num = ARRAY_SIZE(connection_params),
+	},
+	{
+		.native = {
+			.prefix = "InternetGatewayDevice.WANDevice.1.WANCommonInterfaceConfig.",
+			.get = iface_native_get,
+		},
+		.network = "wan",
+		.params = common_params,
+		.params_num = ARRAY_SIZE(common_params),
+	},
+	{
+		.native = {
+			.prefix = "InternetGatewayDevice.WANDevice.1.WANEthernetInterfaceConfig.",
+			.get = iface_native_get,
+		},
+		.network = "wan",
+		.params = ethernet_params,
+		.params_num = ARRAY_SIZE(ethernet_params),
+	},
+	{
+		.native = {
+			.prefix = "InternetGatewayDevice.LANDevice.1.LANEthernetInterfaceConfig.1.",
+			.get = iface_native_get,
+		},
+		.network = "lan",
+		.params = ethernet_params,
+		.params_num = ARRAY_SIZE(ethernet_params),
+	},
+};
+
+/* file names below statistics/ in the order of enum iface_counter */
+static const char *iface_sysfs_counters[__IFACE_COUNTER_MAX] = {
+	"tx_bytes", "rx_bytes", "tx_packets", "rx_packets",
+	"tx_errors", "rx_errors", "tx_dropped", "rx_dropped",
+};
+
+static struct iface_link *links;
+static size_t links_num;
+static size_t links_size;
+static uint64_t links_sampled;
+
+static struct iface_link *iface_link_by_index(int index)
+{
+	size_t i;
+
+	for (i = 0; i < links_num; i++) {
+		if (links[i].index == index)
+			return &links[i];
+	}
+
+	return NULL;
+}
+
+static struct iface_link *iface_link_by_name(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < links_num; i++) {
+		if (!strcmp(links[i].name, name))
+			return &links[i];
+	}
+
+	return NULL;
+}
+
+static void iface_link_remove(struct iface_link *l)
+{
+	*l = links[--links_num];
+}
+
+/* kernels of other versions send the stats structs shorter or longer */
+static void iface_copy(void *dst, size_t len, const struct rtattr *rta)
+{
+	memset(dst, 0, len);
+	memcpy(dst, RTA_DATA(rta), RTA_PAYLOAD(rta) < len ?
+	       RTA_PAYLOAD(rta) : len);
+}
+
+static void iface_stats(struct iface_link *l, const struct rtnl_link_stats *s)
+{
+	l->counters[IFACE_TX_BYTES] = s->tx_bytes;
+	l->counters[IFACE_RX_BYTES] = s->rx_bytes;
+	l->counters[IFACE_TX_PACKETS] = s->tx_packets;
+	l->counters[IFACE_RX_PACKETS] = s->rx_packets;
+	l->counters[IFACE_TX_ERRORS] = s->tx_errors;
+	l->counters[IFACE_RX_ERRORS] = s->rx_errors;
+	l->counters[IFACE_TX_DROPPED] = s->tx_dropped;
+	l->counters[IFACE_RX_DROPPED] = s->rx_dropped;
+}
+
+static void iface_stats64(struct iface_link *l,
+			  const struct rtnl_link_stats64 *s)
+{
+	l->counters[IFACE_TX_BYTES] = s->tx_bytes;
+	l->counters[IFACE_RX_BYTES] = s->rx_bytes;
+	l->counters[IFACE_TX_PACKETS] = s->tx_packets;
+	l->counters[IFACE_RX_PACKETS] = s->rx_packets;
+	l->counters[IFACE_TX_ERRORS] = s->tx_errors;
+	l->counters[IFACE_RX_ERRORS] = s->rx_errors;
+	l->counters[IFACE_TX_DROPPED] = s->tx_dropped;
+	l->counters[IFACE_RX_DROPPED] = s->rx_dropped;
+}
+
+void iface_netlink(struct nlmsghdr *nlh)
+{
+	struct ifinfomsg *ifi = (struct ifinfomsg *) NLMSG_DATA(nlh);
+	struct rtattr *rta = IFLA_RTA(ifi);
+	int len = IFLA_PAYLOAD(nlh);
+	struct rtnl_link_stats64 s64;
+	struct rtnl_link_stats s;
+	struct iface_link *l;
+	bool stats64 = false;
+	uint8_t *mac;
+
+	l = iface_link_by_index(ifi->ifi_index);
+
+	if (nlh->nlmsg_type == RTM_DELLINK) {
+		if (l) iface_link_remove(l);
+		return;
+	}
+
+	if (!l) {
+		if (links_num == links_size) {
+			size_t size = links_size ? links_size * 2 : 16;
+
+			l = realloc(links, size * sizeof(*links));
+			if (!l) return;
+			links = l;
+			links_size = size;
+		}
+
+		l = &links[links_num++];
+		memset(l, 0, sizeof(*l));
+		l->index = ifi->ifi_index;
+	}
+
+	l->flags = ifi->ifi_flags;
+	l->has_stats = false;
+	l->seen = true;
+
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		switch (rta->rta_type) {
+		case IFLA_IFNAME:
+			snprintf(l->name, sizeof(l->name), "%.*s",
+				 (int) RTA_PAYLOAD(rta), (char *) RTA_DATA(rta));
+			break;
+		case IFLA_ADDRESS:
+			if (RTA_PAYLOAD(rta) != 6)
+				break;
+			mac = RTA_DATA(rta);
+			snprintf(l->mac, sizeof(l->mac),
+				 "%02x:%02x:%02x:%02x:%02x:%02x",
+				 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+			break;
+		case IFLA_STATS:
+			/* the 32 bit counters only matter on kernels without 64 bit ones */
+			if (stats64)
+				break;
+			iface_copy(&s, sizeof(s), rta);
+			iface_stats(l, &s);
+			l->has_stats = true;
+			break;
+		case IFLA_STATS64:
+			iface_copy(&s64, sizeof(s64), rta);
+			iface_stats64(l, &s64);
+			l->has_stats = stats64 = true;
+			break;
+		}
+	}
+}
+
+void iface_begin(void)
+{
+	size_t i;
+
+	for (i = 0; i < links_num; i++)
+		links[i].seen = false;
+}
+
+void iface_end(void)
+{
+	size_t i;
+
+	for (i = 0; i < links_num; ) {
+		if (!links[i].seen)
+			iface_link_remove(&links[i]);
+		else
+			i++;
+	}
+}
+
+/*
+ * notifications keep the links current but not their counters, those
+ * take a fresh dump which is only repeated once it got old
+ */
+static void iface_refresh(void)
+{
+	uint64_t now = scheduler_msecs();
+
+	if (links_sampled && now - links_sampled < IFACE_CACHE_MSECS)
+		return;
+
+	iface_begin();
+	if (netlink_dump(RTM_GETLINK, AF_UNSPEC))
+		D("couldn't dump the links, falling back to sysfs\n");
+	else
+		iface_end();
+
+	links_sampled = now;
+}
+
+const char *iface_name(int index)
+{
+	struct iface_link *l = iface_link_by_index(index);
+
+	return l ? l->name : NULL;
+}
+
+int iface_index(const char *name)
+{
+	struct iface_link *l = iface_link_by_name(name);
+
+	return l ? l->index : 0;
+}
+
+static int iface_sysfs_read(const char *dev, const char *file, char *buf,
+			    size_t len)
+{
+	char path[IFACE_PATH_MAX];
+	FILE *fp;
+	int rc = -1;
+
+	snprintf(path, sizeof(path), "%s/%s/%s", fc_iface_sysfs, dev, file);
+
+	fp = fopen(path, "r");
+	if (!fp) return -1;
+
+	if (fgets(buf, len, fp)) {
+		buf[strcspn(buf, "\n")] = '\0';
+		rc = 0;
+	}
+
+	fclose(fp);
+	return rc;
+}
+
+/*
+ * fill in what the dump could not tell; without a dump at all the whole
+ * link comes from sysfs
+ */
+static int iface_sysfs(struct iface_link *l, bool whole)
+{
+	char buf[64], file[32];
+	uint64_t counters[__IFACE_COUNTER_MAX];
+	size_t i;
+
+	if (whole) {
+		if (iface_sysfs_read(l->name, "flags", buf, sizeof(buf)))
+			return -1;
+		l->flags = strtoul(buf, NULL, 16);
+
+		if (!iface_sysfs_read(l->name, "carrier", buf, sizeof(buf)) &&
+		    !strcmp(buf, "1"))
+			l->flags |= IFF_LOWER_UP;
+
+		if (iface_sysfs_read(l->name, "address", l->mac, sizeof(l->mac)))
+			*l->mac = '\0';
+	}
+
+	for (i = 0; i < __IFACE_COUNTER_MAX; i++) {
+		snprintf(file, sizeof(file), "statistics/%s",
+			 iface_sysfs_counters[i]);
+		if (iface_sysfs_read(l->name, file, buf, sizeof(buf)))
+			return whole ? 0 : -1;
+		counters[i] = strtoull(buf, NULL, 10);
+	}
+
+	memcpy(l->counters, counters, sizeof(counters));
+	l->has_stats = true;
+	return 0;
+}
+
+/* the device behind an uci network interface, following OpenWrt naming */
+void iface_network_device(const char *network, bool l3, char *dev, size_t len)
+{
+	char *type = NULL, *proto = NULL, *ifname = NULL;
+
+	*dev = '\0';
+
+	config_uci_get("network", network, "type", &type);
+	config_uci_get("network", network, "proto", &proto);
+	config_uci_get("network", network, "ifname", &ifname);
+
+	if (l3 && proto &&
+	    (!strcmp(proto, "pppoe") || !strcmp(proto, "pppoa")))
+		snprintf(dev, len, "%s-%s", proto, network);
+	else if (type && !strcmp(type, "bridge"))
+		snprintf(dev, len, "br-%s", network);
+	else if (ifname)
+		snprintf(dev, len, "%.*s", (int) strcspn(ifname, " "), ifname);
+
+	free(type);
+	free(proto);
+	free(ifname);
+}
+
+static const struct iface_object *iface_object(const char *path)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(iface_objects); i++) {
+		if (!strncmp(path, iface_objects[i].native.prefix,
+			     strlen(iface_objects[i].native.prefix)))
+			return &iface_objects[i];
+	}
+
+	return NULL;
+}
+
+static int iface_native_get(const char *path, char **value)
+{
+	const struct iface_object *o;
+	const struct iface_param *p = NULL;
+	struct iface_link link, *l = NULL;
+	char dev[IFNAMSIZ];
+	const char *name, *v;
+	size_t i;
+
+	o = iface_object(path);
+	if (!o) return PROVIDER_NATIVE_NONE;
+
+	name = path + strlen(o->native.prefix);
+	for (i = 0; i < o->params_num; i++) {
+		if (!strcmp(o->params[i].name, name)) {
+			p = &o->params[i];
+			break;
+		}
+	}
+	if (!p) return PROVIDER_NATIVE_INVALID_NAME;
+
+	iface_refresh();
+	iface_network_device(o->network, o->l3, dev, sizeof(dev));
+
+	if (*dev) {
+		l = iface_link_by_name(dev);
+		if (!l || !l->has_stats) {
+			if (l) {
+				link = *l;
+			} else {
+				memset(&link, 0, sizeof(link));
+				snprintf(link.name, sizeof(link.name), "%s", dev);
+			}
+			if (!iface_sysfs(&link, !l))
+				l = &link;
+		}
+	}
+
+	if (p->field < __IFACE_COUNTER_MAX) {
+		/* unsignedInt counters wrap around at 2^32 whatever the kernel keeps */
+		if (asprintf(value, "%u",
+			     l ? (uint32_t) l->counters[p->field] : 0) == -1)
+			return PROVIDER_NATIVE_ERROR;
+		return PROVIDER_NATIVE_OK;
+	}
+
+	switch (p->field) {
+	case IFACE_STATUS:
+		if (!l)
+			v = "Error";
+		else if (!(l->flags & IFF_UP))
+			v = "Disabled";
+		else if (!(l->flags & IFF_LOWER_UP))
+			v = "NoLink";
+		else
+			v = "Up";
+		break;
+	case IFACE_LINK_STATUS:
+		if (!l)
+			v = "Unavailable";
+		else
+			v = (l->flags & IFF_LOWER_UP) ? "Up" : "Down";
+		break;
+	case IFACE_MAC:
+		v = l ? l->mac : "";
+		break;
+	default:
+		return PROVIDER_NATIVE_ERROR;
+	}
+
+	*value = strdup(v);
+	return *value ? PROVIDER_NATIVE_OK : PROVIDER_NATIVE_ERROR;
+}
+
+int iface_init(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(iface_objects); i++) {
+		if (provider_native_register(&iface_objects[i].native))
+			return -1;
+	}
+
+	return 0;
+}
+
+void iface_exit(void)
+{
+	free(links);
+	links = NULL;
+	links_num = links_size = 0;
+	links_sampled = 0;
+}
@@ -0,0 +1,90 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_IFACE_H__
+#define _FREECWMP_IFACE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+
+#include "provider.h"
+
+#ifdef DUMMY_MODE
+static char *fc_iface_sysfs = "./ext/tmp/sys/class/net";
+#else
+static char *fc_iface_sysfs = "/sys/class/net";
+#endif
+
+/* a GetParameterValues asks for many counters, one sample serves them all */
+#define IFACE_CACHE_MSECS	1000
+
+#define IFACE_MAC_LEN		18
+
+enum iface_counter {
+	IFACE_TX_BYTES,
+	IFACE_RX_BYTES,
+	IFACE_TX_PACKETS,
+	IFACE_RX_PACKETS,
+	IFACE_TX_ERRORS,
+	IFACE_RX_ERRORS,
+	IFACE_TX_DROPPED,
+	IFACE_RX_DROPPED,
+	__IFACE_COUNTER_MAX,
+};
+
+enum iface_field {
+	IFACE_STATUS = __IFACE_COUNTER_MAX,
+	IFACE_LINK_STATUS,
+	IFACE_MAC,
+};
+
+struct iface_link {
+	int index;
+	char name[IFNAMSIZ];
+	unsigned int flags;
+	char mac[IFACE_MAC_LEN];
+	bool has_stats;
+	uint64_t counters[__IFACE_COUNTER_MAX];
+	bool seen;
+};
+
+struct iface_param {
+	const char *name;
+	int field;
+};
+
+/*
+ * object whose parameters describe the device of an uci network
+ * interface; l3 objects refer to the ppp device on top of it, if any
+ */
+struct iface_object {
+	struct provider_native native;
+	const char *network;
+	bool l3;
+
+	const struct iface_param *params;
+	size_t params_num;
+};
+
+int iface_init(void);
+void iface_exit(void);
+void iface_netlink(struct nlmsghdr *nlh);
+void iface_begin(void);
+void iface_end(void);
+
+const char *iface_name(int index);
+int iface_index(const char *name);
+void iface_network_device(const char *network, bool l3, char *dev,
+			  size_t len);
+
+#endif
+
@@ -0,0 +1,899 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libfreecwmp.h>
+
+#include "instance.h"
+
+#include "config.h"
+#include "deferred.h"
+#include "freecwmp.h"
+
+#define INSTANCE_SECTION_MAX	64
+#define INSTANCE_LINE_MAX	320
+
+static const struct instance_param portmapping_params[] = {
+	{ "Enable", "enabled", INSTANCE_BOOL, true, "1" },
+	{ "Description", "name", INSTANCE_STRING, true, "" },
+	{ "Protocol", "proto", INSTANCE_UPPER, true, "TCP UDP" },
+	{ "ExternalPort", "src_dport", INSTANCE_STRING, true, "0" },
+	{ "InternalPort", "dest_port", INSTANCE_STRING, true, "0" },
+	{ "InternalClient", "dest_ip", INSTANCE_STRING, true, "" },
+};
+
+static const struct instance_default portmapping_defaults[] = {
+	{ "target", "DNAT" },
+	{ "src", "wan" },
+	{ "dest", "lan" },
+	{ "proto", "tcp" },
+	{ "enabled", "0" },
+};
+
+static const struct instance_param staticaddress_params[] = {
+	{ "Chaddr", "mac", INSTANCE_STRING, true, "" },
+	{ "Yiaddr", "ip", INSTANCE_STRING, true, "" },
+};
+
+static const struct instance_param forwarding_params[] = {
+	{ "Status", "Enabled", INSTANCE_CONST, false, NULL },
+	{ "StaticRoute", "1", INSTANCE_CONST, false, NULL },
+	{ "Origin", "Static", INSTANCE_CONST, false, NULL },
+	{ "DestIPAddress", "target", INSTANCE_STRING, true, "" },
+	{ "DestSubnetMask", "netmask", INSTANCE_STRING, true, "255.255.255.255" },
+	{ "GatewayIPAddress", "gateway", INSTANCE_STRING, true, "" },
+	{ "Interface", "interface", INSTANCE_STRING, true, "" },
+	{ "ForwardingMetric", "metric", INSTANCE_STRING, true, "0" },
+};
+
+static const struct instance_default forwarding_defaults[] = {
+	{ "interface", "lan" },
+};
+
+static struct instance_table instance_tables[] = {
+	{
+		.object = "Device.DHCPv4.Server.Pool.1.StaticAddress.",
+		.package = "dhcp",
+		.type = "host",
+		.name = "cwmp_host",
+		.service = "dnsmasq",
+		.params = staticaddress_params,
+		.params_num = ARRAY_SIZE(staticaddress_params),
+	},
+	{
+		.object = "Device.NAT.PortMapping.",
+		.package = "firewall",
+		.type = "redirect",
+		.name = "cwmp_redirect",
+		.service = "firewall",
+		.params = portmapping_params,
+		.params_num = ARRAY_SIZE(portmapping_params),
+		.defaults = portmapping_defaults,
+		.defaults_num = ARRAY_SIZE(portmapping_defaults),
+	},
+	{
+		.object = "Device.Routing.Router.1.IPv4Forwarding.",
+		.package = "network",
+		.type = "route",
+		.name = "cwmp_route",
+		.service = "network",
+		.embedded = true,
+		.params = forwarding_params,
+		.params_num = ARRAY_SIZE(forwarding_params),
+		.defaults = forwarding_defaults,
+		.defaults_num = ARRAY_SIZE(forwarding_defaults),
+	},
+	{
+		.object = "Device.Hosts.Host.",
+		.embedded = true,
+	},
+};
+
+static inline bool instance_claimed(const struct instance *i)
+{
+	return *i->section == '@';
+}
+
+/* claimed numbers aren't backed by a section, they are not found here */
+static struct instance *instance_by_number(struct instance_table *t,
+					   unsigned long number)
+{
+	struct instance *i;
+
+	if (!t->buckets_size)
+		return NULL;
+
+	for (i = t->by_number[number & (t->buckets_size - 1)]; i;
+	     i = i->next_number) {
+		if (i->number == number && !instance_claimed(i))
+			return i;
+	}
+
+	return NULL;
+}
+
+static struct instance *instance_by_section(struct instance_table *t,
+					    const char *section)
+{
+	struct instance *i;
+	uint32_t hash;
+
+	if (!t->buckets_size)
+		return NULL;
+
+	hash = freecwmp_hash(section, strlen(section));
+	for (i = t->by_section[hash & (t->buckets_size - 1)]; i;
+	     i = i->next_section) {
+		if (i->hash == hash && !strcmp(i->section, section))
+			return i;
+	}
+
+	return NULL;
+}
+
+static void instance_link(struct instance_table *t, struct instance *i)
+{
+	unsigned int mask = t->buckets_size - 1;
+
+	i->next_number = t->by_number[i->number & mask];
+	t->by_number[i->number & mask] = i;
+
+	i->next_section = t->by_section[i->hash & mask];
+	t->by_section[i->hash & mask] = i;
+}
+
+static int instance_grow(struct instance_table *t)
+{
+	struct instance **by_number, **by_section, *i;
+	unsigned int size;
+
+	size = t->buckets_size ? t->buckets_size * 2 : 16;
+	by_number = calloc(size, sizeof(*by_number));
+	by_section = calloc(size, sizeof(*by_section));
+	if (!by_number || !by_section) {
+		free(by_number);
+		free(by_section);
+		return -1;
+	}
+
+	free(t->by_number);
+	free(t->by_section);
+	t->by_number = by_number;
+	t->by_section = by_section;
+	t->buckets_size = size;
+
+	list_for_each_entry(i, &t->instances, list)
+		instance_link(t, i);
+	list_for_each_entry(i, &t->claims, list)
+		instance_link(t, i);
+
+	return 0;
+}
+
+/* numbers mostly grow, searching from the tail keeps the list ordered cheaply */
+static struct instance *instance_insert(struct instance_table *t,
+					unsigned long number,
+					const char *section)
+{
+	struct instance *i, *last;
+
+	if (t->instances_num + t->claims_num >= t->buckets_size &&
+	    instance_grow(t))
+		return NULL;
+
+	i = calloc(1, sizeof(*i) + strlen(section) + 1);
+	if (!i) return NULL;
+
+	strcpy(i->section, section);
+	i->number = number;
+	i->hash = freecwmp_hash(section, strlen(section));
+	instance_link(t, i);
+
+	if (number >= t->next)
+		t->next = number + 1;
+
+	/* the provider keeps its own order of what it claimed */
+	if (instance_claimed(i)) {
+		list_add_tail(&i->list, &t->claims);
+		t->claims_num++;
+		return i;
+	}
+
+	list_for_each_entry_reverse(last, &t->instances, list) {
+		if (last->number < number)
+			break;
+	}
+	list_add(&i->list, &last->list);
+
+	t->instances_num++;
+	t->serial++;
+
+	return i;
+}
+
+static void instance_remove(struct instance_table *t, struct instance *i)
+{
+	unsigned int mask = t->buckets_size - 1;
+	struct instance **p;
+
+	for (p = &t->by_number[i->number & mask]; *p; p = &(*p)->next_number) {
+		if (*p == i) {
+			*p = i->next_number;
+			break;
+		}
+	}
+
+	for (p = &t->by_section[i->hash & mask]; *p; p = &(*p)->next_section) {
+		if (*p == i) {
+			*p = i->next_section;
+			break;
+		}
+	}
+
+	list_del(&i->list);
+	if (instance_claimed(i)) {
+		t->claims_num--;
+	} else {
+		t->instances_num--;
+		t->serial++;
+	}
+	free(i);
+}
+
+static void instance_clear(struct instance_table *t)
+{
+	struct instance *i, *tmp;
+
+	list_for_each_entry_safe(i, tmp, &t->instances, list)
+		free(i);
+	list_for_each_entry_safe(i, tmp, &t->claims, list)
+		free(i);
+
+	INIT_LIST_HEAD(&t->instances);
+	INIT_LIST_HEAD(&t->claims);
+	free(t->by_number);
+	free(t->by_section);
+	t->by_number = t->by_section = NULL;
+	t->buckets_size = t->instances_num = t->claims_num = 0;
+	t->serial++;
+}
+
+static struct instance_table *instance_table_find(const char *object,
+						  size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(instance_tables); i++) {
+		if (strlen(instance_tables[i].object) == len &&
+		    !strncmp(instance_tables[i].object, object, len))
+			return &instance_tables[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * split "<object><number>.<rest>" of a table into its entry and rest;
+ * rest is NULL when path does not continue after the instance number
+ */
+static int instance_parse(const char *path, struct instance_table **t_out,
+			  struct instance **i_out, const char **rest)
+{
+	struct instance_table *t = NULL;
+	unsigned long number;
+	const char *c;
+	char *end;
+	size_t i, len;
+
+	for (i = 0; i < ARRAY_SIZE(instance_tables); i++) {
+		len = strlen(instance_tables[i].object);
+		if (!strncmp(instance_tables[i].object, path, len)) {
+			t = &instance_tables[i];
+			break;
+		}
+	}
+	if (!t) return PROVIDER_NATIVE_NONE;
+
+	c = path + len;
+	if (!isdigit(*c) || *c == '0')
+		return INSTANCE_INVALID_NAME;
+
+	errno = 0;
+	number = strtoul(c, &end, 10);
+	if (errno || *end != '.')
+		return INSTANCE_INVALID_NAME;
+
+	*t_out = t;
+	*i_out = instance_by_number(t, number);
+	*rest = end[1] ? end + 1 : NULL;
+
+	return *i_out ? INSTANCE_OK : INSTANCE_INVALID_NAME;
+}
+
+static const struct instance_param *instance_param(struct instance_table *t,
+						   const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < t->params_num; i++) {
+		if (!strcmp(t->params[i].name, name))
+			return &t->params[i];
+	}
+
+	return NULL;
+}
+
+static int instance_counter(const char *path, char **value)
+{
+	struct instance_table *t;
+	size_t i, len;
+
+	for (i = 0; i < ARRAY_SIZE(instance_tables); i++) {
+		t = &instance_tables[i];
+		len = strlen(t->object) - 1;
+
+		if (!strncmp(t->object, path, len) &&
+		    !strcmp(path + len, "NumberOfEntries")) {
+			if (asprintf(value, "%u", t->instances_num) == -1)
+				return INSTANCE_ERROR;
+			return INSTANCE_OK;
+		}
+	}
+
+	return PROVIDER_NATIVE_NONE;
+}
+
+static int instance_native_get(const char *path, char **value)
+{
+	const struct instance_param *p;
+	struct instance_table *t;
+	struct instance *i;
+	const char *rest;
+	char *v, *c;
+	int rc;
+
+	rc = instance_counter(path, value);
+	if (rc != PROVIDER_NATIVE_NONE)
+		return rc;
+
+	rc = instance_parse(path, &t, &i, &rest);
+	if (rc) return rc;
+
+	if (!rest || !(p = instance_param(t, rest)))
+		return INSTANCE_INVALID_NAME;
+
+	if (p->type == INSTANCE_CONST) {
+		*value = strdup(p->option);
+		return *value ? INSTANCE_OK : INSTANCE_ERROR;
+	}
+
+	if (config_uci_get(t->package, i->section, p->option, &v))
+		return INSTANCE_ERROR;
+
+	if (!v && !(v = strdup(p->def)))
+		return INSTANCE_ERROR;
+
+	switch (p->type) {
+	case INSTANCE_BOOL:
+		c = (!strcmp(v, "1") || !strcmp(v, "true") || !strcmp(v, "yes") ||
+		     !strcmp(v, "on") || !strcmp(v, "enabled")) ? "1" : "0";
+		free(v);
+		if (!(v = strdup(c)))
+			return INSTANCE_ERROR;
+		break;
+	case INSTANCE_UPPER:
+		for (c = v; *c; c++)
+			*c = toupper(*c);
+		break;
+	default:
+		break;
+	}
+
+	*value = v;
+	return INSTANCE_OK;
+}
+
+static int instance_native_set(const char *path, const char *value)
+{
+	const struct instance_param *p;
+	struct instance_table *t;
+	struct instance *i;
+	const char *rest;
+	char *v, *c;
+	int rc;
+
+	rc = instance_parse(path, &t, &i, &rest);
+	if (rc) return rc;
+
+	if (!rest || !(p = instance_param(t, rest)) || !p->writable)
+		return INSTANCE_INVALID_NAME;
+
+	v = strdup(value);
+	if (!v) return INSTANCE_ERROR;
+
+	switch (p->type) {
+	case INSTANCE_BOOL:
+		if (!strcmp(v, "1") || !strcmp(v, "true")) {
+			strcpy(v, "1");
+		} else if (!strcmp(v, "0") || !strcmp(v, "false")) {
+			strcpy(v, "0");
+		} else {
+			free(v);
+			return INSTANCE_INVALID_VALUE;
+		}
+		break;
+	case INSTANCE_UPPER:
+		for (c = v; *c; c++)
+			*c = tolower(*c);
+		break;
+	default:
+		break;
+	}
+
+	if (*v)
+		rc = config_uci_set(t->package, i->section, p->option, v);
+	else
+		rc = config_uci_delete(t->package, i->section, p->option);
+	free(v);
+
+	if (rc) return INSTANCE_ERROR;
+
+	t->dirty = true;
+	t->serial++;
+	return INSTANCE_OK;
+}
+
+static int instance_native_commit(void)
+{
+	struct instance_table *t;
+	size_t i;
+	int rc = 0;
+
+	for (i = 0; i < ARRAY_SIZE(instance_tables); i++) {
+		t = &instance_tables[i];
+		if (!t->dirty)
+			continue;
+
+		if (config_uci_commit(t->package) ||
+		    deferred_add(DEFERRED_RELOAD, t->service))
+			rc = -1;
+		t->dirty = false;
+	}
+
+	return rc;
+}
+
+/* uncommitted changes only live in the uci context, reloading drops them */
+static void instance_native_abort(void)
+{
+	struct instance_table *t;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(instance_tables); i++) {
+		t = &instance_tables[i];
+		if (!t->dirty)
+			continue;
+
+		config_uci_load(t->package, true);
+		t->dirty = false;
+		t->serial++;
+	}
+}
+
+/* lowest instance number not below from, 0 when there is none */
+static int instance_native_instance(const char *object, unsigned long from,
+				    unsigned long *number)
+{
+	struct instance_table *t;
+	struct instance *i;
+
+	t = instance_table_find(object, strlen(object));
+	if (!t) return PROVIDER_NATIVE_NONE;
+
+	*number = 0;
+
+	/* walks ask for the successor of the last number they got */
+	if (!(i = instance_by_number(t, from)) &&
+	    from > 1 && (i = instance_by_number(t, from - 1))) {
+		if (i->list.next == &t->instances)
+			return INSTANCE_OK;
+		i = list_entry(i->list.next, struct instance, list);
+	}
+
+	if (!i) {
+		list_for_each_entry(i, &t->instances, list) {
+			if (i->number >= from)
+				break;
+		}
+		if (&i->list == &t->instances)
+			return INSTANCE_OK;
+	}
+
+	*number = i->number;
+	return INSTANCE_OK;
+}
+
+/*
+ * one "<object> <next>" line per table followed by a "<number> <section>"
+ * line for each of its entries, or a "<number> @<key>" line for each
+ * claimed number in the claims file
+ */
+static int instance_write(const char *path, bool claims)
+{
+	struct instance_table *t;
+	struct instance *i;
+	size_t n;
+	char *tmp;
+	FILE *fp;
+
+	if (freecwmp_mkdir_parent(path)) {
+		D("couldn't create directory for %s\n", path);
+		return -1;
+	}
+
+	if (asprintf(&tmp, "%s.tmp", path) == -1)
+		return -1;
+
+	fp = fopen(tmp, "w");
+	if (!fp) goto error;
+
+	for (n = 0; n < ARRAY_SIZE(instance_tables); n++) {
+		t = &instance_tables[n];
+
+		if (fprintf(fp, "%s %lu\n", t->object, t->next) < 0)
+			goto error_close;
+
+		list_for_each_entry(i, claims ? &t->claims : &t->instances,
+				    list) {
+			if (fprintf(fp, "%lu %s\n", i->number, i->section) < 0)
+				goto error_close;
+		}
+	}
+
+	if (fflush(fp) || fsync(fileno(fp)))
+		goto error_close;
+
+	if (fclose(fp)) goto error;
+	if (rename(tmp, path)) goto error;
+
+	free(tmp);
+	return 0;
+
+error_close:
+	fclose(fp);
+error:
+	D("couldn't save instance numbers\n");
+	remove(tmp);
+	free(tmp);
+	return -1;
+}
+
+static int instance_save(void)
+{
+	return instance_write(fc_instances, false);
+}
+
+static int instance_load(const char *path)
+{
+	char line[INSTANCE_LINE_MAX], name[INSTANCE_LINE_MAX];
+	struct instance_table *t = NULL;
+	unsigned long number;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) return errno == ENOENT ? 0 : -1;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%lu %63s", &number, name) == 2) {
+			if (t && !instance_insert(t, number, name))
+				goto error;
+			continue;
+		}
+
+		if (sscanf(line, "%255s %lu", name, &number) != 2)
+			continue;
+
+		/* tables that are gone are dropped with the next save */
+		t = instance_table_find(name, strlen(name));
+		if (t && number > t->next)
+			t->next = number;
+	}
+
+	fclose(fp);
+	return 0;
+
+error:
+	fclose(fp);
+	return -1;
+}
+
+/*
+ * bring the mapping in line with the uci sections: vanished sections drop
+ * their number, new ones get fresh numbers in uci order; the config of
+ * the user is left alone, anonymous sections are known by the name uci
+ * gives them and only get a new number when that name changes
+ */
+static int instance_sync_table(struct instance_table *t, bool *changed)
+{
+	struct uci_package *p;
+	struct uci_element *e;
+	struct uci_section *s;
+	struct instance *i, *tmp;
+
+	if (!t->package)
+		return 0;
+
+	p = config_uci_load(t->package, true);
+	if (!p) return -1;
+
+	/* the options may have been edited behind our back */
+	t->serial++;
+
+	list_for_each_entry(i, &t->instances, list)
+		i->seen = false;
+
+	uci_foreach_element(&p->sections, e) {
+		s = uci_to_section(e);
+		if (strcmp(s->type, t->type))
+			continue;
+
+		i = instance_by_section(t, s->e.name);
+		if (!i) {
+			i = instance_insert(t, t->next, s->e.name);
+			if (!i) return -1;
+			*changed = true;
+		}
+
+		i->seen = true;
+	}
+
+	list_for_each_entry_safe(i, tmp, &t->instances, list) {
+		if (!i->seen) {
+			instance_remove(t, i);
+			*changed = true;
+		}
+	}
+
+	return 0;
+}
+
+int instance_sync(void)
+{
+	bool changed = false;
+	size_t i;
+	int rc = 0;
+
+	for (i = 0; i < ARRAY_SIZE(instance_tables); i++) {
+		if (instance_sync_table(&instance_tables[i], &changed))
+			rc = -1;
+	}
+
+	if (changed && instance_save())
+		rc = -1;
+
+	return rc;
+}
+
+int instance_add(const char *object, unsigned long *number)
+{
+	char section[INSTANCE_SECTION_MAX];
+	struct instance_table *t;
+	struct instance *i;
+	size_t n;
+
+	t = instance_table_find(object, strlen(object));
+	if (!t || !t->package) return INSTANCE_INVALID_NAME;
+
+	snprintf(section, sizeof(section), "%s%lu", t->name, t->next);
+
+	if (config_uci_set(t->package, section, NULL, t->type))
+		goto error;
+
+	for (n = 0; n < t->defaults_num; n++) {
+		if (config_uci_set(t->package, section, t->defaults[n].option,
+				   t->defaults[n].value))
+			goto error;
+	}
+
+	if (config_uci_commit(t->package))
+		goto error;
+
+	i = instance_insert(t, t->next, section);
+	if (!i) return INSTANCE_ERROR;
+
+	*number = i->number;
+
+	/* the number must never be handed out again, even after a crash */
+	if (instance_save() || deferred_add(DEFERRED_RELOAD, t->service))
+		return INSTANCE_ERROR;
+
+	return INSTANCE_OK;
+
+error:
+	/* drop whatever did not make it into the commit */
+	config_uci_load(t->package, true);
+	t->serial++;
+	return INSTANCE_ERROR;
+}
+
+int instance_delete(const char *object)
+{
+	struct instance_table *t;
+	struct instance *i;
+	const char *rest;
+	int rc;
+
+	rc = instance_parse(object, &t, &i, &rest);
+	if (rc == PROVIDER_NATIVE_NONE || rest)
+		return INSTANCE_INVALID_NAME;
+	if (rc) return rc;
+
+	if (config_uci_delete(t->package, i->section, NULL) ||
+	    config_uci_commit(t->package)) {
+		config_uci_load(t->package, true);
+		t->serial++;
+		return INSTANCE_ERROR;
+	}
+
+	instance_remove(t, i);
+
+	if (instance_save() || deferred_add(DEFERRED_RELOAD, t->service))
+		return INSTANCE_ERROR;
+
+	return INSTANCE_OK;
+}
+
+struct instance_table *instance_table(const char *object)
+{
+	return instance_table_find(object, strlen(object));
+}
+
+int instance_get(const char *path, char **value)
+{
+	return instance_native_get(path, value);
+}
+
+int instance_set(const char *path, const char *value)
+{
+	return instance_native_set(path, value);
+}
+
+int instance_number(const char *object, unsigned long from,
+		    unsigned long *number)
+{
+	return instance_native_instance(object, from, number);
+}
+
+void instance_claim_begin(const char *object)
+{
+	struct instance_table *t;
+	struct instance *i;
+
+	t = instance_table_find(object, strlen(object));
+	if (!t) return;
+
+	list_for_each_entry(i, &t->claims, list)
+		i->seen = false;
+}
+
+int instance_claim(const char *object, const char *key,
+		   unsigned long *number)
+{
+	char section[INSTANCE_SECTION_MAX];
+	struct instance_table *t;
+	struct instance *i;
+
+	t = instance_table_find(object, strlen(object));
+	if (!t) return INSTANCE_INVALID_NAME;
+
+	if (snprintf(section, sizeof(section), "@%s", key) >=
+	    (int) sizeof(section))
+		return INSTANCE_INVALID_NAME;
+
+	i = instance_by_section(t, section);
+	if (i && i->seen)
+		return INSTANCE_INVALID_NAME;
+
+	if (!i) {
+		i = instance_insert(t, t->next, section);
+		if (!i) return INSTANCE_ERROR;
+		t->claims_changed = true;
+	}
+
+	i->seen = true;
+	*number = i->number;
+	return INSTANCE_OK;
+}
+
+/* new numbers are written out before anyone gets to see them */
+int instance_claim_end(const char *object)
+{
+	struct instance_table *t;
+	struct instance *i, *tmp;
+
+	t = instance_table_find(object, strlen(object));
+	if (!t) return INSTANCE_INVALID_NAME;
+
+	list_for_each_entry_safe(i, tmp, &t->claims, list) {
+		if (!i->seen) {
+			instance_remove(t, i);
+			t->claims_changed = true;
+		}
+	}
+
+	if (!t->claims_changed)
+		return INSTANCE_OK;
+
+	if (instance_write(fc_instance_claims, true))
+		return INSTANCE_ERROR;
+
+	t->claims_changed = false;
+	return INSTANCE_OK;
+}
+
+int instance_init(void)
+{
+	struct instance_table *t;
+	size_t i, len;
+
+	for (i = 0; i < ARRAY_SIZE(instance_tables); i++) {
+		t = &instance_tables[i];
+
+		INIT_LIST_HEAD(&t->instances);
+		INIT_LIST_HEAD(&t->claims);
+		t->next = 1;
+
+		/* the counter lives in the parent object, own it from there */
+		len = strlen(t->object) - 1;
+		while (len && t->object[len - 1] != '.')
+			len--;
+
+		t->native.prefix = strndup(t->object, len);
+		if (!t->native.prefix)
+			return -1;
+
+		t->native.get = instance_native_get;
+		t->native.set = instance_native_set;
+		t->native.commit = instance_native_commit;
+		t->native.abort = instance_native_abort;
+		t->native.instance = instance_native_instance;
+
+		if (!t->embedded && provider_native_register(&t->native))
+			return -1;
+	}
+
+	if (instance_load(fc_instances)) {
+		D("%s is not a valid instance file\n", fc_instances);
+		for (i = 0; i < ARRAY_SIZE(instance_tables); i++)
+			instance_clear(&instance_tables[i]);
+	}
+
+	/* a restart of the daemon keeps the numbers of the kernel entries */
+	if (instance_load(fc_instance_claims))
+		D("%s is not a valid claims file\n", fc_instance_claims);
+
+	return instance_sync();
+}
+
+void instance_exit(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(instance_tables); i++) {
+		instance_clear(&instance_tables[i]);
+		free((char *) instance_tables[i].native.prefix);
+		instance_tables[i].native.prefix = NULL;
+	}
+}
@@ -0,0 +1,139 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_INSTANCE_H__
+#define _FREECWMP_INSTANCE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <libubox/list.h>
+
+#include "provider.h"
+
+/* claimed numbers change with the kernel tables, they stay off flash */
+#ifdef DUMMY_MODE
+static char *fc_instances = "./ext/tmp/freecwmp_instances";
+static char *fc_instance_claims = "./ext/tmp/freecwmp_claims";
+#else
+static char *fc_instances = "/etc/freecwmp/instances";
+static char *fc_instance_claims = "/tmp/freecwmp_claims";
+#endif
+
+/* shared with the native provider callbacks */
+enum instance_error {
+	INSTANCE_OK = PROVIDER_NATIVE_OK,
+	INSTANCE_ERROR = PROVIDER_NATIVE_ERROR,
+	INSTANCE_INVALID_NAME = PROVIDER_NATIVE_INVALID_NAME,
+	INSTANCE_INVALID_VALUE = PROVIDER_NATIVE_INVALID_VALUE,
+};
+
+enum instance_param_type {
+	INSTANCE_STRING,
+	INSTANCE_BOOL,
+	INSTANCE_UPPER,		/* stored in lower case by uci */
+	INSTANCE_CONST,		/* option holds the value itself */
+};
+
+/* parameter of a table entry backed by an uci option of its section */
+struct instance_param {
+	const char *name;
+	const char *option;
+	enum instance_param_type type;
+	bool writable;
+	const char *def;
+};
+
+/* options set on sections created by AddObject */
+struct instance_default {
+	const char *option;
+	const char *value;
+};
+
+struct instance {
+	struct list_head list;
+	struct instance *next_number;
+	struct instance *next_section;
+	uint32_t hash;
+
+	unsigned long number;
+	bool seen;
+
+	char section[];
+};
+
+/*
+ * multi-instance object whose entries are the uci sections of one type;
+ * instance numbers are handed out from next and never reused, sections
+ * created by freecwmp are named <name><number>; entries the provider
+ * merges in from elsewhere claim their numbers from the same sequence
+ * and are kept apart under "@<key>", a name uci never gives a section;
+ * tables without a package have nothing but claims
+ */
+struct instance_table {
+	const char *object;
+	const char *package;
+	const char *type;
+	const char *name;
+	const char *service;	/* reloaded after changes */
+	bool embedded;		/* served by another provider, see instance_get */
+
+	const struct instance_param *params;
+	size_t params_num;
+	const struct instance_default *defaults;
+	size_t defaults_num;
+
+	struct provider_native native;
+
+	unsigned long next;
+	bool dirty;
+	unsigned long serial;	/* bumped whenever entries or values may change */
+
+	/* entries ordered by number plus both directions of the mapping */
+	struct list_head instances;
+	struct instance **by_number;
+	struct instance **by_section;
+	unsigned int buckets_size;
+	unsigned int instances_num;
+
+	struct list_head claims;
+	unsigned int claims_num;
+	bool claims_changed;
+};
+
+int instance_init(void);
+void instance_exit(void);
+int instance_sync(void);
+
+int instance_add(const char *object, unsigned long *number);
+int instance_delete(const char *object);
+
+/*
+ * embedded tables are not registered as native providers, the provider
+ * that merges them with entries of its own passes their paths on here
+ */
+struct instance_table *instance_table(const char *object);
+int instance_get(const char *path, char **value);
+int instance_set(const char *path, const char *value);
+int instance_number(const char *object, unsigned long from,
+		    unsigned long *number);
+
+/*
+ * numbers of entries that are no uci sections; every key claimed between
+ * instance_claim_begin() and instance_claim_end() keeps its number, the
+ * others are dropped; claiming a key twice in one round is refused
+ */
+void instance_claim_begin(const char *object);
+int instance_claim(const char *object, const char *key,
+		   unsigned long *number);
+int instance_claim_end(const char *object);
+
+#endif
+
@@ -0,0 +1,288 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libfreecwmp.h>
+
+#include "mapping.h"
+
+#include "config.h"
+#include "deferred.h"
+#include "freecwmp.h"
+#include "provider.h"
+
+static int mapping_native_get(const char *path, char **value);
+static int mapping_native_set(const char *path, const char *value);
+static int mapping_native_commit(void);
+static void mapping_native_abort(void);
+
+/* asked last, after every provider that owns a more specific prefix */
+static const struct provider_native mapping_native = {
+	.prefix = "",
+	.get = mapping_native_get,
+	.set = mapping_native_set,
+	.commit = mapping_native_commit,
+	.abort = mapping_native_abort,
+};
+
+static const char *mapping_types[] = {
+	[MAPPING_STRING] = "string",
+	[MAPPING_BOOLEAN] = "boolean",
+	[MAPPING_INT] = "int",
+	[MAPPING_UNSIGNED_INT] = "unsignedInt",
+};
+
+static struct mapping *mappings;
+static size_t mappings_num;
+static size_t mappings_size;
+static bool mappings_sorted;
+
+static int mapping_cmp(const void *a, const void *b)
+{
+	const struct mapping *m1 = a, *m2 = b;
+
+	return strcmp(m1->parameter, m2->parameter);
+}
+
+static struct mapping *mapping_find(const char *path)
+{
+	struct mapping key = { .parameter = (char *) path };
+
+	if (!mappings_sorted)
+		return NULL;
+
+	return bsearch(&key, mappings, mappings_num, sizeof(*mappings),
+		       mapping_cmp);
+}
+
+static void mapping_free(struct mapping *m)
+{
+	free(m->parameter);
+	free(m->uci);
+	free(m->package);
+	free(m->def);
+	free(m->service);
+}
+
+void mapping_clear(void)
+{
+	size_t i;
+
+	for (i = 0; i < mappings_num; i++)
+		mapping_free(&mappings[i]);
+
+	mappings_num = 0;
+	mappings_sorted = false;
+}
+
+int mapping_add(const char *parameter, const char *uci, const char *type,
+		const char *def, const char *service, bool writable,
+		bool hidden)
+{
+	struct mapping *m;
+	const char *c;
+	size_t i;
+
+	/* package, section and option, nothing less */
+	c = strchr(uci, '.');
+	if (!c || c == uci || !strchr(c + 1, '.')) {
+		D("mapping of %s to '%s' is no uci option\n", parameter, uci);
+		return -1;
+	}
+
+	for (i = 0; i < mappings_num; i++) {
+		if (!strcmp(mappings[i].parameter, parameter)) {
+			D("%s is mapped more than once\n", parameter);
+			return -1;
+		}
+	}
+
+	if (mappings_num == mappings_size) {
+		size_t size = mappings_size ? mappings_size * 2 : 32;
+		m = realloc(mappings, size * sizeof(*mappings));
+		if (!m) return -1;
+		mappings = m;
+		mappings_size = size;
+	}
+
+	m = &mappings[mappings_num];
+	memset(m, 0, sizeof(*m));
+
+	m->type = MAPPING_STRING;
+	for (i = 0; type && i < ARRAY_SIZE(mapping_types); i++) {
+		if (!strcmp(type, mapping_types[i]))
+			break;
+	}
+	if (type && i == ARRAY_SIZE(mapping_types)) {
+		D("%s has unknown type '%s'\n", parameter, type);
+		return -1;
+	}
+	if (type)
+		m->type = i;
+
+	m->parameter = strdup(parameter);
+	m->uci = strdup(uci);
+	m->package = strndup(uci, c - uci);
+	m->def = strdup(def ? def : "");
+	m->service = service ? strdup(service) : NULL;
+	m->writable = writable;
+	m->hidden = hidden;
+
+	if (!m->parameter || !m->uci || !m->package || !m->def ||
+	    (service && !m->service)) {
+		mapping_free(m);
+		return -1;
+	}
+
+	mappings_num++;
+	mappings_sorted = false;
+	return 0;
+}
+
+void mapping_sort(void)
+{
+	qsort(mappings, mappings_num, sizeof(*mappings), mapping_cmp);
+	mappings_sorted = true;
+}
+
+static int mapping_native_get(const char *path, char **value)
+{
+	struct mapping *m = mapping_find(path);
+	char *v;
+
+	if (!m) return PROVIDER_NATIVE_NONE;
+
+	if (m->hidden) {
+		*value = strdup("");
+		return *value ? PROVIDER_NATIVE_OK : PROVIDER_NATIVE_ERROR;
+	}
+
+	if (config_uci_get_path(m->uci, &v))
+		return PROVIDER_NATIVE_ERROR;
+
+	if (!v && !(v = strdup(m->def)))
+		return PROVIDER_NATIVE_ERROR;
+
+	if (m->type == MAPPING_BOOLEAN && *v) {
+		v[0] = freecwmp_true(v) ? '1' : '0';
+		v[1] = '\0';
+	}
+
+	*value = v;
+	return PROVIDER_NATIVE_OK;
+}
+
+/* only values of the declared type make it into uci */
+static bool mapping_valid(const struct mapping *m, const char *value)
+{
+	char *end;
+
+	if (!*value)
+		return true;
+
+	errno = 0;
+
+	switch (m->type) {
+	case MAPPING_BOOLEAN:
+		return !strcmp(value, "1") || !strcmp(value, "0") ||
+		       !strcmp(value, "true") || !strcmp(value, "false");
+	case MAPPING_INT:
+		strtol(value, &end, 10);
+		return !errno && !*end;
+	case MAPPING_UNSIGNED_INT:
+		strtoul(value, &end, 10);
+		return *value != '-' && !errno && !*end;
+	default:
+		return true;
+	}
+}
+
+static int mapping_native_set(const char *path, const char *value)
+{
+	struct mapping *m = mapping_find(path);
+
+	if (!m) return PROVIDER_NATIVE_NONE;
+
+	if (!m->writable)
+		return PROVIDER_NATIVE_INVALID_NAME;
+
+	if (!mapping_valid(m, value))
+		return PROVIDER_NATIVE_INVALID_VALUE;
+
+	if (m->type == MAPPING_BOOLEAN && *value)
+		value = (!strcmp(value, "1") || !strcmp(value, "true")) ?
+			"1" : "0";
+
+	if (config_uci_set_path(m->uci, value))
+		return PROVIDER_NATIVE_ERROR;
+
+	m->dirty = true;
+	return PROVIDER_NATIVE_OK;
+}
+
+/* every touched package is committed once, services reloaded after the session */
+static int mapping_native_commit(void)
+{
+	size_t i, j;
+	int rc = 0;
+
+	for (i = 0; i < mappings_num; i++) {
+		if (!mappings[i].dirty)
+			continue;
+
+		if (config_uci_commit(mappings[i].package))
+			rc = -1;
+
+		for (j = i; j < mappings_num; j++) {
+			if (!mappings[j].dirty ||
+			    strcmp(mappings[j].package, mappings[i].package))
+				continue;
+
+			if (mappings[j].service &&
+			    deferred_add(DEFERRED_RELOAD, mappings[j].service))
+				rc = -1;
+			mappings[j].dirty = false;
+		}
+	}
+
+	return rc;
+}
+
+static void mapping_native_abort(void)
+{
+	size_t i, j;
+
+	for (i = 0; i < mappings_num; i++) {
+		if (!mappings[i].dirty)
+			continue;
+
+		config_uci_load(mappings[i].package, true);
+
+		for (j = i; j < mappings_num; j++) {
+			if (!strcmp(mappings[j].package, mappings[i].package))
+				mappings[j].dirty = false;
+		}
+	}
+}
+
+int mapping_init(void)
+{
+	return provider_native_register(&mapping_native);
+}
+
+void mapping_exit(void)
+{
+	mapping_clear();
+	free(mappings);
+	mappings = NULL;
+	mappings_size = 0;
+}
@@ -0,0 +1,49 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_MAPPING_H__
+#define _FREECWMP_MAPPING_H__
+
+#include <stdbool.h>
+
+enum mapping_type {
+	MAPPING_STRING,
+	MAPPING_BOOLEAN,
+	MAPPING_INT,
+	MAPPING_UNSIGNED_INT,
+};
+
+/*
+ * parameter that is nothing but one uci option, declared by a mapping
+ * section of the freecwmp package; uci holds package.section.option as
+ * the uci command line takes it
+ */
+struct mapping {
+	char *parameter;
+	char *uci;
+	char *package;
+	char *def;
+	char *service;		/* reloaded after changes */
+	enum mapping_type type;
+	bool writable;
+	bool hidden;		/* write-only, reads back empty */
+	bool dirty;
+};
+
+int mapping_init(void);
+void mapping_exit(void);
+
+void mapping_clear(void);
+int mapping_add(const char *parameter, const char *uci, const char *type,
+		const char *def, const char *service, bool writable,
+		bool hidden);
+void mapping_sort(void);
+
+#endif
+
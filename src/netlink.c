@@ -0,0 +1,217 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/rtnetlink.h>
+
+#include <libfreecwmp.h>
+#include <libubox/uloop.h>
+
+#include "netlink.h"
+
+#include "address.h"
+#include "freecwmp.h"
+#include "iface.h"
+#include "route.h"
+
+static void netlink_new_msg(struct uloop_fd *ufd, unsigned events);
+
+static struct uloop_fd netlink_event = { .cb = netlink_new_msg, .fd = -1 };
+
+static const struct netlink_handler netlink_handlers[] = {
+	{ RTM_NEWLINK, iface_netlink },
+	{ RTM_DELLINK, iface_netlink },
+	{ RTM_NEWADDR, address_netlink },
+	{ RTM_DELADDR, address_netlink },
+	{ RTM_NEWROUTE, route_netlink },
+	{ RTM_DELROUTE, route_netlink },
+};
+
+/* links come first, the other tables refer to them by index */
+static const struct netlink_table netlink_tables[] = {
+	{ RTM_GETLINK, AF_UNSPEC, iface_begin, iface_end },
+	{ RTM_GETADDR, AF_UNSPEC, address_begin, address_end },
+	{ RTM_GETROUTE, AF_INET, route_begin, route_end },
+};
+
+/* 1 once the end of a dump was seen, -1 on errors */
+static int netlink_parse(struct nlmsghdr *nlh, ssize_t len)
+{
+	size_t i;
+
+	for (; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+		if (nlh->nlmsg_type == NLMSG_DONE)
+			return 1;
+
+		if (nlh->nlmsg_type == NLMSG_ERROR) {
+			DD("netlink request failed\n");
+			return -1;
+		}
+
+		for (i = 0; i < ARRAY_SIZE(netlink_handlers); i++) {
+			if (netlink_handlers[i].type == nlh->nlmsg_type)
+				netlink_handlers[i].cb(nlh);
+		}
+	}
+
+	if (len) {
+		DD("netlink message is not NLMSG_OK\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void netlink_new_msg(struct uloop_fd *ufd, unsigned events)
+{
+	char buffer[NETLINK_BUFFER_SIZE];
+	ssize_t len;
+
+	/* edge triggered, read until the socket is drained */
+	while (1) {
+		len = recv(ufd->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOBUFS) {
+				/* notifications were dropped, only a full dump can tell which */
+				freecwmp_log_message(NAME, L_NOTICE,
+						     "netlink overrun, resyncing\n");
+				if (netlink_resync())
+					D("netlink resync failed\n");
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				DD("error receiving netlink message\n");
+			return;
+		}
+
+		netlink_parse((struct nlmsghdr *) buffer, len);
+	}
+}
+
+/*
+ * request a full table on a socket of its own and pass every entry to the
+ * handlers just like a notification
+ */
+int netlink_dump(int type, int family)
+{
+	struct {
+		struct nlmsghdr hdr;
+		struct rtgenmsg msg;
+	} req;
+	char buffer[NETLINK_BUFFER_SIZE];
+	ssize_t len;
+	int fd, rc = 0;
+
+	fd = socket(PF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (fd == -1) {
+		D("couldn't open NETLINK_ROUTE socket\n");
+		return -1;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(req.msg));
+	req.hdr.nlmsg_type = type;
+	req.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.hdr.nlmsg_seq = 1;
+	req.msg.rtgen_family = family;
+
+	if (send(fd, &req, req.hdr.nlmsg_len, 0) == -1) {
+		D("couldn't send netlink request\n");
+		rc = -1;
+	}
+
+	while (!rc) {
+		len = recv(fd, buffer, sizeof(buffer), 0);
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+			D("error receiving netlink message\n");
+			rc = -1;
+			break;
+		}
+
+		rc = netlink_parse((struct nlmsghdr *) buffer, len);
+	}
+
+	close(fd);
+	return rc < 0 ? -1 : 0;
+}
+
+/*
+ * dump every table again; entries the dumps did not mention any more are
+ * dropped, a table whose dump failed keeps what it had
+ */
+int netlink_resync(void)
+{
+	const struct netlink_table *t;
+	size_t i;
+	int rc = 0;
+
+	for (i = 0; i < ARRAY_SIZE(netlink_tables); i++) {
+		t = &netlink_tables[i];
+
+		t->begin();
+		if (netlink_dump(t->type, t->family))
+			rc = -1;
+		else
+			t->end();
+	}
+
+	return rc;
+}
+
+int netlink_init(void)
+{
+	struct sockaddr_nl addr;
+	int fd, size = NETLINK_RCVBUF;
+
+	fd = socket(PF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		    NETLINK_ROUTE);
+	if (fd == -1) {
+		D("couldn't open NETLINK_ROUTE socket\n");
+		return -1;
+	}
+
+	/* bursts of address and route changes must not overrun the socket */
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) &&
+	    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)))
+		D("couldn't grow the netlink receive buffer\n");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR |
+			 RTMGRP_IPV4_ROUTE;
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+		D("couldn't bind netlink socket\n");
+		close(fd);
+		return -1;
+	}
+
+	netlink_event.fd = fd;
+	uloop_fd_add(&netlink_event, ULOOP_READ | ULOOP_EDGE_TRIGGER);
+
+	/* subscribed first, so no change between the dumps can get lost */
+	return netlink_resync();
+}
+
+void netlink_exit(void)
+{
+	if (netlink_event.fd == -1)
+		return;
+
+	uloop_fd_delete(&netlink_event);
+	close(netlink_event.fd);
+	netlink_event.fd = -1;
+}
@@ -0,0 +1,41 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_NETLINK_H__
+#define _FREECWMP_NETLINK_H__
+
+#include <linux/netlink.h>
+
+/* large enough for a full dump part, the kernel uses a page at most */
+#define NETLINK_BUFFER_SIZE	8192
+
+/* socket buffer for notifications, a full one costs a resync */
+#define NETLINK_RCVBUF		(1024 * 1024)
+
+/* rtnetlink messages of one type are handed to their subsystem */
+struct netlink_handler {
+	int type;
+	void (*cb)(struct nlmsghdr *nlh);
+};
+
+/* table mirrored from a dump, begin and end bracket a resync of it */
+struct netlink_table {
+	int type;
+	int family;
+	void (*begin)(void);
+	void (*end)(void);
+};
+
+int netlink_init(void);
+void netlink_exit(void);
+int netlink_dump(int type, int family);
+int netlink_resync(void);
+
+#endif
+
@@ -0,0 +1,191 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libfreecwmp.h>
+
+#include "plugin.h"
+
+#include "freecwmp.h"
+#include "schema.h"
+
+/* results of the plugins are passed on as they are */
+typedef char plugin_result_check[
+	((int) FREECWMP_PLUGIN_OK == PROVIDER_NATIVE_OK &&
+	 (int) FREECWMP_PLUGIN_ERROR == PROVIDER_NATIVE_ERROR &&
+	 (int) FREECWMP_PLUGIN_NONE == PROVIDER_NATIVE_NONE &&
+	 (int) FREECWMP_PLUGIN_INVALID_NAME == PROVIDER_NATIVE_INVALID_NAME &&
+	 (int) FREECWMP_PLUGIN_INVALID_VALUE == PROVIDER_NATIVE_INVALID_VALUE) ?
+	1 : -1];
+
+static struct plugin *plugins;
+static size_t plugins_num;
+static size_t plugins_size;
+
+int plugin_add(const char *path)
+{
+	struct plugin *p;
+	size_t i;
+
+	for (i = 0; i < plugins_num; i++) {
+		if (!strcmp(plugins[i].path, path))
+			return 0;
+	}
+
+	if (plugins_num == plugins_size) {
+		size_t size = plugins_size ? plugins_size * 2 : 4;
+		p = realloc(plugins, size * sizeof(*plugins));
+		if (!p) return -1;
+		plugins = p;
+		plugins_size = size;
+	}
+
+	p = &plugins[plugins_num];
+	memset(p, 0, sizeof(*p));
+
+	p->path = strdup(path);
+	if (!p->path) return -1;
+
+	plugins_num++;
+	return 0;
+}
+
+static void plugin_unload(struct plugin *p)
+{
+	while (p->natives_num)
+		provider_native_unregister(&p->natives[--p->natives_num]);
+
+	free(p->natives);
+	p->natives = NULL;
+
+	if (p->plugin && p->plugin->exit)
+		p->plugin->exit();
+	p->plugin = NULL;
+
+	if (p->handle)
+		dlclose(p->handle);
+	p->handle = NULL;
+}
+
+/*
+ * the providers are copied into native providers, from then on a plugin
+ * is asked exactly like the providers built into the daemon
+ */
+static int plugin_load(struct plugin *p)
+{
+	const struct freecwmp_plugin *plugin;
+	const struct freecwmp_plugin_provider *provider;
+	struct schema_param param;
+	size_t i;
+
+	p->handle = dlopen(p->path, RTLD_NOW | RTLD_LOCAL);
+	if (!p->handle) {
+		D("loading %s failed: %s\n", p->path, dlerror());
+		return -1;
+	}
+
+	plugin = dlsym(p->handle, FREECWMP_PLUGIN_SYMBOL);
+	if (!plugin) {
+		D("%s exports no %s\n", p->path, FREECWMP_PLUGIN_SYMBOL);
+		goto error;
+	}
+
+	if (plugin->abi != FREECWMP_PLUGIN_ABI) {
+		D("%s is built for plugin abi %u, not %u\n",
+		  p->path, plugin->abi, FREECWMP_PLUGIN_ABI);
+		goto error;
+	}
+
+	for (i = 0; i < plugin->providers_num; i++) {
+		if (!plugin->providers[i].prefix) {
+			D("provider %zu of %s has no prefix\n", i, p->path);
+			goto error;
+		}
+	}
+
+	if (plugin->init && plugin->init()) {
+		D("initialization of %s failed\n", p->path);
+		goto error;
+	}
+	p->plugin = plugin;
+
+	if (plugin->providers_num) {
+		p->natives = calloc(plugin->providers_num, sizeof(*p->natives));
+		if (!p->natives) goto error;
+	}
+
+	for (i = 0; i < plugin->providers_num; i++) {
+		provider = &plugin->providers[i];
+
+		p->natives[i].prefix = provider->prefix;
+		p->natives[i].get = provider->get;
+		p->natives[i].set = provider->set;
+		p->natives[i].commit = provider->commit;
+		p->natives[i].abort = provider->abort;
+		p->natives[i].instance = provider->instance;
+
+		if (provider_native_register(&p->natives[i])) {
+			D("no room for the providers of %s\n", p->path);
+			goto error;
+		}
+		p->natives_num++;
+	}
+
+	/* parameters can't be taken back, they come last */
+	memset(&param, 0, sizeof(param));
+	for (i = 0; i < plugin->params_num; i++) {
+		param.path = plugin->params[i].path;
+		param.writable = plugin->params[i].writable;
+
+		if (schema_register(&param))
+			goto error;
+	}
+
+	freecwmp_log_message(NAME, L_NOTICE, "loaded plugin %s\n",
+			     plugin->name ? plugin->name : p->path);
+	return 0;
+
+error:
+	plugin_unload(p);
+	return -1;
+}
+
+/* a broken plugin only costs its own parameters */
+int plugin_init(void)
+{
+	size_t i;
+	int rc = 0;
+
+	for (i = 0; i < plugins_num; i++) {
+		if (plugins[i].handle)
+			continue;
+
+		if (plugin_load(&plugins[i]))
+			rc = -1;
+	}
+
+	return rc;
+}
+
+void plugin_exit(void)
+{
+	size_t i;
+
+	for (i = plugins_num; i > 0; i--) {
+		plugin_unload(&plugins[i - 1]);
+		free(plugins[i - 1].path);
+	}
+
+	free(plugins);
+	plugins = NULL;
+	plugins_num = plugins_size = 0;
+}
@@ -0,0 +1,30 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_PLUGIN_LOADER_H__
+#define _FREECWMP_PLUGIN_LOADER_H__
+
+#include "freecwmp-plugin.h"
+#include "provider.h"
+
+/* shared object declared by a plugin section of the freecwmp package */
+struct plugin {
+	char *path;
+	void *handle;
+	const struct freecwmp_plugin *plugin;
+	struct provider_native *natives;
+	size_t natives_num;
+};
+
+int plugin_add(const char *path);
+int plugin_init(void);
+void plugin_exit(void);
+
+#endif
+
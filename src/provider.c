@@ -0,0 +1,301 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libfreecwmp.h>
+
+#include "provider.h"
+
+#include "freecwmp.h"
+
+static struct provider_route *routes;
+static size_t routes_num;
+static size_t routes_size;
+
+static int provider_route_cmp(const void *a, const void *b)
+{
+	const struct provider_route *r1 = a, *r2 = b;
+
+	return strcmp(r1->prefix, r2->prefix);
+}
+
+/* compare the first len bytes of path against a route prefix */
+static int provider_key_cmp(const char *path, size_t len,
+			    const struct provider_route *r)
+{
+	int rc = strncmp(path, r->prefix, len);
+
+	if (rc) return rc;
+	return len < r->len ? -1 : (len > r->len);
+}
+
+/* index of the first route not lower than path[0..len] */
+static size_t provider_lower_bound(const char *path, size_t len)
+{
+	size_t lo = 0, hi = routes_num, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (provider_key_cmp(path, len, &routes[mid]) > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+void provider_clear(void)
+{
+	size_t i;
+
+	for (i = 0; i < routes_num; i++) {
+		free(routes[i].prefix);
+		free(routes[i].provider);
+	}
+
+	free(routes);
+	routes = NULL;
+	routes_num = routes_size = 0;
+}
+
+int provider_add(const char *prefix, const char *provider)
+{
+	struct provider_route *r;
+
+	if (routes_num == routes_size) {
+		size_t size = routes_size ? routes_size * 2 : 16;
+
+		r = realloc(routes, size * sizeof(*routes));
+		if (!r) return -1;
+
+		routes = r;
+		routes_size = size;
+	}
+
+	r = &routes[routes_num];
+	r->prefix = strdup(prefix);
+	r->provider = strdup(provider);
+	if (!r->prefix || !r->provider) {
+		free(r->prefix);
+		free(r->provider);
+		return -1;
+	}
+	r->len = strlen(prefix);
+
+	routes_num++;
+	return 0;
+}
+
+void provider_sort(void)
+{
+	qsort(routes, routes_num, sizeof(*routes), provider_route_cmp);
+}
+
+static int provider_append(char **list, size_t *len, const char *provider)
+{
+	size_t n = strlen(provider);
+	char *c;
+
+	/* a provider may own several prefixes, report it only once */
+	for (c = *list; c && (c = strstr(c, provider)); c += n) {
+		if ((c == *list || c[-1] == ' ') &&
+		    (c[n] == ' ' || c[n] == '\0'))
+			return 0;
+	}
+
+	c = realloc(*list, *len + n + 2);
+	if (!c) return -1;
+
+	if (*len)
+		c[(*len)++] = ' ';
+	memcpy(c + *len, provider, n + 1);
+	*len += n;
+	*list = c;
+
+	return 0;
+}
+
+/*
+ * space separated list of providers that have to be asked for path: the
+ * owner of the longest prefix of path and, for partial paths, every
+ * provider owning a prefix below path; NULL on allocation failure
+ */
+char *provider_lookup(const char *path)
+{
+	char *list;
+	size_t len = 0, plen, i, j;
+
+	list = calloc(1, sizeof(char));
+	if (!list) return NULL;
+
+	plen = strlen(path);
+
+	/* longest match, prefixes end with a dot so only try dot boundaries */
+	i = plen;
+	while (1) {
+		while (i && path[i - 1] != '.')
+			i--;
+
+		j = provider_lower_bound(path, i);
+		if (j < routes_num && !provider_key_cmp(path, i, &routes[j])) {
+			for (; j < routes_num &&
+			       !provider_key_cmp(path, i, &routes[j]); j++) {
+				if (provider_append(&list, &len, routes[j].provider))
+					goto error;
+			}
+			break;
+		}
+
+		if (!i) break;
+		i--;
+	}
+
+	/* partial path, everything in the subtree has to be asked as well */
+	if (!plen || path[plen - 1] == '.') {
+		j = provider_lower_bound(path, plen);
+		for (; j < routes_num &&
+		       !strncmp(routes[j].prefix, path, plen); j++) {
+			if (provider_append(&list, &len, routes[j].provider))
+				goto error;
+		}
+	}
+
+	DD("providers for '%s': '%s'\n", path, list);
+	return list;
+
+error:
+	free(list);
+	return NULL;
+}
+
+static const struct provider_native *natives[PROVIDER_NATIVE_MAX];
+static size_t natives_num;
+
+/* longest prefixes first, equal ones in the order they were registered */
+int provider_native_register(const struct provider_native *native)
+{
+	size_t i, len = strlen(native->prefix);
+
+	if (natives_num == PROVIDER_NATIVE_MAX)
+		return -1;
+
+	for (i = natives_num; i > 0 && strlen(natives[i - 1]->prefix) < len; i--)
+		natives[i] = natives[i - 1];
+
+	natives[i] = native;
+	natives_num++;
+	return 0;
+}
+
+void provider_native_unregister(const struct provider_native *native)
+{
+	size_t i;
+
+	for (i = 0; i < natives_num && natives[i] != native; i++)
+		;
+
+	if (i == natives_num)
+		return;
+
+	natives_num--;
+	memmove(&natives[i], &natives[i + 1],
+		(natives_num - i) * sizeof(*natives));
+}
+
+/*
+ * native providers are few, a scan is enough; a provider that passes on
+ * a path leaves it to the ones with shorter prefixes
+ */
+static bool provider_native_match(size_t i, const char *path)
+{
+	return !strncmp(path, natives[i]->prefix, strlen(natives[i]->prefix));
+}
+
+/* objects have no value, partial paths are expanded with the schema */
+int provider_native_get(const char *path, char **value)
+{
+	size_t i;
+	int rc;
+
+	if (!*path || path[strlen(path) - 1] == '.')
+		return PROVIDER_NATIVE_NONE;
+
+	for (i = 0; i < natives_num; i++) {
+		if (!natives[i]->get || !provider_native_match(i, path))
+			continue;
+
+		rc = natives[i]->get(path, value);
+		if (rc != PROVIDER_NATIVE_NONE)
+			return rc;
+	}
+
+	return PROVIDER_NATIVE_NONE;
+}
+
+int provider_native_set(const char *path, const char *value)
+{
+	size_t i;
+	int rc;
+
+	for (i = 0; i < natives_num; i++) {
+		if (!natives[i]->set || !provider_native_match(i, path))
+			continue;
+
+		rc = natives[i]->set(path, value);
+		if (rc != PROVIDER_NATIVE_NONE)
+			return rc;
+	}
+
+	return PROVIDER_NATIVE_NONE;
+}
+
+int provider_native_commit(void)
+{
+	size_t i;
+	int rc = 0;
+
+	for (i = 0; i < natives_num; i++) {
+		if (natives[i]->commit && natives[i]->commit())
+			rc = -1;
+	}
+
+	return rc;
+}
+
+void provider_native_abort(void)
+{
+	size_t i;
+
+	for (i = 0; i < natives_num; i++) {
+		if (natives[i]->abort)
+			natives[i]->abort();
+	}
+}
+
+int provider_native_instance(const char *object, unsigned long from,
+			     unsigned long *number)
+{
+	size_t i;
+	int rc;
+
+	for (i = 0; i < natives_num; i++) {
+		if (!natives[i]->instance || !provider_native_match(i, object))
+			continue;
+
+		rc = natives[i]->instance(object, from, number);
+		if (rc != PROVIDER_NATIVE_NONE)
+			return rc;
+	}
+
+	return PROVIDER_NATIVE_NONE;
+}
@@ -0,0 +1,72 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_PROVIDER_H__
+#define _FREECWMP_PROVIDER_H__
+
+#include <stddef.h>
+
+/*
+ * routing index from parameter path prefixes to the scripts sections
+ * (providers) that own them; prefixes always end with a dot, an empty
+ * prefix makes the provider a catch-all
+ */
+struct provider_route {
+	char *prefix;
+	size_t len;
+	char *provider;
+};
+
+void provider_clear(void);
+int provider_add(const char *prefix, const char *provider);
+void provider_sort(void);
+
+char *provider_lookup(const char *path);
+
+#define PROVIDER_NATIVE_MAX	32
+
+enum provider_native_result {
+	PROVIDER_NATIVE_OK = 0,
+	PROVIDER_NATIVE_ERROR = -1,
+	/* the path is not owned by any native provider */
+	PROVIDER_NATIVE_NONE = 1,
+	PROVIDER_NATIVE_INVALID_NAME = 2,
+	PROVIDER_NATIVE_INVALID_VALUE = 3,
+};
+
+/*
+ * providers implemented inside the daemon, they are asked before the
+ * scripts, longest prefix first; callbacks return PROVIDER_NATIVE_NONE
+ * for paths they don't handle so that the next matching one is asked;
+ * set() only stages, commit() applies and abort() drops what has been
+ * staged for a refused request; instance() reports the lowest existing
+ * instance number not below from (0 when there is none) for
+ * multi-instance objects that are not numbered 1..N
+ */
+struct provider_native {
+	const char *prefix;
+	int (*get)(const char *path, char **value);
+	int (*set)(const char *path, const char *value);
+	int (*commit)(void);
+	void (*abort)(void);
+	int (*instance)(const char *object, unsigned long from,
+			unsigned long *number);
+};
+
+int provider_native_register(const struct provider_native *native);
+void provider_native_unregister(const struct provider_native *native);
+int provider_native_get(const char *path, char **value);
+int provider_native_set(const char *path, const char *value);
+int provider_native_commit(void);
+void provider_native_abort(void);
+int provider_native_instance(const char *object, unsigned long from,
+			     unsigned long *number);
+
+#endif
+
@@ -0,0 +1,627 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <linux/rtnetlink.h>
+
+#include <libfreecwmp.h>
+
+#include "route.h"
+
+#include "freecwmp.h"
+#include "instance.h"
+#include "provider.h"
+
+#define ROUTE_PATH_MAX	128
+
+static int route_native_get(const char *path, char **value);
+static int route_native_set(const char *path, const char *value);
+static int route_native_instance(const char *object, unsigned long from,
+				 unsigned long *number);
+
+/* the uci routes are committed together with the other instance tables */
+static const struct provider_native route_native = {
+	.prefix = ROUTE_PREFIX,
+	.get = route_native_get,
+	.set = route_native_set,
+	.instance = route_native_instance,
+};
+
+static struct instance_table *forwarding;
+
+/* kernel routes in the order they showed up */
+static struct route_kernel *routes;
+static size_t routes_num;
+static size_t routes_size;
+static bool routes_changed = true;
+
+/* open addressing on destination and gateway, slots hold the index + 1 */
+static uint32_t *routes_hash;
+static size_t routes_buckets;
+
+/*
+ * the table as the ACS sees it: the uci routes under their instance
+ * numbers and every kernel route none of them accounts for under a
+ * number claimed from the same instance table, both ordered by number
+ */
+static struct route_static *statics;
+static size_t statics_num;
+static size_t statics_size;
+static size_t *dynamic;
+static size_t dynamic_num;
+static size_t dynamic_size;
+static unsigned long view_serial;
+
+static int route_grow(void **array, size_t *size, size_t need, size_t elem)
+{
+	size_t n = *size ? *size : 16;
+	void *a;
+
+	if (need <= *size)
+		return 0;
+
+	while (n < need)
+		n *= 2;
+
+	a = realloc(*array, n * elem);
+	if (!a) return -1;
+
+	*array = a;
+	*size = n;
+	return 0;
+}
+
+static uint32_t route_hash(uint32_t dst, uint8_t dst_len, uint32_t gateway)
+{
+	uint8_t key[9];
+
+	memcpy(key, &dst, 4);
+	memcpy(key + 4, &gateway, 4);
+	key[8] = dst_len;
+
+	return freecwmp_hash(key, sizeof(key));
+}
+
+/*
+ * a kernel route keeps its number as long as it exists; the rare routes
+ * whose keys collide are told apart by the order they are seen in
+ */
+static int route_claim(struct route_kernel *r)
+{
+	char key[40];
+	unsigned int n = 0;
+	int rc;
+
+	do {
+		snprintf(key, sizeof(key), "route_%08x_%u_%u_%u",
+			 route_hash(r->dst, r->dst_len, r->gateway),
+			 r->tos, r->metric, n++);
+		rc = instance_claim(ROUTE_FORWARDING, key, &r->number);
+	} while (rc == INSTANCE_INVALID_NAME);
+
+	return rc;
+}
+
+static int route_number_cmp(const void *a, const void *b)
+{
+	const struct route_kernel *ra = &routes[*(const size_t *) a];
+	const struct route_kernel *rb = &routes[*(const size_t *) b];
+
+	return ra->number < rb->number ? -1 : ra->number > rb->number;
+}
+
+/* the kernel tells routes apart by destination, tos and metric */
+static size_t route_find(const struct route_kernel *r)
+{
+	size_t i;
+
+	for (i = 0; i < routes_num; i++) {
+		if (routes[i].dst == r->dst && routes[i].dst_len == r->dst_len &&
+		    routes[i].tos == r->tos && routes[i].metric == r->metric)
+			break;
+	}
+
+	return i;
+}
+
+/* changes are rare next to queries, a scan per notification is enough */
+void route_netlink(struct nlmsghdr *nlh)
+{
+	struct rtmsg *rtm = (struct rtmsg *) NLMSG_DATA(nlh);
+	struct rtattr *rta = RTM_RTA(rtm);
+	int len = RTM_PAYLOAD(nlh);
+	struct route_kernel r;
+	uint32_t table;
+	size_t i;
+
+	if (rtm->rtm_family != AF_INET || rtm->rtm_type != RTN_UNICAST ||
+	    (rtm->rtm_flags & RTM_F_CLONED))
+		return;
+
+	memset(&r, 0, sizeof(r));
+	r.dst_len = rtm->rtm_dst_len;
+	r.tos = rtm->rtm_tos;
+	r.protocol = rtm->rtm_protocol;
+	r.seen = true;
+	table = rtm->rtm_table;
+
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		switch (rta->rta_type) {
+		case RTA_TABLE:
+			memcpy(&table, RTA_DATA(rta), sizeof(table));
+			break;
+		case RTA_DST:
+			memcpy(&r.dst, RTA_DATA(rta), sizeof(r.dst));
+			break;
+		case RTA_GATEWAY:
+			memcpy(&r.gateway, RTA_DATA(rta), sizeof(r.gateway));
+			break;
+		case RTA_OIF:
+			memcpy(&r.oif, RTA_DATA(rta), sizeof(r.oif));
+			break;
+		case RTA_PRIORITY:
+			memcpy(&r.metric, RTA_DATA(rta), sizeof(r.metric));
+			break;
+		}
+	}
+
+	if (table != RT_TABLE_MAIN)
+		return;
+
+	i = route_find(&r);
+
+	if (nlh->nlmsg_type == RTM_DELROUTE) {
+		if (i == routes_num)
+			return;
+		memmove(&routes[i], &routes[i + 1],
+			(routes_num - i - 1) * sizeof(*routes));
+		routes_num--;
+		routes_changed = true;
+		return;
+	}
+
+	if (i == routes_num) {
+		if (route_grow((void **) &routes, &routes_size, routes_num + 1,
+			       sizeof(*routes))) {
+			D("couldn't keep track of a new route\n");
+			return;
+		}
+		routes_num++;
+	}
+
+	routes[i] = r;
+	routes_changed = true;
+}
+
+void route_begin(void)
+{
+	size_t i;
+
+	for (i = 0; i < routes_num; i++)
+		routes[i].seen = false;
+}
+
+void route_end(void)
+{
+	size_t i, n = 0;
+
+	for (i = 0; i < routes_num; i++) {
+		if (routes[i].seen)
+			routes[n++] = routes[i];
+	}
+
+	if (n != routes_num) {
+		routes_num = n;
+		routes_changed = true;
+	}
+}
+
+static int route_index(void)
+{
+	size_t i, slot, buckets = 16;
+
+	while (buckets < 2 * routes_num)
+		buckets <<= 1;
+
+	if (buckets != routes_buckets) {
+		free(routes_hash);
+		routes_hash = malloc(buckets * sizeof(*routes_hash));
+		if (!routes_hash) {
+			routes_buckets = 0;
+			return -1;
+		}
+		routes_buckets = buckets;
+	}
+
+	memset(routes_hash, 0, routes_buckets * sizeof(*routes_hash));
+
+	for (i = 0; i < routes_num; i++) {
+		slot = route_hash(routes[i].dst, routes[i].dst_len,
+				  routes[i].gateway) & (routes_buckets - 1);
+		while (routes_hash[slot])
+			slot = (slot + 1) & (routes_buckets - 1);
+		routes_hash[slot] = i + 1;
+	}
+
+	return 0;
+}
+
+/* first kernel route for dst/len via gateway not claimed by a uci route */
+static struct route_kernel *route_lookup(uint32_t dst, uint8_t dst_len,
+					 uint32_t gateway)
+{
+	struct route_kernel *r;
+	size_t slot;
+
+	slot = route_hash(dst, dst_len, gateway) & (routes_buckets - 1);
+	for (; routes_hash[slot]; slot = (slot + 1) & (routes_buckets - 1)) {
+		r = &routes[routes_hash[slot] - 1];
+		if (r->dst == dst && r->dst_len == dst_len &&
+		    r->gateway == gateway && !r->matched)
+			return r;
+	}
+
+	return NULL;
+}
+
+/* uci keeps "target" either with a "netmask" or in CIDR notation */
+static int route_static_key(unsigned long number, uint32_t *dst,
+			    uint8_t *dst_len, uint32_t *gateway)
+{
+	static const char *names[] = {
+		"DestIPAddress", "DestSubnetMask", "GatewayIPAddress",
+	};
+	char path[ROUTE_PATH_MAX], *v[ARRAY_SIZE(names)] = { NULL };
+	uint32_t mask;
+	char *c, *end;
+	size_t i;
+	int rc = -1;
+
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		snprintf(path, sizeof(path), "%s%lu.%s", ROUTE_FORWARDING,
+			 number, names[i]);
+		if (instance_get(path, &v[i]))
+			goto out;
+	}
+
+	if ((c = strchr(v[0], '/'))) {
+		*c++ = '\0';
+		errno = 0;
+		*dst_len = strtoul(c, &end, 10);
+		if (errno || *end || end == c || *dst_len > 32)
+			goto out;
+	} else {
+		if (inet_pton(AF_INET, v[1], &mask) != 1)
+			goto out;
+		mask = ~ntohl(mask);
+		if (mask & (mask + 1))
+			goto out;
+		for (*dst_len = 32; mask; mask >>= 1)
+			(*dst_len)--;
+	}
+
+	if (inet_pton(AF_INET, v[0], dst) != 1)
+		goto out;
+
+	*gateway = 0;
+	if (*v[2] && inet_pton(AF_INET, v[2], gateway) != 1)
+		goto out;
+
+	rc = 0;
+
+out:
+	for (i = 0; i < ARRAY_SIZE(names); i++)
+		free(v[i]);
+	return rc;
+}
+
+/* rebuild the merged table when the kernel or the uci routes changed */
+static int route_update(void)
+{
+	struct route_static *s;
+	struct route_kernel *r;
+	unsigned long from = 1, number;
+	uint32_t dst, gateway;
+	uint8_t dst_len;
+	size_t i;
+
+	if (!routes_changed && view_serial == forwarding->serial)
+		return 0;
+
+	if (routes_changed && route_index())
+		return -1;
+
+	for (i = 0; i < routes_num; i++)
+		routes[i].matched = false;
+
+	statics_num = 0;
+	while (1) {
+		if (instance_number(ROUTE_FORWARDING, from, &number))
+			return -1;
+		if (!number) break;
+
+		if (route_grow((void **) &statics, &statics_size,
+			       statics_num + 1, sizeof(*statics)))
+			return -1;
+
+		s = &statics[statics_num++];
+		s->number = number;
+		s->active = false;
+
+		if (!route_static_key(number, &dst, &dst_len, &gateway) &&
+		    (r = route_lookup(dst, dst_len, gateway))) {
+			r->matched = true;
+			s->active = true;
+		}
+
+		from = number + 1;
+	}
+
+	if (route_grow((void **) &dynamic, &dynamic_size, routes_num,
+		       sizeof(*dynamic)))
+		return -1;
+
+	instance_claim_begin(ROUTE_FORWARDING);
+
+	dynamic_num = 0;
+	for (i = 0; i < routes_num; i++) {
+		if (routes[i].matched)
+			continue;
+		if (route_claim(&routes[i]))
+			return -1;
+		dynamic[dynamic_num++] = i;
+	}
+
+	if (instance_claim_end(ROUTE_FORWARDING))
+		return -1;
+
+	qsort(dynamic, dynamic_num, sizeof(*dynamic), route_number_cmp);
+
+	view_serial = forwarding->serial;
+	routes_changed = false;
+
+	return 0;
+}
+
+static struct route_static *route_static_find(unsigned long number)
+{
+	size_t lo = 0, hi = statics_num, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (statics[mid].number == number)
+			return &statics[mid];
+		if (statics[mid].number < number)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+/* position of the first kernel route numbered from or above */
+static size_t route_dynamic_find(unsigned long from)
+{
+	size_t lo = 0, hi = dynamic_num, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (routes[dynamic[mid]].number < from)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* split "<number>.<name>" following the forwarding object */
+static int route_parse(const char *path, unsigned long *number,
+		       const char **name)
+{
+	const char *c = path + strlen(ROUTE_FORWARDING);
+	char *end;
+
+	if (!isdigit(*c) || *c == '0')
+		return -1;
+
+	errno = 0;
+	*number = strtoul(c, &end, 10);
+	if (errno || *end != '.' || !end[1])
+		return -1;
+
+	*name = end + 1;
+	return 0;
+}
+
+static int route_value(char **value, const char *v)
+{
+	*value = strdup(v);
+	return *value ? PROVIDER_NATIVE_OK : PROVIDER_NATIVE_ERROR;
+}
+
+static const char *route_origin(uint8_t protocol)
+{
+	switch (protocol) {
+	case RTPROT_DHCP:
+		return "DHCPv4";
+#ifdef RTPROT_OSPF
+	case RTPROT_OSPF:
+		return "OSPF";
+#endif
+#ifdef RTPROT_RIP
+	case RTPROT_RIP:
+		return "RIP";
+#endif
+	default:
+		return "Static";
+	}
+}
+
+static int route_kernel_get(struct route_kernel *r, const char *name,
+			    char **value)
+{
+	char addr[INET_ADDRSTRLEN];
+	uint32_t mask;
+
+	if (!strcmp(name, "Status"))
+		return route_value(value, "Enabled");
+	if (!strcmp(name, "StaticRoute"))
+		return route_value(value, "0");
+	if (!strcmp(name, "Origin"))
+		return route_value(value, route_origin(r->protocol));
+
+	/* there is no uci interface to refer to for what the kernel learned */
+	if (!strcmp(name, "Interface"))
+		return route_value(value, "");
+
+	if (!strcmp(name, "DestIPAddress")) {
+		inet_ntop(AF_INET, &r->dst, addr, sizeof(addr));
+		return route_value(value, addr);
+	}
+
+	if (!strcmp(name, "DestSubnetMask")) {
+		mask = r->dst_len ? htonl(~0u << (32 - r->dst_len)) : 0;
+		inet_ntop(AF_INET, &mask, addr, sizeof(addr));
+		return route_value(value, addr);
+	}
+
+	if (!strcmp(name, "GatewayIPAddress")) {
+		if (!r->gateway)
+			return route_value(value, "");
+		inet_ntop(AF_INET, &r->gateway, addr, sizeof(addr));
+		return route_value(value, addr);
+	}
+
+	if (!strcmp(name, "ForwardingMetric")) {
+		if (asprintf(value, "%u", r->metric) == -1)
+			return PROVIDER_NATIVE_ERROR;
+		return PROVIDER_NATIVE_OK;
+	}
+
+	return PROVIDER_NATIVE_INVALID_NAME;
+}
+
+static int route_native_get(const char *path, char **value)
+{
+	struct route_static *s;
+	unsigned long number;
+	const char *name;
+	size_t i;
+
+	if (!strcmp(path, ROUTE_PREFIX "RouterNumberOfEntries"))
+		return route_value(value, "1");
+
+	if (strncmp(path, ROUTE_ROUTER, strlen(ROUTE_ROUTER)))
+		return PROVIDER_NATIVE_INVALID_NAME;
+
+	name = path + strlen(ROUTE_ROUTER);
+	if (!strcmp(name, "Enable"))
+		return route_value(value, "1");
+	if (!strcmp(name, "Status"))
+		return route_value(value, "Enabled");
+	if (!strcmp(name, "IPv6ForwardingNumberOfEntries"))
+		return route_value(value, "0");
+
+	if (route_update())
+		return PROVIDER_NATIVE_ERROR;
+
+	if (!strcmp(name, "IPv4ForwardingNumberOfEntries")) {
+		if (asprintf(value, "%zu", statics_num + dynamic_num) == -1)
+			return PROVIDER_NATIVE_ERROR;
+		return PROVIDER_NATIVE_OK;
+	}
+
+	if (strncmp(path, ROUTE_FORWARDING, strlen(ROUTE_FORWARDING)) ||
+	    route_parse(path, &number, &name))
+		return PROVIDER_NATIVE_INVALID_NAME;
+
+	if ((s = route_static_find(number))) {
+		if (!strcmp(name, "Status"))
+			return route_value(value, s->active ?
+					   "Enabled" : "Error_Misconfigured");
+		return instance_get(path, value);
+	}
+
+	i = route_dynamic_find(number);
+	if (i == dynamic_num || routes[dynamic[i]].number != number)
+		return PROVIDER_NATIVE_INVALID_NAME;
+
+	return route_kernel_get(&routes[dynamic[i]], name, value);
+}
+
+/* only the uci routes can be changed, the kernel ones follow them */
+static int route_native_set(const char *path, const char *value)
+{
+	if (strncmp(path, ROUTE_FORWARDING, strlen(ROUTE_FORWARDING)))
+		return PROVIDER_NATIVE_INVALID_NAME;
+
+	return instance_set(path, value);
+}
+
+/* the lower of the next uci and the next kernel route */
+static int route_native_instance(const char *object, unsigned long from,
+				 unsigned long *number)
+{
+	unsigned long kernel;
+	size_t i;
+
+	if (strcmp(object, ROUTE_FORWARDING))
+		return PROVIDER_NATIVE_NONE;
+
+	if (route_update())
+		return PROVIDER_NATIVE_ERROR;
+
+	if (instance_number(object, from, number))
+		return PROVIDER_NATIVE_ERROR;
+
+	i = route_dynamic_find(from);
+	if (i == dynamic_num)
+		return PROVIDER_NATIVE_OK;
+
+	kernel = routes[dynamic[i]].number;
+	if (!*number || kernel < *number)
+		*number = kernel;
+
+	return PROVIDER_NATIVE_OK;
+}
+
+int route_init(void)
+{
+	forwarding = instance_table(ROUTE_FORWARDING);
+	if (!forwarding) return -1;
+
+	return provider_native_register(&route_native);
+}
+
+void route_exit(void)
+{
+	free(routes);
+	routes = NULL;
+	routes_num = routes_size = 0;
+	routes_changed = true;
+
+	free(routes_hash);
+	routes_hash = NULL;
+	routes_buckets = 0;
+
+	free(statics);
+	statics = NULL;
+	statics_num = statics_size = 0;
+
+	free(dynamic);
+	dynamic = NULL;
+	dynamic_num = dynamic_size = 0;
+}
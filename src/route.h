@@ -0,0 +1,48 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_ROUTE_H__
+#define _FREECWMP_ROUTE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <linux/netlink.h>
+
+#define ROUTE_PREFIX		"Device.Routing."
+#define ROUTE_ROUTER		ROUTE_PREFIX "Router.1."
+#define ROUTE_FORWARDING	ROUTE_ROUTER "IPv4Forwarding."
+
+/* IPv4 unicast route of the main table, addresses in network order */
+struct route_kernel {
+	uint32_t dst;
+	uint32_t gateway;
+	uint32_t metric;
+	int oif;
+	uint8_t dst_len;
+	uint8_t tos;
+	uint8_t protocol;
+	bool matched;		/* installed for one of the uci routes */
+	bool seen;
+	unsigned long number;	/* claimed instance number when not matched */
+};
+
+/* uci route of the instance table and whether the kernel has it */
+struct route_static {
+	unsigned long number;
+	bool active;
+};
+
+int route_init(void);
+void route_exit(void);
+void route_netlink(struct nlmsghdr *nlh);
+void route_begin(void);
+void route_end(void);
+
+#endif
+
@@ -0,0 +1,263 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <limits.h>
+#include <time.h>
+
+#include <libfreecwmp.h>
+#include <libubox/uloop.h>
+
+#include "scheduler.h"
+
+#include "freecwmp.h"
+
+#define SCHEDULER_MASK		(SCHEDULER_SLOTS - 1)
+#define SCHEDULER_MAX_DELTA	((1ULL << (SCHEDULER_BITS * SCHEDULER_LEVELS)) - 1)
+
+static void scheduler_run(struct uloop_timeout *timeout);
+
+static struct list_head wheel[SCHEDULER_LEVELS][SCHEDULER_SLOTS];
+/* one bit per non-empty slot, used to find the next work item quickly */
+static uint64_t wheel_map[SCHEDULER_LEVELS];
+/* last tick that was processed */
+static uint64_t wheel_now;
+
+static struct uloop_timeout wheel_timer = { .cb = scheduler_run };
+
+uint64_t scheduler_msecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static inline uint64_t scheduler_ticks(void)
+{
+	return scheduler_msecs() / SCHEDULER_TICK;
+}
+
+static inline uint64_t rotate_right(uint64_t map, unsigned int n)
+{
+	return n ? (map >> n) | (map << (64 - n)) : map;
+}
+
+static void scheduler_enqueue(struct scheduler_timer *timer)
+{
+	uint64_t delta = timer->expires - wheel_now;
+	unsigned int level, slot;
+
+	for (level = 0; level < SCHEDULER_LEVELS - 1; level++) {
+		if (delta < (1ULL << ((level + 1) * SCHEDULER_BITS)))
+			break;
+	}
+
+	slot = (timer->expires >> (level * SCHEDULER_BITS)) & SCHEDULER_MASK;
+
+	list_add_tail(&timer->list, &wheel[level][slot]);
+	wheel_map[level] |= 1ULL << slot;
+	timer->slot = level * SCHEDULER_SLOTS + slot;
+}
+
+static void scheduler_dequeue(struct scheduler_timer *timer)
+{
+	unsigned int level = timer->slot / SCHEDULER_SLOTS;
+	unsigned int slot = timer->slot % SCHEDULER_SLOTS;
+
+	list_del(&timer->list);
+	if (list_empty(&wheel[level][slot]))
+		wheel_map[level] &= ~(1ULL << slot);
+}
+
+/*
+ * first tick after wheel_now at which something has to be done: either a
+ * level 0 slot expires or a slot of an upper level has to be cascaded
+ */
+static uint64_t scheduler_next(void)
+{
+	uint64_t next = UINT64_MAX;
+	uint64_t base, k;
+	unsigned int level, shift;
+
+	for (level = 0; level < SCHEDULER_LEVELS; level++) {
+		if (!wheel_map[level])
+			continue;
+
+		shift = level * SCHEDULER_BITS;
+		base = (wheel_now >> shift) + 1;
+		k = base + __builtin_ctzll(rotate_right(wheel_map[level],
+							base & SCHEDULER_MASK));
+		if ((k << shift) < next)
+			next = k << shift;
+	}
+
+	return next;
+}
+
+static void scheduler_arm(void)
+{
+	uint64_t next, now;
+
+	next = scheduler_next();
+	if (next == UINT64_MAX) {
+		uloop_timeout_cancel(&wheel_timer);
+		return;
+	}
+
+	next *= SCHEDULER_TICK;
+	now = scheduler_msecs();
+
+	if (next <= now)
+		uloop_timeout_set(&wheel_timer, 0);
+	else if (next - now > INT_MAX)
+		uloop_timeout_set(&wheel_timer, INT_MAX);
+	else
+		uloop_timeout_set(&wheel_timer, next - now);
+}
+
+static void scheduler_expire(uint64_t tick)
+{
+	struct scheduler_timer *timer;
+	struct list_head due, *head;
+	unsigned int level, shift, slot;
+	int i;
+
+	INIT_LIST_HEAD(&due);
+
+	/* cascade upper levels first, they may feed the lower ones */
+	for (i = SCHEDULER_LEVELS - 1; i >= 0; i--) {
+		level = i;
+		shift = level * SCHEDULER_BITS;
+
+		if (tick & ((1ULL << shift) - 1))
+			continue;
+
+		slot = (tick >> shift) & SCHEDULER_MASK;
+		if (!(wheel_map[level] & (1ULL << slot)))
+			continue;
+
+		head = &wheel[level][slot];
+		wheel_map[level] &= ~(1ULL << slot);
+
+		while (!list_empty(head)) {
+			timer = list_first_entry(head, struct scheduler_timer, list);
+			list_del(&timer->list);
+
+			if (timer->expires <= tick)
+				list_add_tail(&timer->list, &due);
+			else
+				scheduler_enqueue(timer);
+		}
+	}
+
+	while (!list_empty(&due)) {
+		timer = list_first_entry(&due, struct scheduler_timer, list);
+		list_del(&timer->list);
+		timer->pending = false;
+
+		if (timer->cb)
+			timer->cb(timer);
+	}
+}
+
+static void scheduler_run(struct uloop_timeout *timeout)
+{
+	uint64_t next, now;
+
+	now = scheduler_ticks();
+	while ((next = scheduler_next()) <= now) {
+		wheel_now = next;
+		scheduler_expire(next);
+		now = scheduler_ticks();
+	}
+
+	/* nothing is due until next, so it is safe to skip ahead */
+	if (now > wheel_now)
+		wheel_now = now;
+
+	scheduler_arm();
+}
+
+void scheduler_init(void)
+{
+	unsigned int level, slot;
+
+	for (level = 0; level < SCHEDULER_LEVELS; level++) {
+		for (slot = 0; slot < SCHEDULER_SLOTS; slot++)
+			INIT_LIST_HEAD(&wheel[level][slot]);
+		wheel_map[level] = 0;
+	}
+
+	wheel_now = scheduler_ticks();
+}
+
+void scheduler_exit(void)
+{
+	struct scheduler_timer *timer;
+	unsigned int level, slot;
+
+	uloop_timeout_cancel(&wheel_timer);
+
+	for (level = 0; level < SCHEDULER_LEVELS; level++) {
+		for (slot = 0; slot < SCHEDULER_SLOTS; slot++) {
+			while (!list_empty(&wheel[level][slot])) {
+				timer = list_first_entry(&wheel[level][slot],
+						struct scheduler_timer, list);
+				list_del(&timer->list);
+				timer->pending = false;
+			}
+		}
+		wheel_map[level] = 0;
+	}
+}
+
+void scheduler_timer_set(struct scheduler_timer *timer, uint64_t msecs)
+{
+	if (timer->pending)
+		scheduler_dequeue(timer);
+
+	/* round up so that timers never fire early */
+	timer->expires = (scheduler_msecs() + msecs + SCHEDULER_TICK - 1) /
+			 SCHEDULER_TICK;
+
+	if (timer->expires <= wheel_now)
+		timer->expires = wheel_now + 1;
+	if (timer->expires - wheel_now > SCHEDULER_MAX_DELTA)
+		timer->expires = wheel_now + SCHEDULER_MAX_DELTA;
+
+	scheduler_enqueue(timer);
+	timer->pending = true;
+
+	scheduler_arm();
+}
+
+void scheduler_timer_cancel(struct scheduler_timer *timer)
+{
+	if (!timer->pending)
+		return;
+
+	scheduler_dequeue(timer);
+	timer->pending = false;
+
+	scheduler_arm();
+}
+
+uint64_t scheduler_timer_remaining(struct scheduler_timer *timer)
+{
+	uint64_t now;
+
+	if (!timer->pending)
+		return 0;
+
+	now = scheduler_msecs();
+	if (timer->expires * SCHEDULER_TICK <= now)
+		return 0;
+
+	return timer->expires * SCHEDULER_TICK - now;
+}
@@ -0,0 +1,52 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_SCHEDULER_H__
+#define _FREECWMP_SCHEDULER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libubox/list.h>
+
+/*
+ * hierarchical timer wheel; every level has SCHEDULER_SLOTS slots and each
+ * slot of level n spans SCHEDULER_SLOTS^n ticks, which with six levels and
+ * 100ms ticks covers more than two centuries
+ */
+#define SCHEDULER_TICK		100
+#define SCHEDULER_BITS		6
+#define SCHEDULER_SLOTS		(1 << SCHEDULER_BITS)
+#define SCHEDULER_LEVELS	6
+
+struct scheduler_timer;
+typedef void (*scheduler_handler)(struct scheduler_timer *timer);
+
+/* embed into the work item; the timer itself is the cancellation handle */
+struct scheduler_timer {
+	struct list_head list;
+	scheduler_handler cb;
+
+	uint64_t expires;
+	unsigned int slot;
+	bool pending;
+};
+
+/* monotonic clock in milliseconds, the time base of the wheel */
+uint64_t scheduler_msecs(void);
+
+void scheduler_init(void);
+void scheduler_exit(void);
+
+void scheduler_timer_set(struct scheduler_timer *timer, uint64_t msecs);
+void scheduler_timer_cancel(struct scheduler_timer *timer);
+uint64_t scheduler_timer_remaining(struct scheduler_timer *timer);
+
+#endif
+
@@ -0,0 +1,590 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libfreecwmp.h>
+
+#include "schema.h"
+
+#include "config.h"
+#include "external.h"
+#include "freecwmp.h"
+#include "provider.h"
+#include "translate.h"
+
+#define SCHEMA_DIGITS		"0123456789"
+#define SCHEMA_HEX_CHARS	"0123456789abcdefABCDEF"
+#define SCHEMA_BASE64_CHARS	\
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/="
+
+/* generated from the data model document at build time */
+static const struct schema_range schema_ranges[] = {
+#define SCHEMA_OBJECT(path, writable)
+#define SCHEMA_PARAM(path, writable, type, range, ranges, length)
+#define SCHEMA_RANGE(min, max) \
+	{ min, max },
+#include "schema.def"
+#undef SCHEMA_RANGE
+#undef SCHEMA_PARAM
+#undef SCHEMA_OBJECT
+	/* keeps the table valid when nothing has a range */
+	{ 0, 0 },
+};
+
+static const struct schema_param schema_params[] = {
+#define SCHEMA_OBJECT(path, writable) \
+	{ path, writable, { SCHEMA_STRING, NULL, 0, 0 } },
+#define SCHEMA_PARAM(path, writable, type, range, ranges, length) \
+	{ path, writable, { type, &schema_ranges[range], ranges, length } },
+#define SCHEMA_RANGE(min, max)
+#include "schema.def"
+#undef SCHEMA_RANGE
+#undef SCHEMA_PARAM
+#undef SCHEMA_OBJECT
+};
+
+static const char *schema_xsd_types[] = {
+	[SCHEMA_STRING] = "xsd:string",
+	[SCHEMA_INT] = "xsd:int",
+	[SCHEMA_UNSIGNED_INT] = "xsd:unsignedInt",
+	[SCHEMA_LONG] = "xsd:long",
+	[SCHEMA_UNSIGNED_LONG] = "xsd:unsignedLong",
+	[SCHEMA_BOOLEAN] = "xsd:boolean",
+	[SCHEMA_DATE_TIME] = "xsd:dateTime",
+	[SCHEMA_BASE64] = "xsd:base64Binary",
+	[SCHEMA_HEX_BINARY] = "xsd:hexBinary",
+};
+
+static struct schema_node schema_root = { .object = true };
+
+static struct schema_node *schema_child(struct schema_node *node,
+					const char *name, size_t len)
+{
+	size_t lo = 0, hi = node->children_num, mid;
+	struct schema_node *c;
+	int rc;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		c = node->children[mid];
+
+		rc = strncmp(name, c->name, len);
+		if (!rc && c->name[len])
+			rc = -1;
+
+		if (!rc) return c;
+		if (rc < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return NULL;
+}
+
+/* children are kept sorted, the index is only built once at startup */
+static struct schema_node *schema_add_child(struct schema_node *node,
+					    const char *name, size_t len)
+{
+	struct schema_node *c, **children;
+	size_t i;
+
+	c = schema_child(node, name, len);
+	if (c) return c;
+
+	children = realloc(node->children,
+			   (node->children_num + 1) * sizeof(*children));
+	if (!children) return NULL;
+	node->children = children;
+
+	c = calloc(1, sizeof(*c));
+	if (!c) return NULL;
+
+	c->name = strndup(name, len);
+	if (!c->name) {
+		free(c);
+		return NULL;
+	}
+
+	for (i = node->children_num; i > 0; i--) {
+		if (strcmp(children[i - 1]->name, c->name) < 0)
+			break;
+		children[i] = children[i - 1];
+	}
+	children[i] = c;
+	node->children_num++;
+
+	return c;
+}
+
+static int schema_add(const struct schema_param *param)
+{
+	struct schema_node *node = &schema_root;
+	const char *c, *name = param->path;
+
+	while (*name) {
+		c = strchr(name, '.');
+
+		node = schema_add_child(node, name, c ? c - name : strlen(name));
+		if (!node) return -1;
+
+		if (!c) {
+			node->writable = param->writable;
+			node->syntax = param->syntax;
+			return 0;
+		}
+
+		node->object = true;
+		name = c + 1;
+	}
+
+	/* path ends with a dot, flags apply to the object itself */
+	node->writable = param->writable;
+	return 0;
+}
+
+static void schema_free(struct schema_node *node)
+{
+	size_t i;
+
+	for (i = 0; i < node->children_num; i++) {
+		schema_free(node->children[i]);
+		free(node->children[i]->name);
+		free(node->children[i]);
+	}
+
+	free(node->children);
+	node->children = NULL;
+	node->children_num = 0;
+}
+
+/* the other data model root gets the same tree */
+int schema_register(const struct schema_param *param)
+{
+	char path[SCHEMA_PATH_MAX];
+	struct schema_param alias = {
+		.path = path,
+		.writable = param->writable,
+		.syntax = param->syntax,
+	};
+
+	if (schema_add(param))
+		return -1;
+
+	if (translate_alias(param->path, path) && schema_add(&alias))
+		return -1;
+
+	return 0;
+}
+
+int schema_init(void)
+{
+	size_t i;
+
+	if (schema_root.children_num)
+		return 0;
+
+	for (i = 0; i < ARRAY_SIZE(schema_params); i++) {
+		if (schema_register(&schema_params[i]))
+			goto error;
+	}
+
+	return 0;
+
+error:
+	schema_free(&schema_root);
+	return -1;
+}
+
+void schema_exit(void)
+{
+	schema_free(&schema_root);
+}
+
+/*
+ * number of instances of a multi-instance object, path is the object
+ * path including its trailing dot
+ */
+static unsigned long schema_instances(char *path, size_t len)
+{
+	char counter[SCHEMA_PATH_MAX], buf[SCHEMA_PATH_MAX], *name;
+	char *value = NULL;
+	unsigned long n = 0;
+
+	if (snprintf(counter, sizeof(counter), "%.*sNumberOfEntries",
+		     (int) len - 1, path) >= sizeof(counter))
+		return 0;
+
+	name = translate_path(counter, buf);
+	if (provider_native_get(name, &value) &&
+	    config_get_cwmp(name, &value) &&
+	    external_get_action("value", name, &value))
+		return 0;
+
+	if (value) {
+		n = strtoul(value, NULL, 10);
+		free(value);
+	}
+
+	return n;
+}
+
+/* native tables know their objects under the path they are served at */
+static int schema_native_instance(char *object, unsigned long from,
+				  unsigned long *number)
+{
+	char buf[SCHEMA_PATH_MAX];
+
+	return provider_native_instance(translate_path(object, buf), from,
+					number);
+}
+
+static bool schema_is_instance(struct schema_node *node)
+{
+	return node->children_num == 1 &&
+	       !strcmp(node->children[0]->name, SCHEMA_INSTANCE);
+}
+
+static int schema_walk(struct schema_node *node, char *path, size_t len,
+		       bool emit, bool recurse, schema_walk_cb cb, void *priv)
+{
+	struct schema_node *c;
+	unsigned long i, n = 0;
+	bool native;
+	size_t l;
+	int rc;
+
+	if (emit && len && cb(path, node->writable, priv))
+		return SCHEMA_ERROR;
+
+	if (!node->object)
+		return SCHEMA_OK;
+
+	if (schema_is_instance(node)) {
+		c = node->children[0];
+
+		/* native tables may have holes in their numbering */
+		rc = schema_native_instance(path, 1, &i);
+		native = rc != PROVIDER_NATIVE_NONE;
+		if (native && rc)
+			return SCHEMA_ERROR;
+
+		if (!native) {
+			n = schema_instances(path, len);
+			i = n ? 1 : 0;
+		}
+
+		while (i) {
+			l = snprintf(path + len, SCHEMA_PATH_MAX - len, "%lu.", i);
+			if (len + l >= SCHEMA_PATH_MAX)
+				return SCHEMA_ERROR;
+
+			if (recurse)
+				rc = schema_walk(c, path, len + l, true, true, cb, priv);
+			else
+				rc = cb(path, c->writable, priv) ? SCHEMA_ERROR : SCHEMA_OK;
+
+			path[len] = '\0';
+			if (rc) return rc;
+
+			if (!native)
+				i = i < n ? i + 1 : 0;
+			else if (schema_native_instance(path, i + 1, &i))
+				return SCHEMA_ERROR;
+		}
+
+		return SCHEMA_OK;
+	}
+
+	for (i = 0; i < node->children_num; i++) {
+		c = node->children[i];
+
+		l = snprintf(path + len, SCHEMA_PATH_MAX - len, "%s%s",
+			     c->name, c->object ? "." : "");
+		if (len + l >= SCHEMA_PATH_MAX)
+			return SCHEMA_ERROR;
+
+		if (recurse)
+			rc = schema_walk(c, path, len + l, true, true, cb, priv);
+		else
+			rc = cb(path, c->writable, priv) ? SCHEMA_ERROR : SCHEMA_OK;
+
+		path[len] = '\0';
+		if (rc) return rc;
+	}
+
+	return SCHEMA_OK;
+}
+
+/*
+ * resolve path to its schema node; instance numbers are checked against
+ * the native tables or the NumberOfEntries counters, buf receives the
+ * path as resolved
+ */
+static int schema_lookup(const char *path, char *buf, size_t *len_out,
+			 struct schema_node **node_out)
+{
+	struct schema_node *node = &schema_root, *c;
+	const char *name, *dot;
+	size_t len = 0, l;
+	unsigned long i, n;
+	char *end;
+	int rc;
+
+	if (strlen(path) >= SCHEMA_PATH_MAX)
+		return SCHEMA_INVALID_NAME;
+
+	buf[0] = '\0';
+	for (name = path; *name; name = dot + 1) {
+		dot = strchr(name, '.');
+		l = dot ? dot - name : strlen(name);
+
+		if (!node->object || !l)
+			return SCHEMA_INVALID_NAME;
+
+		if (schema_is_instance(node)) {
+			i = strtoul(name, &end, 10);
+			if (end != name + l || *name == '0')
+				return SCHEMA_INVALID_NAME;
+
+			rc = schema_native_instance(buf, i, &n);
+			if (rc == PROVIDER_NATIVE_NONE)
+				n = i <= schema_instances(buf, len) ? i : 0;
+			else if (rc)
+				return SCHEMA_ERROR;
+
+			if (n != i)
+				return SCHEMA_INVALID_NAME;
+			c = node->children[0];
+		} else {
+			c = schema_child(node, name, l);
+			if (!c) return SCHEMA_INVALID_NAME;
+		}
+
+		/* objects have to be addressed with the trailing dot */
+		if (c->object != (dot != NULL))
+			return SCHEMA_INVALID_NAME;
+
+		memcpy(buf + len, name, l + (dot ? 1 : 0));
+		len += l + (dot ? 1 : 0);
+		buf[len] = '\0';
+
+		node = c;
+		if (!dot) break;
+	}
+
+	*len_out = len;
+	*node_out = node;
+	return SCHEMA_OK;
+}
+
+bool schema_exists(const char *path)
+{
+	struct schema_node *node;
+	char buf[SCHEMA_PATH_MAX];
+	size_t len;
+
+	return schema_lookup(path, buf, &len, &node) == SCHEMA_OK;
+}
+
+/*
+ * resolve a parameter to its schema node by name only, instance numbers
+ * are not looked up
+ */
+static struct schema_node *schema_find(const char *path)
+{
+	struct schema_node *node = &schema_root;
+	const char *name, *dot;
+	size_t l;
+
+	for (name = path; *name; name = dot + 1) {
+		dot = strchr(name, '.');
+		l = dot ? dot - name : strlen(name);
+
+		if (!node->object || !l)
+			return NULL;
+
+		if (schema_is_instance(node)) {
+			if (*name == '0' || strspn(name, SCHEMA_DIGITS) != l)
+				return NULL;
+			node = node->children[0];
+		} else {
+			node = schema_child(node, name, l);
+			if (!node) return NULL;
+		}
+
+		if (!dot) break;
+	}
+
+	return node->object ? NULL : node;
+}
+
+static bool schema_number_valid(const struct schema_syntax *syntax,
+				const char *value)
+{
+	const struct schema_range *r;
+	unsigned long long u = 0;
+	long long v = 0;
+	bool sign;
+	char *end;
+	unsigned int i;
+
+	if (!*value || isspace(*value))
+		return false;
+
+	sign = syntax->type == SCHEMA_INT || syntax->type == SCHEMA_LONG;
+	if (!sign && *value == '-')
+		return false;
+
+	errno = 0;
+	if (sign)
+		v = strtoll(value, &end, 10);
+	else
+		u = strtoull(value, &end, 10);
+
+	if (errno || *end)
+		return false;
+
+	if (!syntax->ranges_num)
+		return true;
+
+	for (i = 0; i < syntax->ranges_num; i++) {
+		r = &syntax->ranges[i];
+
+		if (sign && v >= r->min && v <= (long long) r->max)
+			return true;
+		if (!sign && u >= (unsigned long long) r->min && u <= r->max)
+			return true;
+	}
+
+	return false;
+}
+
+/* CCYY-MM-DDThh:mm:ss with optional fraction and time zone */
+static bool schema_date_time_valid(const char *value)
+{
+	unsigned int y, mo, d, h, mi, s;
+	int n = 0;
+
+	if (sscanf(value, "%4u-%2u-%2uT%2u:%2u:%2u%n",
+		   &y, &mo, &d, &h, &mi, &s, &n) != 6 || n != 19)
+		return false;
+
+	if (!mo || mo > 12 || !d || d > 31 || h > 23 || mi > 59 || s > 60)
+		return false;
+
+	value += n;
+	if (*value == '.') {
+		value++;
+		if (!isdigit(*value))
+			return false;
+		value += strspn(value, SCHEMA_DIGITS);
+	}
+
+	if (*value == 'Z')
+		return !value[1];
+
+	if (*value == '+' || *value == '-')
+		return strlen(value) == 6 && isdigit(value[1]) &&
+		       isdigit(value[2]) && value[3] == ':' &&
+		       isdigit(value[4]) && isdigit(value[5]);
+
+	return !*value;
+}
+
+static bool schema_value_valid(const struct schema_syntax *syntax,
+			       const char *value)
+{
+	size_t len = strlen(value);
+
+	switch (syntax->type) {
+	case SCHEMA_INT:
+	case SCHEMA_UNSIGNED_INT:
+	case SCHEMA_LONG:
+	case SCHEMA_UNSIGNED_LONG:
+		return schema_number_valid(syntax, value);
+	case SCHEMA_BOOLEAN:
+		return !strcmp(value, "0") || !strcmp(value, "1") ||
+		       !strcmp(value, "false") || !strcmp(value, "true");
+	case SCHEMA_DATE_TIME:
+		return schema_date_time_valid(value);
+	case SCHEMA_BASE64:
+		if (len % 4 || strspn(value, SCHEMA_BASE64_CHARS) != len)
+			return false;
+		break;
+	case SCHEMA_HEX_BINARY:
+		if (len % 2 || strspn(value, SCHEMA_HEX_CHARS) != len)
+			return false;
+		break;
+	default:
+		break;
+	}
+
+	return !syntax->length || len <= syntax->length;
+}
+
+/*
+ * check a value against the data model before anything is set; names
+ * the schema doesn't know are left to the providers
+ */
+int schema_validate(const char *path, const char *value)
+{
+	struct schema_node *node = schema_find(path);
+
+	if (!node)
+		return SCHEMA_OK;
+
+	if (!node->writable)
+		return SCHEMA_NOT_WRITABLE;
+
+	if (!schema_value_valid(&node->syntax, value))
+		return SCHEMA_INVALID_VALUE;
+
+	return SCHEMA_OK;
+}
+
+const char *schema_xsd_type(const char *path)
+{
+	struct schema_node *node = schema_find(path);
+
+	return schema_xsd_types[node ? node->syntax.type : SCHEMA_STRING];
+}
+
+/*
+ * report names below path (GetParameterNames semantics); path is either
+ * empty, a partial path ending with a dot or a parameter name
+ */
+int schema_get_names(const char *path, bool next_level,
+		     schema_walk_cb cb, void *priv)
+{
+	struct schema_node *node;
+	char buf[SCHEMA_PATH_MAX];
+	size_t len;
+	int rc;
+
+	rc = schema_lookup(path, buf, &len, &node);
+	if (rc) return rc;
+
+	if (!node->object) {
+		if (next_level)
+			return SCHEMA_INVALID_ARGUMENTS;
+		return cb(buf, node->writable, priv) ? SCHEMA_ERROR : SCHEMA_OK;
+	}
+
+	if (next_level)
+		return schema_walk(node, buf, len, false, false, cb, priv);
+
+	return schema_walk(node, buf, len, true, true, cb, priv);
+}
+
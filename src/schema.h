@@ -0,0 +1,95 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_SCHEMA_H__
+#define _FREECWMP_SCHEMA_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SCHEMA_PATH_MAX		256
+
+/* placeholder for the instance number of multi-instance objects */
+#define SCHEMA_INSTANCE		"{i}"
+
+enum schema_error {
+	SCHEMA_OK = 0,
+	SCHEMA_ERROR = -1,
+	SCHEMA_INVALID_NAME = 1,
+	SCHEMA_INVALID_ARGUMENTS = 2,
+	SCHEMA_INVALID_VALUE = 3,
+	SCHEMA_NOT_WRITABLE = 4,
+};
+
+enum schema_type {
+	SCHEMA_STRING = 0,
+	SCHEMA_INT,
+	SCHEMA_UNSIGNED_INT,
+	SCHEMA_LONG,
+	SCHEMA_UNSIGNED_LONG,
+	SCHEMA_BOOLEAN,
+	SCHEMA_DATE_TIME,
+	SCHEMA_BASE64,
+	SCHEMA_HEX_BINARY,
+};
+
+/* max of the signed types is stored as unsigned long long as well */
+struct schema_range {
+	long long min;
+	unsigned long long max;
+};
+
+/*
+ * compiled from the data model document; numbers have to fall into one
+ * of the ranges (any number without ranges), strings, base64 and
+ * hexBinary are checked against length (0 for any)
+ */
+struct schema_syntax {
+	enum schema_type type;
+	const struct schema_range *ranges;
+	unsigned int ranges_num;
+	unsigned int length;
+};
+
+/*
+ * supported data model; object paths end with a dot, multi-instance
+ * objects use SCHEMA_INSTANCE and are expanded with the matching
+ * <Object>NumberOfEntries parameter of their parent; a zeroed syntax
+ * is a string of any length
+ */
+struct schema_param {
+	const char *path;
+	bool writable;
+	struct schema_syntax syntax;
+};
+
+struct schema_node {
+	char *name;
+	bool object;
+	bool writable;
+	struct schema_syntax syntax;
+
+	struct schema_node **children;
+	size_t children_num;
+};
+
+typedef int (*schema_walk_cb)(const char *name, bool writable, void *priv);
+
+int schema_init(void);
+void schema_exit(void);
+int schema_register(const struct schema_param *param);
+
+bool schema_exists(const char *path);
+int schema_validate(const char *path, const char *value);
+const char *schema_xsd_type(const char *path);
+int schema_get_names(const char *path, bool next_level,
+		     schema_walk_cb cb, void *priv);
+
+#endif
+
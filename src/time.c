@@ -7,20 +7,25 @@
  *	Copyright (C) 2011 Luka Perkov <freecwmp@lukaperkov.net>
  */
 
+#include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 #include "time.h"
 
 #include "freecwmp.h"
 
-char local_time[26] = {0};
+char local_time[27] = {0};
 
 char * mix_get_time(void)
 {
-	time_t t_time;
+	return mix_format_time(time(NULL));
+}
+
+char * mix_format_time(time_t t_time)
+{
 	struct tm *t_tm;
 
-	t_time = time(NULL);
 	t_tm = localtime(&t_time);
 	if (t_tm == NULL)
 		return NULL;
@@ -35,3 +40,51 @@ char * mix_get_time(void)
 
 	return local_time;
 }
+
+/*
+ * parse xsd:dateTime (e.g. 2012-04-01T13:10:00Z or 2012-04-01T15:10:00+02:00);
+ * values without time zone are treated as UTC, the unknown time
+ * 0001-01-01T00:00:00Z and unparsable values give 0
+ */
+time_t mix_parse_time(const char *value)
+{
+	struct tm t_tm;
+	char zone[8];
+	int offset_h, offset_m, n;
+	time_t t_time;
+
+	if (!value) return 0;
+
+	memset(&t_tm, 0, sizeof(t_tm));
+	memset(&zone, 0, sizeof(zone));
+
+	n = sscanf(value, "%d-%d-%dT%d:%d:%d%7s",
+		   &t_tm.tm_year, &t_tm.tm_mon, &t_tm.tm_mday,
+		   &t_tm.tm_hour, &t_tm.tm_min, &t_tm.tm_sec, zone);
+	if (n < 6) return 0;
+
+	if (t_tm.tm_year < 1970) return 0;
+
+	t_tm.tm_year -= 1900;
+	t_tm.tm_mon -= 1;
+
+	t_time = timegm(&t_tm);
+	if (t_time == -1) return 0;
+
+	/* skip fractional seconds */
+	if (zone[0] == '.') {
+		char *c = strpbrk(zone, "Z+-");
+		if (!c) return t_time;
+		memmove(zone, c, strlen(c) + 1);
+	}
+
+	if ((zone[0] == '+' || zone[0] == '-') &&
+	    sscanf(zone + 1, "%d:%d", &offset_h, &offset_m) == 2) {
+		if (zone[0] == '+')
+			t_time -= offset_h * 3600 + offset_m * 60;
+		else
+			t_time += offset_h * 3600 + offset_m * 60;
+	}
+
+	return t_time;
+}
@@ -10,7 +10,11 @@
 #ifndef _FREECWMP_TIME_H__
 #define _FREECWMP_TIME_H__
 
+#include <time.h>
+
 char * mix_get_time(void);
+char * mix_format_time(time_t t_time);
+time_t mix_parse_time(const char *value);
 
 #endif
 
@@ -0,0 +1,1144 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <libfreecwmp.h>
+#include <libubox/md5.h>
+#include <libubox/uloop.h>
+
+#ifdef HTTP_CURL
+#include <curl/curl.h>
+#endif
+
+#ifdef HTTP_ZSTREAM
+#include <zstream.h>
+#endif
+
+#include "transfer.h"
+
+#include "config.h"
+#include "cwmp.h"
+#include "deferred.h"
+#include "freecwmp.h"
+#include "http.h"
+#include "xml.h"
+
+static const struct {
+	const char *code;
+	const char *string;
+} transfer_faults[__TRANSFER_FAULT_MAX] = {
+	[TRANSFER_FAULT_NONE] = { "0", "" },
+	[TRANSFER_FAULT_INTERNAL] = { "9002", "Internal error" },
+	[TRANSFER_FAULT_CONTACT] = { "9015", "File transfer failure: unable to contact file server" },
+	[TRANSFER_FAULT_ACCESS] = { "9016", "File transfer failure: unable to access file" },
+	[TRANSFER_FAULT_INCOMPLETE] = { "9017", "File transfer failure: unable to complete download" },
+	[TRANSFER_FAULT_CORRUPTED] = { "9018", "File transfer failure: file corrupted" },
+	[TRANSFER_FAULT_AUTHENTICATION] = { "9019", "File transfer failure: file authentication failure" },
+	[TRANSFER_FAULT_APPLY] = { "9010", "Download failure" },
+	[TRANSFER_FAULT_UPLOAD] = { "9011", "Upload failure" },
+};
+
+static const struct {
+	bool upload;
+	const char *file_type;
+	char **local;
+	bool reboot;
+	bool upgrade;
+} transfer_types[] = {
+	{ false, "1 Firmware Upgrade Image", &fc_download_firmware, true, true },
+	{ false, "3 Vendor Configuration File", &fc_download_config, true, false },
+	{ true, "1 Vendor Configuration File", &fc_upload_config, false, false },
+	{ true, "2 Vendor Log File", &fc_upload_log, false, false },
+};
+
+static LIST_HEAD(transfers);
+static bool transfer_reboot;
+static const char *transfer_image;
+
+struct transfer_stream {
+	struct transfer *t;
+	struct transfer_local local;
+	md5_ctx_t md5;
+	uint64_t bytes;
+	uint64_t begin;
+	int fault;
+#ifdef HTTP_CURL
+	CURL *curl;
+#endif
+};
+
+static void transfer_schedule(void);
+
+void transfer_fault_info(int fault, const char **code, const char **string)
+{
+	if (fault < 0 || fault >= __TRANSFER_FAULT_MAX)
+		fault = TRANSFER_FAULT_INTERNAL;
+
+	*code = transfer_faults[fault].code;
+	*string = transfer_faults[fault].string;
+}
+
+static void transfer_free(struct transfer *t)
+{
+	if (!t) return;
+
+	scheduler_timer_cancel(&t->timer);
+	free(t->command_key);
+	free(t->file_type);
+	free(t->url);
+	free(t->username);
+	free(t->password);
+	free(t);
+}
+
+static int transfer_set_type(struct transfer *t)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(transfer_types); i++) {
+		if (t->upload == transfer_types[i].upload &&
+		    !strcmp(t->file_type, transfer_types[i].file_type)) {
+			t->local = *transfer_types[i].local;
+			t->reboot = transfer_types[i].reboot;
+			t->upgrade = transfer_types[i].upgrade;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static void transfer_save_string(FILE *fp, const char *name, const char *value)
+{
+	if (value)
+		fprintf(fp, "%s %s\n", name, value);
+}
+
+/*
+ * the whole queue, so queued transfers survive a reboot and finished ones
+ * still get their TransferComplete; it holds the file server credentials
+ * and is only readable by us
+ */
+static int transfer_save(void)
+{
+	struct transfer *t;
+	char *tmp;
+	FILE *fp;
+	int fd, i;
+
+	if (list_empty(&transfers)) {
+		remove(fc_transfer_state);
+		return 0;
+	}
+
+	if (freecwmp_mkdir_parent(fc_transfer_state)) {
+		D("couldn't create directory for %s\n", fc_transfer_state);
+		return -1;
+	}
+
+	if (asprintf(&tmp, "%s.tmp", fc_transfer_state) == -1)
+		return -1;
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) goto error;
+
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		close(fd);
+		goto error;
+	}
+
+	list_for_each_entry(t, &transfers, list) {
+		fprintf(fp, "transfer %d %d %ld %ld %ld %llu\n", t->state,
+			t->fault, (long) t->due, (long) t->start_time,
+			(long) t->complete_time, (unsigned long long) t->size);
+		if (t->upload)
+			fputs("upload 1\n", fp);
+		transfer_save_string(fp, "key", t->command_key);
+		transfer_save_string(fp, "type", t->file_type);
+		transfer_save_string(fp, "url", t->url);
+		transfer_save_string(fp, "username", t->username);
+		transfer_save_string(fp, "password", t->password);
+		if (t->has_md5) {
+			fputs("md5 ", fp);
+			for (i = 0; i < TRANSFER_MD5_LEN; i++)
+				fprintf(fp, "%02x", t->md5[i]);
+			fputc('\n', fp);
+		}
+	}
+
+	if (fflush(fp) || fsync(fileno(fp))) {
+		fclose(fp);
+		goto error;
+	}
+
+	if (fclose(fp) || rename(tmp, fc_transfer_state))
+		goto error;
+
+	free(tmp);
+	return 0;
+
+error:
+	D("couldn't save transfer state\n");
+	remove(tmp);
+	free(tmp);
+	return -1;
+}
+
+static int transfer_parse_md5(struct transfer *t, const char *md5)
+{
+	unsigned int byte;
+	int i;
+
+	if (strlen(md5) != 2 * TRANSFER_MD5_LEN)
+		return -1;
+
+	for (i = 0; i < TRANSFER_MD5_LEN; i++) {
+		if (sscanf(md5 + 2 * i, "%2x", &byte) != 1)
+			return -1;
+		t->md5[i] = byte;
+	}
+
+	t->has_md5 = true;
+	return 0;
+}
+
+static int transfer_load_string(char **dst, const char *value)
+{
+	free(*dst);
+	*dst = strdup(value);
+	return *dst ? 0 : -1;
+}
+
+static int transfer_load(void)
+{
+	struct transfer *t = NULL;
+	unsigned long long size;
+	long due, start, complete;
+	char *line = NULL, *value;
+	size_t len = 0;
+	ssize_t n;
+	int state, rc = 0;
+	FILE *fp;
+
+	fp = fopen(fc_transfer_state, "r");
+	if (!fp) return 0;
+
+	while ((n = getline(&line, &len, fp)) > 0) {
+		if (line[n - 1] == '\n')
+			line[n - 1] = '\0';
+
+		value = strchr(line, ' ');
+		if (!value) goto error;
+		*value++ = '\0';
+
+		if (!strcmp(line, "transfer")) {
+			t = calloc(1, sizeof(*t));
+			if (!t) goto error;
+			list_add_tail(&t->list, &transfers);
+
+			if (sscanf(value, "%d %d %ld %ld %ld %llu", &state,
+				   &t->fault, &due, &start, &complete,
+				   &size) != 6 ||
+			    state < TRANSFER_QUEUED || state > TRANSFER_DONE)
+				goto error;
+
+			t->state = state;
+			t->due = due;
+			t->start_time = start;
+			t->complete_time = complete;
+			t->size = size;
+			continue;
+		}
+
+		if (!t) goto error;
+
+		if (!strcmp(line, "upload"))
+			t->upload = true;
+		else if (!strcmp(line, "key"))
+			rc = transfer_load_string(&t->command_key, value);
+		else if (!strcmp(line, "type"))
+			rc = transfer_load_string(&t->file_type, value);
+		else if (!strcmp(line, "url"))
+			rc = transfer_load_string(&t->url, value);
+		else if (!strcmp(line, "username"))
+			rc = transfer_load_string(&t->username, value);
+		else if (!strcmp(line, "password"))
+			rc = transfer_load_string(&t->password, value);
+		else if (!strcmp(line, "md5"))
+			rc = transfer_parse_md5(t, value);
+
+		if (rc) goto error;
+	}
+
+	/* the queue has to be usable as a whole, a partial one is dropped */
+	list_for_each_entry(t, &transfers, list) {
+		if (!t->command_key || !t->file_type || !t->url)
+			goto error;
+		if (transfer_set_type(t) && t->state != TRANSFER_DONE)
+			goto error;
+	}
+
+	free(line);
+	fclose(fp);
+	return 0;
+
+error:
+	D("%s is not a valid transfer state file\n", fc_transfer_state);
+	while (!list_empty(&transfers)) {
+		t = list_first_entry(&transfers, struct transfer, list);
+		list_del(&t->list);
+		transfer_free(t);
+	}
+	free(line);
+	fclose(fp);
+	return -1;
+}
+
+static void transfer_events(struct transfer *t)
+{
+	cwmp_add_event(TRANSFER_COMPLETE, NULL);
+	cwmp_add_event(t->upload ? EVENT_M_UPLOAD : EVENT_M_DOWNLOAD,
+		       t->command_key);
+}
+
+/* config reloads drop the event queue, so it is refilled every session */
+void transfer_queue_events(void)
+{
+	struct transfer *t;
+
+	list_for_each_entry(t, &transfers, list) {
+		if (t->state == TRANSFER_DONE)
+			transfer_events(t);
+	}
+}
+
+/* run a command with one end of a pipe as its standard input or output */
+static int transfer_local_command(struct transfer_local *l, const char *command,
+				  bool source)
+{
+	int pfds[2];
+
+	if (pipe(pfds) < 0)
+		return -1;
+
+	if ((l->pid = fork()) == -1) {
+		close(pfds[0]);
+		close(pfds[1]);
+		return -1;
+	}
+
+	if (l->pid == 0) {
+		/* child */
+
+		const char *argv[4];
+		int i = 0;
+		argv[i++] = "/bin/sh";
+		argv[i++] = "-c";
+		argv[i++] = command;
+		argv[i++] = NULL;
+
+		if (source) {
+			close(pfds[0]);
+			dup2(pfds[1], 1);
+			close(pfds[1]);
+		} else {
+			close(pfds[1]);
+			dup2(pfds[0], 0);
+			close(pfds[0]);
+		}
+
+		execvp(argv[0], (char **) argv);
+		exit(ESRCH);
+	}
+
+	/* parent */
+	if (source) {
+		close(pfds[1]);
+		l->fd = pfds[0];
+	} else {
+		close(pfds[0]);
+		l->fd = pfds[1];
+	}
+
+	return 0;
+}
+
+static int transfer_local_wait(struct transfer_local *l)
+{
+	int status;
+
+	while (waitpid(l->pid, &status, 0) == -1) {
+		if (errno != EINTR)
+			return -1;
+	}
+
+	return WIFEXITED(status) && !WEXITSTATUS(status) ? 0 : -1;
+}
+
+static int transfer_sink_open(struct transfer_local *l, const char *target)
+{
+	l->pid = 0;
+
+	if (*target == '|')
+		return transfer_local_command(l, target + 1, false);
+
+	l->fd = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	return l->fd < 0 ? -1 : 0;
+}
+
+static int transfer_sink_write(struct transfer_local *l, const char *buf,
+			       size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = write(l->fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * a command that did not get the whole file is killed before it sees the
+ * end of its input; that only protects commands reading all of it before
+ * they change anything, like uci import, the others need a staged file
+ */
+static int transfer_sink_close(struct transfer_local *l, const char *target,
+			       bool commit)
+{
+	int rc = 0;
+
+	if (l->pid && !commit)
+		kill(l->pid, SIGKILL);
+
+	if (close(l->fd))
+		rc = -1;
+
+	if (l->pid) {
+		if (transfer_local_wait(l))
+			rc = -1;
+	} else if (!commit) {
+		unlink(target);
+	}
+
+	return rc;
+}
+
+static int transfer_source_open(struct transfer_local *l, const char *source)
+{
+	l->pid = 0;
+
+	if (*source == '|')
+		return transfer_local_command(l, source + 1, true);
+
+	l->fd = open(source, O_RDONLY);
+	return l->fd < 0 ? -1 : 0;
+}
+
+/* a generated stream only counts as sent if its command succeeded */
+static int transfer_source_close(struct transfer_local *l, bool complete)
+{
+	int rc = 0;
+
+	if (l->pid && !complete)
+		kill(l->pid, SIGKILL);
+
+	if (close(l->fd))
+		rc = -1;
+
+	if (l->pid && transfer_local_wait(l))
+		rc = -1;
+
+	return rc;
+}
+
+/*
+ * hold the transfer back to its rate; sleeping in the transfer process lets
+ * the socket buffers fill up, which makes TCP slow down the server
+ */
+static void transfer_throttle(struct transfer_stream *s)
+{
+	uint64_t elapsed, due;
+
+	if (!s->t->rate)
+		return;
+
+	elapsed = scheduler_msecs() - s->begin;
+	due = s->bytes * 1000 / s->t->rate;
+
+	if (due > elapsed)
+		usleep((due - elapsed) * 1000);
+}
+
+/* called for every chunk as it arrives, only a chunk is ever kept in memory */
+static int transfer_stream_data(struct transfer_stream *s, const char *buf,
+				size_t len)
+{
+	if (!len)
+		return 0;
+
+	if (s->t->size && s->bytes + len > s->t->size) {
+		s->fault = TRANSFER_FAULT_CORRUPTED;
+		return -1;
+	}
+
+	if (!s->bytes && transfer_sink_open(&s->local, s->t->local)) {
+		s->fault = TRANSFER_FAULT_APPLY;
+		return -1;
+	}
+
+	s->bytes += len;
+
+	if (s->t->has_md5)
+		md5_hash(buf, len, &s->md5);
+
+	if (transfer_sink_write(&s->local, buf, len)) {
+		s->fault = TRANSFER_FAULT_APPLY;
+		return -1;
+	}
+
+	transfer_throttle(s);
+
+	return 0;
+}
+
+/* fills buf with the next chunk of the upload, 0 at its end */
+static ssize_t transfer_stream_read(struct transfer_stream *s, char *buf,
+				    size_t len)
+{
+	ssize_t n;
+
+	do {
+		n = read(s->local.fd, buf, len);
+	} while (n < 0 && errno == EINTR);
+
+	if (n < 0) {
+		s->fault = TRANSFER_FAULT_UPLOAD;
+		return -1;
+	}
+
+	s->bytes += n;
+	transfer_throttle(s);
+
+	return n;
+}
+
+#ifdef HTTP_CURL
+static size_t transfer_curl_data(void *buffer, size_t size, size_t nmemb,
+				 void *priv)
+{
+	struct transfer_stream *s = priv;
+	double length;
+
+	/* refuse a file of the wrong size before the target is touched */
+	if (!s->bytes && s->t->size &&
+	    curl_easy_getinfo(s->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD,
+			      &length) == CURLE_OK &&
+	    length >= 0 && (uint64_t) length != s->t->size) {
+		s->fault = TRANSFER_FAULT_CORRUPTED;
+		return 0;
+	}
+
+	if (transfer_stream_data(s, buffer, size * nmemb))
+		return 0;
+
+	return size * nmemb;
+}
+
+static size_t transfer_curl_read(char *buffer, size_t size, size_t nmemb,
+				 void *priv)
+{
+	struct transfer_stream *s = priv;
+	ssize_t n;
+
+	n = transfer_stream_read(s, buffer, size * nmemb);
+
+	return n < 0 ? CURL_READFUNC_ABORT : n;
+}
+
+static int transfer_curl_open(struct transfer_stream *s, char **userpwd)
+{
+	*userpwd = NULL;
+
+	s->curl = curl_easy_init();
+	if (!s->curl) return -1;
+
+	curl_easy_setopt(s->curl, CURLOPT_URL, s->t->url);
+	curl_easy_setopt(s->curl, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(s->curl, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(s->curl, CURLOPT_NOSIGNAL, 1L);
+
+	if (s->t->username && *s->t->username) {
+		if (asprintf(userpwd, "%s:%s", s->t->username,
+			     s->t->password ? s->t->password : "") == -1) {
+			*userpwd = NULL;
+			curl_easy_cleanup(s->curl);
+			return -1;
+		}
+		curl_easy_setopt(s->curl, CURLOPT_USERPWD, *userpwd);
+		curl_easy_setopt(s->curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
+	}
+
+	return 0;
+}
+
+static int transfer_curl_perform(struct transfer_stream *s, char *userpwd)
+{
+	CURLcode res;
+	long code = 0;
+
+	res = curl_easy_perform(s->curl);
+	curl_easy_getinfo(s->curl, CURLINFO_RESPONSE_CODE, &code);
+	curl_easy_cleanup(s->curl);
+	free(userpwd);
+
+	if (s->fault)
+		return s->fault;
+
+	switch (res) {
+	case CURLE_OK:
+		return TRANSFER_FAULT_NONE;
+	case CURLE_COULDNT_RESOLVE_HOST:
+	case CURLE_COULDNT_CONNECT:
+		return TRANSFER_FAULT_CONTACT;
+	case CURLE_HTTP_RETURNED_ERROR:
+		if (code == 401 || code == 403)
+			return TRANSFER_FAULT_AUTHENTICATION;
+		return TRANSFER_FAULT_ACCESS;
+	default:
+		return TRANSFER_FAULT_INCOMPLETE;
+	}
+}
+
+static int transfer_fetch(struct transfer_stream *s)
+{
+	char *userpwd;
+
+	if (transfer_curl_open(s, &userpwd))
+		return TRANSFER_FAULT_INTERNAL;
+
+	curl_easy_setopt(s->curl, CURLOPT_WRITEFUNCTION, transfer_curl_data);
+	curl_easy_setopt(s->curl, CURLOPT_WRITEDATA, s);
+
+	return transfer_curl_perform(s, userpwd);
+}
+
+/*
+ * an HTTP PUT fed from the read callback; a generated stream has no known
+ * length and goes out with chunked encoding
+ */
+static int transfer_send(struct transfer_stream *s)
+{
+	struct stat st;
+	char *userpwd;
+
+	if (transfer_curl_open(s, &userpwd))
+		return TRANSFER_FAULT_INTERNAL;
+
+	curl_easy_setopt(s->curl, CURLOPT_UPLOAD, 1L);
+	curl_easy_setopt(s->curl, CURLOPT_READFUNCTION, transfer_curl_read);
+	curl_easy_setopt(s->curl, CURLOPT_READDATA, s);
+
+	if (!s->local.pid && !fstat(s->local.fd, &st))
+		curl_easy_setopt(s->curl, CURLOPT_INFILESIZE_LARGE,
+				 (curl_off_t) st.st_size);
+
+	return transfer_curl_perform(s, userpwd);
+}
+#endif /* HTTP_CURL */
+
+#ifdef HTTP_ZSTREAM
+static int transfer_fetch(struct transfer_stream *s)
+{
+	char buffer[TRANSFER_BUFFER_SIZE];
+	zstream_t *stream;
+	ssize_t rxed;
+
+	stream = zstream_open(s->t->url, ZSTREAM_GET);
+	if (!stream) return TRANSFER_FAULT_CONTACT;
+
+	while ((rxed = zstream_read(stream, buffer, sizeof(buffer))) > 0) {
+		if (transfer_stream_data(s, buffer, rxed))
+			break;
+	}
+
+	zstream_close(stream);
+
+	if (s->fault)
+		return s->fault;
+
+	return rxed < 0 ? TRANSFER_FAULT_INCOMPLETE : TRANSFER_FAULT_NONE;
+}
+
+static int transfer_send(struct transfer_stream *s)
+{
+	char buffer[TRANSFER_BUFFER_SIZE];
+	zstream_t *stream;
+	ssize_t n;
+
+	stream = zstream_open(s->t->url, ZSTREAM_PUT);
+	if (!stream) return TRANSFER_FAULT_CONTACT;
+
+	while ((n = transfer_stream_read(s, buffer, sizeof(buffer))) > 0) {
+		if (zstream_write(stream, buffer, n) != n) {
+			s->fault = TRANSFER_FAULT_INCOMPLETE;
+			break;
+		}
+	}
+
+	/* an empty write ends the request, the response tells how it went */
+	if (!s->fault && zstream_write(stream, NULL, 0) < 0)
+		s->fault = TRANSFER_FAULT_INCOMPLETE;
+
+	while (!s->fault && (n = zstream_read(stream, buffer, sizeof(buffer))) > 0)
+		;
+
+	zstream_close(stream);
+
+	if (s->fault)
+		return s->fault;
+
+	return n < 0 ? TRANSFER_FAULT_ACCESS : TRANSFER_FAULT_NONE;
+}
+#endif /* HTTP_ZSTREAM */
+
+/* both run in the transfer process, the result is its exit status */
+static int transfer_run_upload(struct transfer *t)
+{
+	struct transfer_stream s = { .t = t };
+	int fault;
+
+	if (transfer_source_open(&s.local, t->local))
+		return TRANSFER_FAULT_UPLOAD;
+
+	s.begin = scheduler_msecs();
+	fault = transfer_send(&s);
+
+	if (transfer_source_close(&s.local, !fault) && !fault)
+		fault = TRANSFER_FAULT_UPLOAD;
+
+	return fault;
+}
+
+static int transfer_run_download(struct transfer *t)
+{
+	struct transfer_stream s = { .t = t };
+	uint8_t md5[TRANSFER_MD5_LEN];
+	int fault;
+
+	if (t->has_md5)
+		md5_begin(&s.md5);
+
+	s.begin = scheduler_msecs();
+	fault = transfer_fetch(&s);
+
+	if (!fault && !s.bytes)
+		fault = TRANSFER_FAULT_INCOMPLETE;
+
+	if (!fault && t->size && s.bytes != t->size)
+		fault = TRANSFER_FAULT_CORRUPTED;
+
+	if (!fault && t->has_md5) {
+		md5_end(md5, &s.md5);
+		if (memcmp(md5, t->md5, sizeof(md5)))
+			fault = TRANSFER_FAULT_CORRUPTED;
+	}
+
+	if (s.bytes &&
+	    transfer_sink_close(&s.local, t->local, !fault) && !fault)
+		fault = TRANSFER_FAULT_APPLY;
+
+	return fault;
+}
+
+static unsigned int transfer_running(void)
+{
+	struct transfer *t;
+	unsigned int running = 0;
+
+	list_for_each_entry(t, &transfers, list) {
+		if (t->state == TRANSFER_RUNNING)
+			running++;
+	}
+
+	return running;
+}
+
+static void transfer_finished(struct uloop_process *proc, int ret)
+{
+	struct transfer *t = container_of(proc, struct transfer, proc);
+
+	t->fault = WIFEXITED(ret) ? WEXITSTATUS(ret) : TRANSFER_FAULT_INTERNAL;
+	if (t->fault >= __TRANSFER_FAULT_MAX)
+		t->fault = TRANSFER_FAULT_INTERNAL;
+
+	t->complete_time = time(NULL);
+	t->state = TRANSFER_DONE;
+	transfer_save();
+
+	freecwmp_log_message(NAME, L_NOTICE,
+			     "%s '%s' finished with fault %s\n",
+			     t->upload ? "upload" : "download", t->url,
+			     transfer_faults[t->fault].code);
+
+	transfer_events(t);
+
+	/*
+	 * the new image or config only takes effect after a reboot, which
+	 * waits for the session that reports the last running transfer
+	 */
+	if (!t->fault && t->reboot)
+		transfer_reboot = true;
+	if (!t->fault && t->upgrade)
+		transfer_image = t->local;
+
+	if (transfer_reboot) {
+		if (transfer_running())
+			return;
+		if (transfer_image ?
+		    deferred_add(DEFERRED_UPGRADE, transfer_image) :
+		    deferred_add(DEFERRED_REBOOT, NULL))
+			D("couldn't queue the reboot\n");
+	}
+
+	transfer_schedule();
+	cwmp_request_inform();
+}
+
+static int transfer_start(struct transfer *t)
+{
+	struct transfer_limits *limits = config->transfer;
+
+	t->state = TRANSFER_RUNNING;
+	t->start_time = time(NULL);
+	t->rate = limits->bandwidth * 125 / limits->max_concurrent;
+
+	/* a reboot in the middle is reported as an incomplete download */
+	if (transfer_save())
+		return -1;
+
+	freecwmp_log_message(NAME, L_NOTICE,
+			     "starting %s url '%s'\n",
+			     t->upload ? "upload" : "download", t->url);
+
+	if ((t->proc.pid = fork()) == -1)
+		return -1;
+
+	if (t->proc.pid == 0) {
+		/* child, a local command dying must not take us with it */
+		signal(SIGPIPE, SIG_IGN);
+		http_server_fork();
+		exit(t->upload ? transfer_run_upload(t) :
+				 transfer_run_download(t));
+	}
+
+	/* parent */
+	t->proc.cb = transfer_finished;
+	uloop_process_add(&t->proc);
+
+	return 0;
+}
+
+/*
+ * start ready transfers in arrival order up to the concurrency limit;
+ * nothing new is started once a finished transfer waits for its reboot
+ */
+static void transfer_schedule(void)
+{
+	struct transfer *t;
+	unsigned int running;
+
+	if (transfer_reboot)
+		return;
+
+	running = transfer_running();
+
+	list_for_each_entry(t, &transfers, list) {
+		if (running >= config->transfer->max_concurrent)
+			break;
+
+		if (t->state != TRANSFER_QUEUED || !t->ready)
+			continue;
+
+		if (transfer_start(t)) {
+			t->state = TRANSFER_DONE;
+			t->fault = TRANSFER_FAULT_INTERNAL;
+			t->complete_time = time(NULL);
+			transfer_save();
+			transfer_events(t);
+			cwmp_request_inform();
+			continue;
+		}
+
+		running++;
+	}
+}
+
+static void transfer_due(struct scheduler_timer *timer)
+{
+	struct transfer *t = container_of(timer, struct transfer, timer);
+
+	t->ready = true;
+	transfer_schedule();
+}
+
+static void transfer_arm(struct transfer *t)
+{
+	time_t now = time(NULL);
+
+	t->timer.cb = transfer_due;
+	scheduler_timer_set(&t->timer,
+			    t->due > now ? (uint64_t) (t->due - now) * 1000 : 0);
+}
+
+static bool transfer_valid_string(const char *value)
+{
+	return !value || !strchr(value, '\n');
+}
+
+static int transfer_add(bool upload, char *command_key, char *file_type,
+			char *url, char *username, char *password,
+			uint64_t size, char *md5, unsigned long delay)
+{
+	struct transfer *t;
+	unsigned int queued = 0;
+
+	list_for_each_entry(t, &transfers, list)
+		queued++;
+
+	/* finished transfers count until their TransferComplete is delivered */
+	if (queued >= config->transfer->max_queued)
+		return TRANSFER_BUSY;
+
+	if (!transfer_valid_string(command_key) || !transfer_valid_string(url) ||
+	    !transfer_valid_string(username) || !transfer_valid_string(password))
+		return TRANSFER_UNSUPPORTED;
+
+	t = calloc(1, sizeof(*t));
+	if (!t) return TRANSFER_ERROR;
+
+	t->command_key = strdup(command_key ? command_key : "");
+	t->file_type = strdup(file_type);
+	t->url = strdup(url);
+	t->username = username ? strdup(username) : NULL;
+	t->password = password ? strdup(password) : NULL;
+	if (!t->command_key || !t->file_type || !t->url ||
+	    (username && !t->username) || (password && !t->password))
+		goto error;
+
+	t->upload = upload;
+	if (transfer_set_type(t) || (md5 && *md5 && transfer_parse_md5(t, md5))) {
+		transfer_free(t);
+		return TRANSFER_UNSUPPORTED;
+	}
+
+	t->size = size;
+	t->state = TRANSFER_QUEUED;
+	t->due = time(NULL) + delay;
+
+	list_add_tail(&t->list, &transfers);
+	if (transfer_save()) {
+		list_del(&t->list);
+		goto error;
+	}
+
+	transfer_arm(t);
+	return TRANSFER_OK;
+
+error:
+	transfer_free(t);
+	return TRANSFER_ERROR;
+}
+
+int transfer_download(char *command_key, char *file_type, char *url,
+		      char *username, char *password, uint64_t size,
+		      char *md5, unsigned long delay)
+{
+	return transfer_add(false, command_key, file_type, url, username,
+			    password, size, md5, delay);
+}
+
+int transfer_upload(char *command_key, char *file_type, char *url,
+		    char *username, char *password, unsigned long delay)
+{
+	return transfer_add(true, command_key, file_type, url, username,
+			    password, 0, NULL, delay);
+}
+
+/* only transfers that have not started yet can be cancelled */
+int transfer_cancel(char *command_key)
+{
+	struct transfer *t, *tmp;
+	bool found = false;
+
+	if (!command_key)
+		command_key = "";
+
+	list_for_each_entry(t, &transfers, list) {
+		if (strcmp(t->command_key, command_key))
+			continue;
+		if (t->state != TRANSFER_QUEUED)
+			return TRANSFER_NOT_PERMITTED;
+		found = true;
+	}
+
+	if (!found)
+		return TRANSFER_NOT_FOUND;
+
+	list_for_each_entry_safe(t, tmp, &transfers, list) {
+		if (strcmp(t->command_key, command_key))
+			continue;
+		list_del(&t->list);
+		transfer_free(t);
+	}
+
+	transfer_save();
+	return TRANSFER_OK;
+}
+
+int transfer_walk(transfer_walk_cb cb, void *priv)
+{
+	struct transfer *t;
+
+	list_for_each_entry(t, &transfers, list) {
+		if (cb(t, priv))
+			return -1;
+	}
+
+	return 0;
+}
+
+static int transfer_complete_one(struct transfer *t)
+{
+	char *msg_in = NULL, *msg_out = NULL;
+	const char *code, *string;
+
+	transfer_fault_info(t->fault, &code, &string);
+
+	if (xml_prepare_transfer_complete_message(t->command_key,
+						  code, string,
+						  t->start_time,
+						  t->complete_time,
+						  &msg_out))
+		goto error;
+
+	if (http_send_message(msg_out, &msg_in))
+		goto error;
+
+	if (!msg_in || xml_parse_transfer_complete_response_message(msg_in))
+		goto error;
+
+	free(msg_in);
+	free(msg_out);
+	return 0;
+
+error:
+	free(msg_in);
+	free(msg_out);
+	return -1;
+}
+
+/*
+ * send TransferComplete for every finished transfer; called within a
+ * session right after the InformResponse, a transfer is forgotten only
+ * once the ACS has acknowledged it
+ */
+int transfer_complete(void)
+{
+	struct transfer *t, *tmp;
+	bool pending = false;
+	int rc = 0;
+
+	list_for_each_entry_safe(t, tmp, &transfers, list) {
+		if (t->state != TRANSFER_DONE)
+			continue;
+
+		if (rc || transfer_complete_one(t)) {
+			rc = -1;
+			pending = true;
+			continue;
+		}
+
+		cwmp_remove_event(t->upload ? EVENT_M_UPLOAD : EVENT_M_DOWNLOAD,
+				  t->command_key);
+		list_del(&t->list);
+		transfer_free(t);
+	}
+
+	if (!pending)
+		cwmp_remove_event(TRANSFER_COMPLETE, NULL);
+
+	transfer_save();
+
+	/* completed transfers may have held back queued ones */
+	transfer_schedule();
+
+	return rc;
+}
+
+int transfer_init(void)
+{
+	struct transfer *t;
+	bool changed = false;
+
+	transfer_load();
+
+	list_for_each_entry(t, &transfers, list) {
+		switch (t->state) {
+		case TRANSFER_RUNNING:
+			t->state = TRANSFER_DONE;
+			t->fault = TRANSFER_FAULT_INCOMPLETE;
+			t->complete_time = time(NULL);
+			changed = true;
+			/* fall through */
+		case TRANSFER_DONE:
+			transfer_events(t);
+			break;
+		case TRANSFER_QUEUED:
+			transfer_arm(t);
+			break;
+		}
+	}
+
+	if (changed)
+		transfer_save();
+
+	return 0;
+}
+
+void transfer_exit(void)
+{
+	struct transfer *t;
+
+	while (!list_empty(&transfers)) {
+		t = list_first_entry(&transfers, struct transfer, list);
+		if (t->state == TRANSFER_RUNNING && t->proc.pid > 0)
+			kill(t->proc.pid, SIGTERM);
+		list_del(&t->list);
+		transfer_free(t);
+	}
+}
@@ -0,0 +1,131 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_TRANSFER_H__
+#define _FREECWMP_TRANSFER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <libubox/list.h>
+#include <libubox/uloop.h>
+
+#include "scheduler.h"
+
+/*
+ * download targets and upload sources per FileType; a leading '|' makes
+ * them a command that gets the file on its standard input or generates it
+ * on its standard output; such a command sees the file before its size
+ * and digest are checked, so the firmware image is staged in tmpfs and
+ * only handed to sysupgrade by the reboot that follows the download
+ */
+#ifdef DUMMY_MODE
+static char *fc_transfer_state = "./ext/tmp/freecwmp_transfer";
+static char *fc_download_firmware = "./ext/tmp/freecwmp_firmware";
+static char *fc_download_config = "./ext/tmp/freecwmp_config";
+static char *fc_upload_config = "|uci -c ./ext/openwrt/config export";
+static char *fc_upload_log = "|dmesg";
+#else
+static char *fc_transfer_state = "/etc/freecwmp/transfer";
+static char *fc_download_firmware = "/tmp/freecwmp_firmware";
+static char *fc_download_config = "|/sbin/uci import";
+static char *fc_upload_config = "|/sbin/uci export";
+static char *fc_upload_log = "|/sbin/logread";
+#endif
+
+#define TRANSFER_BUFFER_SIZE	4096
+#define TRANSFER_MD5_LEN	16
+
+enum transfer_error {
+	TRANSFER_ERROR = -1,
+	TRANSFER_OK = 0,
+	TRANSFER_BUSY = 1,
+	TRANSFER_UNSUPPORTED = 2,
+	TRANSFER_NOT_FOUND = 3,
+	TRANSFER_NOT_PERMITTED = 4,
+};
+
+/* values of State in GetAllQueuedTransfers */
+enum transfer_state {
+	TRANSFER_QUEUED = 1,
+	TRANSFER_RUNNING = 2,
+	TRANSFER_DONE = 3,	/* waiting for TransferComplete to be delivered */
+};
+
+/* outcome of a transfer, also the exit status of the transfer process */
+enum transfer_fault {
+	TRANSFER_FAULT_NONE = 0,
+	TRANSFER_FAULT_INTERNAL,
+	TRANSFER_FAULT_CONTACT,
+	TRANSFER_FAULT_ACCESS,
+	TRANSFER_FAULT_INCOMPLETE,
+	TRANSFER_FAULT_CORRUPTED,
+	TRANSFER_FAULT_AUTHENTICATION,
+	TRANSFER_FAULT_APPLY,
+	TRANSFER_FAULT_UPLOAD,
+	__TRANSFER_FAULT_MAX,
+};
+
+struct transfer_local {
+	int fd;
+	pid_t pid;
+};
+
+/*
+ * queued transfers are kept in arrival order and started in that order
+ * once their DelaySeconds passed, as far as the concurrency limit allows
+ */
+struct transfer {
+	struct list_head list;
+	struct scheduler_timer timer;
+	struct uloop_process proc;
+
+	char *command_key;
+	char *file_type;
+	char *url;
+	char *username;
+	char *password;
+	bool upload;
+	const char *local;	/* download target or upload source */
+	bool reboot;
+	bool upgrade;		/* local is an image to flash on the reboot */
+
+	uint64_t size;
+	bool has_md5;
+	uint8_t md5[TRANSFER_MD5_LEN];
+	unsigned long rate;	/* bytes/s, 0 is unlimited */
+
+	enum transfer_state state;
+	bool ready;
+	time_t due;
+	time_t start_time;
+	time_t complete_time;
+	int fault;
+};
+
+typedef int (*transfer_walk_cb)(struct transfer *t, void *priv);
+
+int transfer_init(void);
+void transfer_exit(void);
+
+int transfer_download(char *command_key, char *file_type, char *url,
+		      char *username, char *password, uint64_t size,
+		      char *md5, unsigned long delay);
+int transfer_upload(char *command_key, char *file_type, char *url,
+		    char *username, char *password, unsigned long delay);
+int transfer_cancel(char *command_key);
+int transfer_walk(transfer_walk_cb cb, void *priv);
+
+void transfer_queue_events(void);
+int transfer_complete(void);
+void transfer_fault_info(int fault, const char **code, const char **string);
+
+#endif
+
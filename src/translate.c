@@ -0,0 +1,150 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <libfreecwmp.h>
+
+#include "translate.h"
+
+#include "freecwmp.h"
+#include "schema.h"
+
+static const struct translate translations[] = {
+#define TRANSLATE(alias, served) { alias, served },
+#include "translate.def"
+#undef TRANSLATE
+};
+
+#define TRANSLATE_DIGITS	"0123456789"
+
+struct translate_match {
+	const char *instances[TRANSLATE_INSTANCES_MAX];
+	size_t lens[TRANSLATE_INSTANCES_MAX];
+	size_t instances_num;
+	size_t len;		/* of the path matched */
+};
+
+/*
+ * match pattern against the start of path; {i} takes an instance number
+ * or a {i} of a schema path, with schema set numbers of the pattern also
+ * stand for a {i} of the path
+ */
+static bool translate_match(const char *pattern, const char *path,
+			    bool schema, struct translate_match *m)
+{
+	const char *p = pattern, *s = path;
+	size_t l;
+
+	m->instances_num = 0;
+
+	while (*p) {
+		if (!strncmp(p, SCHEMA_INSTANCE, strlen(SCHEMA_INSTANCE))) {
+			l = strspn(s, TRANSLATE_DIGITS);
+			if (!l && !strncmp(s, SCHEMA_INSTANCE, strlen(SCHEMA_INSTANCE)))
+				l = strlen(SCHEMA_INSTANCE);
+			if (!l || m->instances_num == TRANSLATE_INSTANCES_MAX)
+				return false;
+
+			m->instances[m->instances_num] = s;
+			m->lens[m->instances_num++] = l;
+			p += strlen(SCHEMA_INSTANCE);
+			s += l;
+			continue;
+		}
+
+		l = strspn(p, TRANSLATE_DIGITS);
+		if (schema && l && (p == pattern || p[-1] == '.') &&
+		    (p[l] == '.' || !p[l]) &&
+		    !strncmp(s, SCHEMA_INSTANCE, strlen(SCHEMA_INSTANCE))) {
+			p += l;
+			s += strlen(SCHEMA_INSTANCE);
+			continue;
+		}
+
+		if (*p != *s)
+			return false;
+		p++;
+		s++;
+	}
+
+	/* objects cover what is below them, parameters only themselves */
+	if (p[-1] != '.' && *s)
+		return false;
+
+	m->len = s - path;
+	return true;
+}
+
+/* the most specific entry wins, that is the one with the longest pattern */
+static bool translate(const char *path, char *buf, bool reverse, bool schema)
+{
+	const struct translate *t, *best = NULL;
+	struct translate_match m, best_m;
+	const char *from, *to, *c;
+	size_t i, n, len = 0;
+
+	for (i = 0; i < ARRAY_SIZE(translations); i++) {
+		t = &translations[i];
+		from = reverse ? t->served : t->alias;
+
+		/* entries mostly differ right after the root */
+		if (*from != *path)
+			continue;
+
+		if (!translate_match(from, path, schema, &m))
+			continue;
+
+		if (!best || strlen(from) > len) {
+			best = t;
+			best_m = m;
+			len = strlen(from);
+		}
+	}
+
+	if (!best) return false;
+
+	to = reverse ? best->alias : best->served;
+	len = 0;
+	n = 0;
+
+	/* instance numbers are carried over in order */
+	for (c = to; *c && len < SCHEMA_PATH_MAX - 1; ) {
+		if (!strncmp(c, SCHEMA_INSTANCE, strlen(SCHEMA_INSTANCE)) &&
+		    n < best_m.instances_num) {
+			len += snprintf(buf + len, SCHEMA_PATH_MAX - len, "%.*s",
+					(int) best_m.lens[n], best_m.instances[n]);
+			n++;
+			c += strlen(SCHEMA_INSTANCE);
+			continue;
+		}
+		buf[len++] = *c++;
+	}
+
+	if (len >= SCHEMA_PATH_MAX || *c ||
+	    snprintf(buf + len, SCHEMA_PATH_MAX - len, "%s",
+		     path + best_m.len) >= SCHEMA_PATH_MAX - len) {
+		D("translation of '%s' is too long\n", path);
+		return false;
+	}
+
+	return true;
+}
+
+char *translate_path(char *path, char *buf)
+{
+	return translate(path, buf, false, false) ? buf : path;
+}
+
+/* the alias of a schema path, if it has one */
+bool translate_alias(const char *path, char *buf)
+{
+	return translate(path, buf, true, true);
+}
@@ -0,0 +1,33 @@
+/*
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	Copyright (C) 2012 Luka Perkov <freecwmp@lukaperkov.net>
+ */
+
+#ifndef _FREECWMP_TRANSLATE_H__
+#define _FREECWMP_TRANSLATE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* instance numbers a single translation may carry over */
+#define TRANSLATE_INSTANCES_MAX	4
+
+/* one line of translate.def */
+struct translate {
+	const char *alias;
+	const char *served;
+};
+
+/*
+ * buffers are SCHEMA_PATH_MAX long; translate_path() returns the path
+ * the providers serve, which is path itself when it is no alias
+ */
+char *translate_path(char *path, char *buf);
+bool translate_alias(const char *path, char *buf);
+
+#endif
+
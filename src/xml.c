@@ -9,17 +9,26 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <libfreecwmp.h>
 #include <microxml.h>
 
 #include "xml.h"
 
+#include "attribute.h"
 #include "config.h"
 #include "cwmp.h"
+#include "deferred.h"
 #include "external.h"
 #include "freecwmp.h"
+#include "instance.h"
 #include "messages.h"
+#include "provider.h"
+#include "schema.h"
 #include "time.h"
+#include "transfer.h"
+#include "translate.h"
 
 struct rpc_method {
 	const char *name;
@@ -49,8 +58,17 @@ static struct cwmp_namespaces
 const struct rpc_method rpc_methods[] = {
 	{ "SetParameterValues", xml_handle_set_parameter_values },
 	{ "GetParameterValues", xml_handle_get_parameter_values },
+	{ "GetParameterNames", xml_handle_get_parameter_names },
 	{ "SetParameterAttributes", xml_handle_set_parameter_attributes },
+	{ "GetParameterAttributes", xml_handle_get_parameter_attributes },
+	{ "AddObject", xml_handle_add_object },
+	{ "DeleteObject", xml_handle_delete_object },
 	{ "Download", xml_handle_download },
+	{ "Upload", xml_handle_upload },
+	{ "GetQueuedTransfers", xml_handle_get_queued_transfers },
+	{ "GetAllQueuedTransfers", xml_handle_get_all_queued_transfers },
+	{ "CancelTransfer", xml_handle_cancel_transfer },
+	{ "ScheduleInform", xml_handle_schedule_inform },
 	{ "FactoryReset", xml_handle_factory_reset },
 	{ "Reboot", xml_handle_reboot },
 };
@@ -134,7 +152,7 @@ static int xml_prepare_events_inform(mxml_node_t *tree)
 		b2 = mxmlNewElement (node, "EventCode");
 		if (!b2) goto error;
 
-		b2 = mxmlNewText(b2, 0, freecwmp_str_event_code(event->code));
+		b2 = mxmlNewText(b2, 0, cwmp_str_event_code(event->code));
 		if (!b2) goto error;
 
 		b2 = mxmlNewElement (node, "CommandKey");
@@ -213,60 +231,103 @@ error:
 	return -1;
 }
 
-int xml_prepare_inform_message(char **msg_out)
+static int xml_prepare_device_id_inform(mxml_node_t *tree)
 {
-	mxml_node_t *tree, *b;
-	char *c, *tmp;
-
-#ifdef DUMMY_MODE
-	FILE *fp;
-	fp = fopen("./ext/soap_msg_templates/cwmp_inform_message.xml", "r");
-	tree = mxmlLoadFile(NULL, fp, MXML_NO_CALLBACK);
-	fclose(fp);
-#else
-	tree = mxmlLoadString(NULL, CWMP_INFORM_MESSAGE, MXML_NO_CALLBACK);
-#endif
-	if (!tree) goto error;
+	mxml_node_t *b;
 
 	b = mxmlFindElement(tree, tree, "RetryCount", NULL, NULL, MXML_DESCEND);
-	if (!b) goto error;
+	if (!b) return -1;
 
 	b = mxmlNewInteger(b, cwmp->retry_count);
-	if (!b) goto error;
+	if (!b) return -1;
 
 	b = mxmlFindElement(tree, tree, "Manufacturer", NULL, NULL, MXML_DESCEND);
-	if (!b) goto error;
+	if (!b) return -1;
 
 	b = mxmlNewText(b, 0, config->device->manufacturer);
-	if (!b) goto error;
+	if (!b) return -1;
 
 	b = mxmlFindElement(tree, tree, "OUI", NULL, NULL, MXML_DESCEND);
-	if (!b) goto error;
+	if (!b) return -1;
 
 	b = mxmlNewText(b, 0, config->device->oui);
-	if (!b) goto error;
+	if (!b) return -1;
 
 	b = mxmlFindElement(tree, tree, "ProductClass", NULL, NULL, MXML_DESCEND);
-	if (!b) goto error;
+	if (!b) return -1;
 
 	b = mxmlNewText(b, 0, config->device->product_class);
-	if (!b) goto error;
+	if (!b) return -1;
 
 	b = mxmlFindElement(tree, tree, "SerialNumber", NULL, NULL, MXML_DESCEND);
-	if (!b) goto error;
+	if (!b) return -1;
 
 	b = mxmlNewText(b, 0, config->device->serial_number);
-	if (!b) goto error;
+	if (!b) return -1;
 
-	if (xml_prepare_events_inform(tree))
+	b = mxmlFindElement(tree, tree, "CurrentTime", NULL, NULL, MXML_DESCEND);
+	if (!b) return -1;
+
+	b = mxmlNewText(b, 0, mix_get_time());
+	if (!b) return -1;
+
+	return 0;
+}
+
+int xml_prepare_heartbeat_message(char **msg_out)
+{
+	mxml_node_t *tree, *b;
+
+#ifdef DUMMY_MODE
+	FILE *fp;
+	fp = fopen("./ext/soap_msg_templates/cwmp_heartbeat_message.xml", "r");
+	tree = mxmlLoadFile(NULL, fp, MXML_NO_CALLBACK);
+	fclose(fp);
+#else
+	tree = mxmlLoadString(NULL, CWMP_HEARTBEAT_MESSAGE, MXML_NO_CALLBACK);
+#endif
+	if (!tree) goto error;
+
+	if (xml_prepare_device_id_inform(tree))
 		goto error;
 
-	b = mxmlFindElement(tree, tree, "CurrentTime", NULL, NULL, MXML_DESCEND);
+	b = mxmlFindElement(tree, tree, "EventCode", NULL, NULL, MXML_DESCEND);
 	if (!b) goto error;
 
-	b = mxmlNewText(b, 0, mix_get_time());
+	b = mxmlNewText(b, 0, cwmp_str_event_code(EVENT_HEARTBEAT));
 	if (!b) goto error;
 
+	*msg_out = mxmlSaveAllocString(tree, MXML_NO_CALLBACK);
+
+	mxmlDelete(tree);
+	return 0;
+
+error:
+	mxmlDelete(tree);
+	return -1;
+}
+
+int xml_prepare_inform_message(char **msg_out)
+{
+	mxml_node_t *tree, *b;
+	char *c, *tmp;
+
+#ifdef DUMMY_MODE
+	FILE *fp;
+	fp = fopen("./ext/soap_msg_templates/cwmp_inform_message.xml", "r");
+	tree = mxmlLoadFile(NULL, fp, MXML_NO_CALLBACK);
+	fclose(fp);
+#else
+	tree = mxmlLoadString(NULL, CWMP_INFORM_MESSAGE, MXML_NO_CALLBACK);
+#endif
+	if (!tree) goto error;
+
+	if (xml_prepare_device_id_inform(tree))
+		goto error;
+
+	if (xml_prepare_events_inform(tree))
+		goto error;
+
 	b = mxmlFindElementText(tree, tree, "InternetGatewayDevice.DeviceInfo.Manufacturer", MXML_DESCEND);
 	if (!b) goto error;
 
@@ -344,7 +405,9 @@ int xml_prepare_inform_message(char **msg_out)
 		goto error;
 
 	c = NULL;
-	if (external_get_action("value", tmp, &c)) goto error;
+	if (provider_native_get(tmp, &c) &&
+	    external_get_action("value", tmp, &c))
+		goto error;
 	if (c) {
 		b = mxmlNewText(b, 0, c);
 		FREE(c);
@@ -360,7 +423,9 @@ int xml_prepare_inform_message(char **msg_out)
 		goto error;
 
 	c = NULL;
-	if (external_get_action("value", tmp, &c)) goto error;
+	if (provider_native_get(tmp, &c) &&
+	    external_get_action("value", tmp, &c))
+		goto error;
 	if (c) {
 		b = mxmlNewText(b, 0, c);
 		FREE(c);
@@ -414,6 +479,91 @@ error:
 	return -1;
 }
 
+int xml_prepare_transfer_complete_message(char *command_key,
+					  const char *fault_code,
+					  const char *fault_string,
+					  time_t start_time,
+					  time_t complete_time,
+					  char **msg_out)
+{
+	mxml_node_t *tree, *b, *n, *t;
+
+#ifdef DUMMY_MODE
+	FILE *fp;
+	fp = fopen("./ext/soap_msg_templates/cwmp_response_message.xml", "r");
+	tree = mxmlLoadFile(NULL, fp, MXML_NO_CALLBACK);
+	fclose(fp);
+#else
+	tree = mxmlLoadString(NULL, CWMP_RESPONSE_MESSAGE, MXML_NO_CALLBACK);
+#endif
+	if (!tree) return -1;
+
+	b = mxmlFindElement(tree, tree, "soap_env:Body", NULL, NULL, MXML_DESCEND);
+	if (!b) goto error;
+
+	n = mxmlNewElement(b, "cwmp:TransferComplete");
+	if (!n) goto error;
+
+	b = mxmlNewElement(n, "CommandKey");
+	if (!b) goto error;
+
+	if (command_key && *command_key && !mxmlNewText(b, 0, command_key))
+		goto error;
+
+	t = mxmlNewElement(n, "FaultStruct");
+	if (!t) goto error;
+
+	b = mxmlNewElement(t, "FaultCode");
+	if (!b || !mxmlNewText(b, 0, fault_code))
+		goto error;
+
+	b = mxmlNewElement(t, "FaultString");
+	if (!b) goto error;
+
+	if (*fault_string && !mxmlNewText(b, 0, fault_string))
+		goto error;
+
+	b = mxmlNewElement(n, "StartTime");
+	if (!b || !mxmlNewText(b, 0, mix_format_time(start_time)))
+		goto error;
+
+	b = mxmlNewElement(n, "CompleteTime");
+	if (!b || !mxmlNewText(b, 0, mix_format_time(complete_time)))
+		goto error;
+
+	*msg_out = mxmlSaveAllocString(tree, MXML_NO_CALLBACK);
+
+	mxmlDelete(tree);
+	return *msg_out ? 0 : -1;
+
+error:
+	mxmlDelete(tree);
+	return -1;
+}
+
+int xml_parse_transfer_complete_response_message(char *msg_in)
+{
+	mxml_node_t *tree, *b;
+	char *c;
+
+	tree = mxmlLoadString(NULL, msg_in, MXML_NO_CALLBACK);
+	if (!tree) return -1;
+
+	if (asprintf(&c, "%s:%s", ns.cwmp, "TransferCompleteResponse") == -1)
+		goto error;
+
+	b = mxmlFindElement(tree, tree, c, NULL, NULL, MXML_DESCEND);
+	FREE(c);
+	if (!b) goto error;
+
+	mxmlDelete(tree);
+	return 0;
+
+error:
+	mxmlDelete(tree);
+	return -1;
+}
+
 int xml_handle_message(char *msg_in, char **msg_out)
 {
 	mxml_node_t *tree_in, *tree_out, *b;
@@ -572,222 +722,866 @@ static int xml_create_generic_fault_message(mxml_node_t *body,
 	return 0;
 }
 
-int xml_handle_set_parameter_values(mxml_node_t *body_in,
-				    mxml_node_t *tree_in,
-				    mxml_node_t *tree_out)
+/*
+ * drop what has been staged; the reload also refreshes the freecwmp
+ * package in case a provider reverted it
+ */
+static void xml_set_parameter_values_abort(int staged)
 {
-	mxml_node_t *b = body_in;
-	char *parameter_name = NULL;
-	char *parameter_value = NULL;
+	provider_native_abort();
+	external_set_action_discard();
 
-	while (b) {
-		if (b && b->type == MXML_TEXT &&
-		    b->value.text.string &&
-		    b->parent->type == MXML_ELEMENT &&
-		    !strcmp(b->parent->value.element.name, "Name")) {
-			parameter_name = b->value.text.string;
-		}
-		if (b && b->type == MXML_TEXT &&
-		    b->value.text.string &&
-		    b->parent->type == MXML_ELEMENT &&
-		    !strcmp(b->parent->value.element.name, "Value")) {
-			parameter_value = b->value.text.string;
-		}
-		if (parameter_name && parameter_value) {
-			if (external_set_action_write("value",
-					parameter_name, parameter_value))
-				return -1;
-			parameter_name = NULL;
-			parameter_value = NULL;
-		}
-		b = mxmlWalkNext(b, body_in, MXML_DESCEND);
-	}
+	if (staged)
+		config_load();
+}
 
-	if (external_set_action_execute())
-		return -1;
+/* the 9003 fault is created with the first refused parameter */
+static int xml_add_set_parameter_values_fault(mxml_node_t *body,
+					      mxml_node_t **fault,
+					      const char *name,
+					      char *code, char *string)
+{
+	mxml_node_t *b, *t;
 
-	config_load();
+	if (!*fault) {
+		if (xml_create_generic_fault_message(body, true, "9003",
+						     "Invalid arguments"))
+			return -1;
 
-	b = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
-			    NULL, NULL, MXML_DESCEND);
-	if (!b) return -1;
+		*fault = mxmlFindElement(body, body, "cwmp:Fault",
+					 NULL, NULL, MXML_DESCEND);
+		if (!*fault) return -1;
+	}
 
-	b = mxmlNewElement(b, "cwmp:SetParameterValuesResponse");
+	b = mxmlNewElement(*fault, "SetParameterValuesFault");
 	if (!b) return -1;
 
-	b = mxmlNewElement(b, "Status");
-	if (!b) return -1;
+	t = mxmlNewElement(b, "ParameterName");
+	if (!t) return -1;
+
+	t = mxmlNewText(t, 0, name);
+	if (!t) return -1;
+
+	t = mxmlNewElement(b, "FaultCode");
+	if (!t) return -1;
+
+	t = mxmlNewText(t, 0, code);
+	if (!t) return -1;
+
+	t = mxmlNewElement(b, "FaultString");
+	if (!t) return -1;
+
+	t = mxmlNewText(t, 0, string);
+	if (!t) return -1;
 
-	b = mxmlNewText(b, 0, "1");
-	if (!b) return -1;
-	
 	return 0;
 }
 
-int xml_handle_get_parameter_values(mxml_node_t *body_in,
-				    mxml_node_t *tree_in,
-				    mxml_node_t *tree_out)
+/* next Name and Value pair of the request, *b is where to go on from */
+static bool xml_next_parameter_value(mxml_node_t **b, mxml_node_t *body_in,
+				     char **name, char **value)
 {
-	mxml_node_t *n, *b = body_in;
-	char *parameter_name = NULL;
-	char *parameter_value = NULL;
-	char *c;
-	int counter = 0;
+	mxml_node_t *n;
 
-	n = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
-			    NULL, NULL, MXML_DESCEND);
-	if (!n) return -1;
+	*name = *value = NULL;
 
-	n = mxmlNewElement(n, "cwmp:GetParameterValuesResponse");
-	if (!n) return -1;
+	for (n = *b; n; n = mxmlWalkNext(n, body_in, MXML_DESCEND)) {
+		if (n->type != MXML_TEXT ||
+		    !n->value.text.string ||
+		    n->parent->type != MXML_ELEMENT)
+			continue;
 
-	n = mxmlNewElement(n, "ParameterList");
-	if (!n) return -1;
+		if (!strcmp(n->parent->value.element.name, "Name"))
+			*name = n->value.text.string;
+		if (!strcmp(n->parent->value.element.name, "Value"))
+			*value = n->value.text.string;
 
-#ifdef ACS_MULTI
-	mxmlElementSetAttr(n, "xsi:type", "soap_enc:Array");
-#endif
+		if (*name && *value) {
+			*b = mxmlWalkNext(n, body_in, MXML_DESCEND);
+			return true;
+		}
+	}
 
-	while (b) {
-		if (b && b->type == MXML_TEXT &&
-		    b->value.text.string &&
-		    b->parent->type == MXML_ELEMENT &&
-		    !strcmp(b->parent->value.element.name, "string")) {
-			parameter_name = b->value.text.string;
+	*b = NULL;
+	return false;
+}
+
+/*
+ * every value is checked against the data model and staged with its
+ * provider before the first one is applied; a refused parameter drops
+ * everything staged and leaves the device untouched
+ */
+int xml_handle_set_parameter_values(mxml_node_t *body_in,
+				    mxml_node_t *tree_in,
+				    mxml_node_t *tree_out)
+{
+	mxml_node_t *b, *body, *fault = NULL;
+	char *parameter_name, *parameter_value, *name;
+	char path[SCHEMA_PATH_MAX];
+	int changed = 0, rc;
+
+	body = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
+			       NULL, NULL, MXML_DESCEND);
+	if (!body) return -1;
+
+	b = body_in;
+	while (xml_next_parameter_value(&b, body_in, &parameter_name,
+					&parameter_value)) {
+		name = translate_path(parameter_name, path);
+
+		switch (schema_validate(name, parameter_value)) {
+		case SCHEMA_OK:
+			break;
+		case SCHEMA_NOT_WRITABLE:
+			if (xml_add_set_parameter_values_fault(body, &fault,
+					parameter_name, "9008",
+					"Attempt to set a non-writable parameter"))
+				goto error;
+			continue;
+		default:
+			if (xml_add_set_parameter_values_fault(body, &fault,
+					parameter_name, "9007",
+					"Invalid parameter value"))
+				goto error;
+			continue;
 		}
 
-		if (parameter_name) {
-			if (!config_get_cwmp(parameter_name, &parameter_value)) {
-				// got the parameter value using libuci
-			} else if (!external_get_action("value",
-					parameter_name, &parameter_value)) {
-				// got the parameter value via external script
-			} else {
-				// error occurred when getting parameter value
-				goto out;
-			}
-			counter++;
+		/* ACS policies tend to resend the whole config */
+		if (cwmp_parameter_unchanged(name, parameter_value))
+			continue;
 
-			n = mxmlFindElement(tree_out, tree_out, "ParameterList", NULL, NULL, MXML_DESCEND);
-			if (!n) goto out;
+		rc = cwmp_set_parameter_write_handler(name, parameter_value);
+		switch (rc) {
+		case PROVIDER_NATIVE_OK:
+			changed++;
+			break;
+		case PROVIDER_NATIVE_INVALID_NAME:
+			if (xml_add_set_parameter_values_fault(body, &fault,
+					parameter_name, "9005",
+					"Invalid parameter name"))
+				goto error;
+			break;
+		case PROVIDER_NATIVE_INVALID_VALUE:
+			if (xml_add_set_parameter_values_fault(body, &fault,
+					parameter_name, "9007",
+					"Invalid parameter value"))
+				goto error;
+			break;
+		default:
+			goto error;
+		}
+	}
 
-			n = mxmlNewElement(n, "ParameterValueStruct");
-			if (!n) goto out;
+	if (fault) {
+		xml_set_parameter_values_abort(changed);
+		return 0;
+	}
 
-			n = mxmlNewElement(n, "Name");
-			if (!n) goto out;
+	/* nothing to commit, reload or re-read */
+	if (changed) {
+		if (provider_native_commit())
+			return -1;
 
-			n = mxmlNewText(n, 0, parameter_name);
-			if (!n) goto out;
+		if (external_set_action_execute())
+			return -1;
 
-			n = n->parent->parent;
-			n = mxmlNewElement(n, "Value");
-			if (!n) goto out;
+		if (deferred_add_requested())
+			return -1;
 
-#ifdef ACS_MULTI
-			mxmlElementSetAttr(n, "xsi:type", "xsd:string");
-#endif
-			n = mxmlNewText(n, 0, parameter_value);
-			if (!n) goto out;
-
-			/*
-			 * three day's work to finally find memory leak if we
-			 * free parameter_name;
-			 * it points to: b->value.text.string
-			 *
-			 * also, parameter_value can be NULL so we don't do checks
-			 */
-			parameter_name = NULL;
-		}
-		
-		FREE(parameter_value);
-		b = mxmlWalkNext(b, body_in, MXML_DESCEND);
+		b = body_in;
+		while (xml_next_parameter_value(&b, body_in, &parameter_name,
+						&parameter_value))
+			cwmp_parameter_applied(translate_path(parameter_name, path),
+					       parameter_value);
+
+		config_load();
 	}
 
-#ifdef ACS_MULTI
-	b = mxmlFindElement(tree_out, tree_out, "ParameterList", 
-			    NULL, NULL, MXML_DESCEND);
-	if (!b) goto out;
+	b = mxmlNewElement(body, "cwmp:SetParameterValuesResponse");
+	if (!b) return -1;
 
-	if (asprintf(&c, "cwmp:ParameterValueStruct[%d]", counter) == -1)
-		goto out;
+	b = mxmlNewElement(b, "Status");
+	if (!b) return -1;
 
-	mxmlElementSetAttr(b, "soap_enc:arrayType", c);
-	FREE(c);
-#endif
+	b = mxmlNewText(b, 0, changed ? "1" : "0");
+	if (!b) return -1;
 
-	FREE(parameter_value);
 	return 0;
 
-out:
-	FREE(parameter_value);
+error:
+	xml_set_parameter_values_abort(changed);
 	return -1;
 }
 
-static int xml_handle_set_parameter_attributes(mxml_node_t *body_in,
-					       mxml_node_t *tree_in,
-					       mxml_node_t *tree_out) {
-
-	mxml_node_t *n, *b = body_in;
-	char *c, *parameter_name, *parameter_notification;
-	uint8_t attr_notification_update;
+struct xml_script_value {
+	char *name;
+	char *value;
+};
 
-	/* handle cwmp:SetParameterAttributes */
-	if (asprintf(&c, "%s:%s", ns.cwmp, "SetParameterAttributes") == -1)
-		return -1;
+/*
+ * below a partial name the scripts are run once per subtree and their
+ * values kept sorted by name; batched holds the served subtrees that
+ * were already asked for
+ */
+struct xml_parameter_values {
+	mxml_node_t *list;
+	int counter;
+
+	bool batch;
+	struct xml_script_value *script;
+	size_t script_num;
+	size_t script_size;
+	char **batched;
+	size_t batched_num;
+};
 
-	n = mxmlFindElement(tree_in, tree_in, c, NULL, NULL, MXML_DESCEND);
-	FREE(c);
+static int xml_script_value_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct xml_script_value *) a)->name,
+		      ((const struct xml_script_value *) b)->name);
+}
 
-	if (!n) return -1;
-	b = n;
+static int xml_add_script_value(const char *name, const char *value,
+				void *priv)
+{
+	struct xml_parameter_values *values = priv;
+	struct xml_script_value *v;
+	size_t size;
+
+	if (values->script_num == values->script_size) {
+		size = values->script_size ? values->script_size * 2 : 32;
+		v = realloc(values->script, size * sizeof(*v));
+		if (!v) return -1;
+		values->script = v;
+		values->script_size = size;
+	}
 
-	while (b != NULL) {
-		if (b && b->type == MXML_ELEMENT &&
-		    !strcmp(b->value.element.name, "SetParameterAttributesStruct")) {
-			attr_notification_update = 0;
-			parameter_name = NULL;
-			parameter_notification = NULL;
-		}
-		if (b && b->type == MXML_TEXT &&
-		    b->value.text.string &&
-		    b->parent->type == MXML_ELEMENT &&
-		    !strcmp(b->parent->value.element.name, "Name")) {
-			parameter_name = b->value.text.string;
-		}
+	v = &values->script[values->script_num];
+	v->name = strdup(name);
+	v->value = strdup(value);
+	if (!v->name || !v->value) {
+		free(v->name);
+		free(v->value);
+		return -1;
+	}
+
+	values->script_num++;
+	return 0;
+}
+
+static int xml_batch_script_values(struct xml_parameter_values *values,
+				   char *subtree)
+{
+	char **batched, *name;
+	size_t i;
+
+	for (i = 0; i < values->batched_num; i++) {
+		if (!strncmp(subtree, values->batched[i],
+			     strlen(values->batched[i])))
+			return 0;
+	}
+
+	batched = realloc(values->batched,
+			  (values->batched_num + 1) * sizeof(*batched));
+	if (!batched) return -1;
+	values->batched = batched;
+
+	name = strdup(subtree);
+	if (!name) return -1;
+	values->batched[values->batched_num++] = name;
+
+	if (external_get_values(name, xml_add_script_value, values))
+		return -1;
+
+	qsort(values->script, values->script_num, sizeof(*values->script),
+	      xml_script_value_cmp);
+	return 0;
+}
+
+/* value of a script served parameter, its object is batched if need be */
+static int xml_get_script_value(struct xml_parameter_values *values,
+				char *name, char **value)
+{
+	struct xml_script_value key = { .name = name }, *v;
+	char object[SCHEMA_PATH_MAX];
+	size_t len;
+
+	len = strrchr(name, '.') - name + 1;
+	if (len >= sizeof(object))
+		return -1;
+
+	memcpy(object, name, len);
+	object[len] = '\0';
+
+	if (xml_batch_script_values(values, object))
+		return -1;
+
+	*value = NULL;
+	v = bsearch(&key, values->script, values->script_num,
+		    sizeof(*values->script), xml_script_value_cmp);
+	if (v && !(*value = strdup(v->value)))
+		return -1;
+
+	return 0;
+}
+
+static void xml_free_parameter_values(struct xml_parameter_values *values)
+{
+	size_t i;
+
+	for (i = 0; i < values->script_num; i++) {
+		free(values->script[i].name);
+		free(values->script[i].value);
+	}
+	free(values->script);
+
+	for (i = 0; i < values->batched_num; i++)
+		free(values->batched[i]);
+	free(values->batched);
+}
+
+/* the value is looked up under the served name, reported as asked for */
+static int xml_add_parameter_value(const char *parameter_name, bool writable,
+				   void *priv)
+{
+	struct xml_parameter_values *values = priv;
+	char path[SCHEMA_PATH_MAX], *name, *value = NULL;
+	mxml_node_t *n, *t;
+	int rc = -1;
+
+	/* objects of a partial path only group their parameters */
+	if (!*parameter_name || parameter_name[strlen(parameter_name) - 1] == '.')
+		return 0;
+
+	name = translate_path((char *) parameter_name, path);
+
+	if (provider_native_get(name, &value) &&
+	    config_get_cwmp(name, &value) &&
+	    (values->batch ?
+	     xml_get_script_value(values, name, &value) :
+	     external_get_action("value", name, &value)))
+		return -1;
+
+	n = mxmlNewElement(values->list, "ParameterValueStruct");
+	if (!n) goto out;
+
+	t = mxmlNewElement(n, "Name");
+	if (!t) goto out;
+
+	t = mxmlNewText(t, 0, parameter_name);
+	if (!t) goto out;
+
+	t = mxmlNewElement(n, "Value");
+	if (!t) goto out;
+
+#ifdef ACS_MULTI
+	mxmlElementSetAttr(t, "xsi:type", schema_xsd_type(name));
+#endif
+	t = mxmlNewText(t, 0, value ? value : "");
+	if (!t) goto out;
+
+	values->counter++;
+	rc = 0;
+
+out:
+	free(value);
+	return rc;
+}
+
+/*
+ * partial paths are expanded with the schema; the scripts get the served
+ * subtree of the partial name in one go, whatever an alias maps elsewhere
+ * is batched per object
+ */
+static int xml_get_subtree_values(struct xml_parameter_values *values,
+				  char *name)
+{
+	char path[SCHEMA_PATH_MAX], *served;
+	int rc;
+
+	served = translate_path(name, path);
+	if (*served && xml_batch_script_values(values, served))
+		return SCHEMA_ERROR;
+
+	values->batch = true;
+	rc = schema_get_names(name, false, xml_add_parameter_value, values);
+	values->batch = false;
+
+	return rc;
+}
+
+int xml_handle_get_parameter_values(mxml_node_t *body_in,
+				    mxml_node_t *tree_in,
+				    mxml_node_t *tree_out)
+{
+	struct xml_parameter_values values = { 0 };
+	mxml_node_t *n, *t, *b;
+	char *c, *name;
+	int rc;
+
+	t = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
+			    NULL, NULL, MXML_DESCEND);
+	if (!t) return -1;
+
+	n = mxmlNewElement(t, "cwmp:GetParameterValuesResponse");
+	if (!n) return -1;
+
+	values.list = mxmlNewElement(n, "ParameterList");
+	if (!values.list) return -1;
+
+#ifdef ACS_MULTI
+	mxmlElementSetAttr(values.list, "xsi:type", "soap_enc:Array");
+#endif
+
+	for (b = mxmlFindElement(body_in, body_in, "string", NULL, NULL, MXML_DESCEND);
+	     b; b = mxmlFindElement(b, body_in, "string", NULL, NULL, MXML_DESCEND)) {
+		name = "";
+		if (b->child && b->child->type == MXML_TEXT &&
+		    b->child->value.text.string)
+			name = b->child->value.text.string;
+
+		if (*name && name[strlen(name) - 1] != '.')
+			rc = xml_add_parameter_value(name, false, &values) ?
+			     SCHEMA_ERROR : SCHEMA_OK;
+		else
+			rc = xml_get_subtree_values(&values, name);
+		if (rc == SCHEMA_OK)
+			continue;
+
+		xml_free_parameter_values(&values);
+		mxmlDelete(n);
+		if (rc == SCHEMA_INVALID_NAME)
+			return xml_create_generic_fault_message(t, true, "9005",
+								"Invalid parameter name");
+		return -1;
+	}
+
+	xml_free_parameter_values(&values);
+
+#ifdef ACS_MULTI
+	if (asprintf(&c, "cwmp:ParameterValueStruct[%d]", values.counter) == -1)
+		return -1;
+
+	mxmlElementSetAttr(values.list, "soap_enc:arrayType", c);
+	free(c);
+#endif
+
+	return 0;
+}
+
+struct xml_parameter_names {
+	mxml_node_t *list;
+	int counter;
+};
+
+static int xml_add_parameter_info(const char *name, bool writable, void *priv)
+{
+	struct xml_parameter_names *names = priv;
+	mxml_node_t *n, *b;
+
+	n = mxmlNewElement(names->list, "ParameterInfoStruct");
+	if (!n) return -1;
+
+	b = mxmlNewElement(n, "Name");
+	if (!b) return -1;
+
+	b = mxmlNewText(b, 0, name);
+	if (!b) return -1;
+
+	b = mxmlNewElement(n, "Writable");
+	if (!b) return -1;
+
+	b = mxmlNewText(b, 0, writable ? "1" : "0");
+	if (!b) return -1;
+
+	names->counter++;
+	return 0;
+}
+
+static int xml_handle_get_parameter_names(mxml_node_t *body_in,
+					  mxml_node_t *tree_in,
+					  mxml_node_t *tree_out)
+{
+	struct xml_parameter_names names = { NULL, 0 };
+	mxml_node_t *n, *t, *b = body_in;
+	char *c, *parameter_path = NULL, *next_level = NULL;
+
+	while (b) {
 		if (b && b->type == MXML_TEXT &&
 		    b->value.text.string &&
 		    b->parent->type == MXML_ELEMENT &&
-		    !strcmp(b->parent->value.element.name, "NotificationChange")) {
-			attr_notification_update = (uint8_t) atoi(b->value.text.string);
+		    !strcmp(b->parent->value.element.name, "ParameterPath")) {
+			parameter_path = b->value.text.string;
 		}
 		if (b && b->type == MXML_TEXT &&
 		    b->value.text.string &&
 		    b->parent->type == MXML_ELEMENT &&
-		    !strcmp(b->parent->value.element.name, "Notification")) {
-			parameter_notification = b->value.text.string;
+		    !strcmp(b->parent->value.element.name, "NextLevel")) {
+			next_level = b->value.text.string;
 		}
-		if (attr_notification_update && parameter_name && parameter_notification) {
-			if (external_set_action_write("notification",
-					parameter_name, parameter_notification))
-				return -1;
-			attr_notification_update = 0;
-			parameter_name = NULL;
-			parameter_notification = NULL;
-		}
-		b = mxmlWalkNext(b, n, MXML_DESCEND);
+		b = mxmlWalkNext(b, body_in, MXML_DESCEND);
 	}
 
-	if (external_set_action_execute())
+	t = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
+			    NULL, NULL, MXML_DESCEND);
+	if (!t) return -1;
+
+	n = mxmlNewElement(t, "cwmp:GetParameterNamesResponse");
+	if (!n) return -1;
+
+	names.list = mxmlNewElement(n, "ParameterList");
+	if (!names.list) return -1;
+
+#ifdef ACS_MULTI
+	mxmlElementSetAttr(names.list, "xsi:type", "soap_enc:Array");
+#endif
+
+	/* an empty ParameterPath element has no text node at all */
+	switch (schema_get_names(parameter_path ? parameter_path : "",
+				 next_level && (!strcmp(next_level, "1") ||
+						!strcmp(next_level, "true")),
+				 xml_add_parameter_info, &names)) {
+	case SCHEMA_OK:
+		break;
+	case SCHEMA_INVALID_NAME:
+		mxmlDelete(n);
+		return xml_create_generic_fault_message(t, true, "9005",
+							"Invalid parameter name");
+	case SCHEMA_INVALID_ARGUMENTS:
+		mxmlDelete(n);
+		return xml_create_generic_fault_message(t, true, "9003",
+							"Invalid arguments");
+	default:
 		return -1;
+	}
+
+#ifdef ACS_MULTI
+	if (asprintf(&c, "cwmp:ParameterInfoStruct[%d]", names.counter) == -1)
+		return -1;
+
+	mxmlElementSetAttr(names.list, "soap_enc:arrayType", c);
+	FREE(c);
+#endif
+
+	return 0;
+}
+
+/* text of the first element called name below node, NULL if empty */
+static char *xml_get_element_text(mxml_node_t *node, const char *name,
+				  bool *found)
+{
+	mxml_node_t *b;
+
+	b = mxmlFindElement(node, node, name, NULL, NULL, MXML_DESCEND);
+	if (found) *found = b != NULL;
+	if (!b) return NULL;
+
+	b = mxmlWalkNext(b, node, MXML_DESCEND_FIRST);
+	if (!b || b->type != MXML_TEXT || !b->value.text.string)
+		return NULL;
+
+	return b->value.text.string;
+}
+
+static bool xml_get_boolean(char *value)
+{
+	return value && (!strcmp(value, "1") || !strcmp(value, "true"));
+}
+
+/*
+ * parse one SetParameterAttributesStruct; returns 0 or the CWMP fault code
+ * describing why the request can not be applied
+ */
+static int xml_parse_parameter_attributes(mxml_node_t *node, char **name,
+					  int *notification, int *access)
+{
+	mxml_node_t *list, *b;
+	bool found;
+	char *c;
+
+	*name = xml_get_element_text(node, "Name", &found);
+	if (!found) return 9003;
+	if (!*name) *name = "";
+
+	if (!schema_exists(*name))
+		return 9005;
+
+	*notification = -1;
+	if (xml_get_boolean(xml_get_element_text(node, "NotificationChange", NULL))) {
+		c = xml_get_element_text(node, "Notification", NULL);
+		if (!c || strlen(c) != 1 || *c < '0' || *c > '2')
+			return 9003;
+		*notification = *c - '0';
+	}
+
+	*access = -1;
+	if (xml_get_boolean(xml_get_element_text(node, "AccessListChange", NULL))) {
+		*access = 0;
+
+		list = mxmlFindElement(node, node, "AccessList", NULL, NULL, MXML_DESCEND);
+		if (!list) return 9003;
+
+		for (b = mxmlFindElement(list, list, "string", NULL, NULL, MXML_DESCEND);
+		     b; b = mxmlFindElement(b, list, "string", NULL, NULL, MXML_DESCEND)) {
+			if (!b->child || b->child->type != MXML_TEXT ||
+			    !b->child->value.text.string)
+				continue;
+			if (strcmp(b->child->value.text.string, "Subscriber"))
+				return 9003;
+			*access |= ACCESS_SUBSCRIBER;
+		}
+	}
+
+	return 0;
+}
+
+static int xml_handle_set_parameter_attributes(mxml_node_t *body_in,
+					       mxml_node_t *tree_in,
+					       mxml_node_t *tree_out) {
+
+	mxml_node_t *n, *b;
+	char *name, code[8], path[SCHEMA_PATH_MAX];
+	int notification, access, rc;
 
 	b = mxmlFindElement(tree_out, tree_out, "soap_env:Body", NULL, NULL, MXML_DESCEND);
 	if (!b) return -1;
 
+	/* validate everything first, the request is applied all or nothing */
+	for (n = mxmlFindElement(body_in, body_in, "SetParameterAttributesStruct",
+				 NULL, NULL, MXML_DESCEND);
+	     n; n = mxmlFindElement(n, body_in, "SetParameterAttributesStruct",
+				    NULL, NULL, MXML_NO_DESCEND)) {
+		rc = xml_parse_parameter_attributes(n, &name, &notification, &access);
+		if (!rc) continue;
+
+		snprintf(code, sizeof(code), "%d", rc);
+		return xml_create_generic_fault_message(b, true, code,
+			rc == 9005 ? "Invalid parameter name" : "Invalid arguments");
+	}
+
+	for (n = mxmlFindElement(body_in, body_in, "SetParameterAttributesStruct",
+				 NULL, NULL, MXML_DESCEND);
+	     n; n = mxmlFindElement(n, body_in, "SetParameterAttributesStruct",
+				    NULL, NULL, MXML_NO_DESCEND)) {
+		xml_parse_parameter_attributes(n, &name, &notification, &access);
+		name = translate_path(name, path);
+		if (attribute_set(name, notification, access))
+			return xml_create_generic_fault_message(b, false, "9002",
+								"Internal error");
+	}
+
+	if (attribute_save())
+		return xml_create_generic_fault_message(b, false, "9002",
+							"Internal error");
+
 	b = mxmlNewElement(b, "cwmp:SetParameterAttributesResponse");
 	if (!b) return -1;
 
-	config_load();
+	return 0;
+}
+
+struct xml_parameter_attributes {
+	mxml_node_t *list;
+	int counter;
+};
+
+static int xml_add_parameter_attributes(const char *name, bool writable,
+					void *priv)
+{
+	struct xml_parameter_attributes *attributes = priv;
+	mxml_node_t *n, *b;
+	uint8_t notification, access;
+	char c[2], path[SCHEMA_PATH_MAX];
+	int i = 0;
+
+	/* attributes are reported for parameters only */
+	if (!*name || name[strlen(name) - 1] == '.')
+		return 0;
+
+	/* kept once, under the name the provider serves */
+	attribute_get(translate_path((char *) name, path), &notification,
+		      &access);
+
+	n = mxmlNewElement(attributes->list, "ParameterAttributeStruct");
+	if (!n) return -1;
+
+	b = mxmlNewElement(n, "Name");
+	if (!b) return -1;
+
+	b = mxmlNewText(b, 0, name);
+	if (!b) return -1;
+
+	b = mxmlNewElement(n, "Notification");
+	if (!b) return -1;
+
+	c[0] = '0' + notification;
+	c[1] = '\0';
+	b = mxmlNewText(b, 0, c);
+	if (!b) return -1;
+
+	n = mxmlNewElement(n, "AccessList");
+	if (!n) return -1;
+
+	if (access & ACCESS_SUBSCRIBER) {
+		b = mxmlNewElement(n, "string");
+		if (!b) return -1;
+
+		b = mxmlNewText(b, 0, "Subscriber");
+		if (!b) return -1;
+		i++;
+	}
+
+#ifdef ACS_MULTI
+	mxmlElementSetAttr(n, "soap_enc:arrayType",
+			   i ? "xsd:string[1]" : "xsd:string[0]");
+#endif
+
+	attributes->counter++;
+	return 0;
+}
+
+static int xml_handle_get_parameter_attributes(mxml_node_t *body_in,
+					       mxml_node_t *tree_in,
+					       mxml_node_t *tree_out)
+{
+	struct xml_parameter_attributes attributes = { NULL, 0 };
+	mxml_node_t *n, *t, *b;
+	char *c, *name;
+	int rc;
+
+	t = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
+			    NULL, NULL, MXML_DESCEND);
+	if (!t) return -1;
+
+	n = mxmlNewElement(t, "cwmp:GetParameterAttributesResponse");
+	if (!n) return -1;
+
+	attributes.list = mxmlNewElement(n, "ParameterList");
+	if (!attributes.list) return -1;
+
+#ifdef ACS_MULTI
+	mxmlElementSetAttr(attributes.list, "xsi:type", "soap_enc:Array");
+#endif
+
+	for (b = mxmlFindElement(body_in, body_in, "string", NULL, NULL, MXML_DESCEND);
+	     b; b = mxmlFindElement(b, body_in, "string", NULL, NULL, MXML_DESCEND)) {
+		name = "";
+		if (b->child && b->child->type == MXML_TEXT &&
+		    b->child->value.text.string)
+			name = b->child->value.text.string;
+
+		rc = schema_get_names(name, false, xml_add_parameter_attributes,
+				      &attributes);
+		if (rc == SCHEMA_OK)
+			continue;
+
+		mxmlDelete(n);
+		if (rc == SCHEMA_INVALID_NAME)
+			return xml_create_generic_fault_message(t, true, "9005",
+								"Invalid parameter name");
+		return -1;
+	}
+
+#ifdef ACS_MULTI
+	if (asprintf(&c, "cwmp:ParameterAttributeStruct[%d]", attributes.counter) == -1)
+		return -1;
+
+	mxmlElementSetAttr(attributes.list, "soap_enc:arrayType", c);
+	FREE(c);
+#endif
+
+	return 0;
+}
+
+static int xml_handle_add_object(mxml_node_t *body_in,
+				 mxml_node_t *tree_in,
+				 mxml_node_t *tree_out)
+{
+	mxml_node_t *n, *t;
+	unsigned long number;
+	char *c, *object_name, path[SCHEMA_PATH_MAX];
+
+	object_name = xml_get_element_text(body_in, "ObjectName", NULL);
+	if (object_name)
+		object_name = translate_path(object_name, path);
+
+	t = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
+			    NULL, NULL, MXML_DESCEND);
+	if (!t) return -1;
+
+	switch (object_name ? instance_add(object_name, &number) :
+			      INSTANCE_INVALID_NAME) {
+	case INSTANCE_OK:
+		break;
+	case INSTANCE_INVALID_NAME:
+		return xml_create_generic_fault_message(t, true, "9005",
+							"Invalid parameter name");
+	default:
+		return xml_create_generic_fault_message(t, false, "9002",
+							"Internal error");
+	}
+
+	n = mxmlNewElement(t, "cwmp:AddObjectResponse");
+	if (!n) return -1;
+
+	t = mxmlNewElement(n, "InstanceNumber");
+	if (!t) return -1;
+
+	if (asprintf(&c, "%lu", number) == -1)
+		return -1;
+
+	t = mxmlNewText(t, 0, c);
+	FREE(c);
+	if (!t) return -1;
+
+	/* the uci config is committed, the service is reloaded after the session */
+	t = mxmlNewElement(n, "Status");
+	if (!t) return -1;
+
+	t = mxmlNewText(t, 0, "1");
+	if (!t) return -1;
+
+	return 0;
+}
+
+static int xml_handle_delete_object(mxml_node_t *body_in,
+				    mxml_node_t *tree_in,
+				    mxml_node_t *tree_out)
+{
+	mxml_node_t *n, *t;
+	char *object_name, path[SCHEMA_PATH_MAX];
+
+	object_name = xml_get_element_text(body_in, "ObjectName", NULL);
+	if (object_name)
+		object_name = translate_path(object_name, path);
+
+	t = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
+			    NULL, NULL, MXML_DESCEND);
+	if (!t) return -1;
+
+	switch (object_name ? instance_delete(object_name) :
+			      INSTANCE_INVALID_NAME) {
+	case INSTANCE_OK:
+		/* nothing is left to notify about below a deleted instance */
+		if (attribute_remove(object_name) && attribute_save())
+			D("couldn't save the attributes\n");
+		break;
+	case INSTANCE_INVALID_NAME:
+		return xml_create_generic_fault_message(t, true, "9005",
+							"Invalid parameter name");
+	default:
+		return xml_create_generic_fault_message(t, false, "9002",
+							"Internal error");
+	}
+
+	n = mxmlNewElement(t, "cwmp:DeleteObjectResponse");
+	if (!n) return -1;
+
+	t = mxmlNewElement(n, "Status");
+	if (!t) return -1;
+
+	t = mxmlNewText(t, 0, "1");
+	if (!t) return -1;
 
 	return 0;
 }
@@ -796,8 +1590,12 @@ static int xml_handle_download(mxml_node_t *body_in,
 			       mxml_node_t *tree_in,
 			       mxml_node_t *tree_out)
 {
-	mxml_node_t *n, *t, *b = body_in;
-	char *c, *download_url, *download_size;
+	mxml_node_t *n, *t, *b;
+	char *c, *url, *file_type, *file_size, *command_key;
+	char *username, *password, *md5, *delay_seconds;
+	unsigned long long size = 0;
+	unsigned long delay = 0;
+	bool delay_valid = true;
 
 	if (asprintf(&c, "%s:%s", ns.cwmp, "Download") == -1)
 		return -1;
@@ -806,55 +1604,363 @@ static int xml_handle_download(mxml_node_t *body_in,
 	FREE(c);
 
 	if (!n) return -1;
-	b = n;
 
-	download_url = NULL;
-	download_size = NULL;
-	while (b != NULL) {
-		if (b && b->type == MXML_TEXT &&
-		    b->value.text.string &&
-		    b->parent->type == MXML_ELEMENT &&
-		    !strcmp(b->parent->value.element.name, "URL")) {
-			download_url = b->value.text.string;
-		}
-		if (b && b->type == MXML_TEXT &&
-		    b->value.text.string &&
-		    b->parent->type == MXML_ELEMENT &&
-		    !strcmp(b->parent->value.element.name, "FileSize")) {
-			download_size = b->value.text.string;
-		}
-		b = mxmlWalkNext(b, n, MXML_DESCEND);
+	command_key = xml_get_element_text(n, "CommandKey", NULL);
+	file_type = xml_get_element_text(n, "FileType", NULL);
+	url = xml_get_element_text(n, "URL", NULL);
+	username = xml_get_element_text(n, "Username", NULL);
+	password = xml_get_element_text(n, "Password", NULL);
+	file_size = xml_get_element_text(n, "FileSize", NULL);
+	delay_seconds = xml_get_element_text(n, "DelaySeconds", NULL);
+	/* not part of TR-069, lets an ACS have the image checked on the fly */
+	md5 = xml_get_element_text(n, "X_freecwmp_org__MD5", NULL);
+
+	t = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
+			    NULL, NULL, MXML_DESCEND);
+	if (!t) return -1;
+
+	if (file_size && *file_size != '-') {
+		size = strtoull(file_size, &c, 10);
+		if (*c != '\0')
+			file_size = NULL;
 	}
-	if (!download_url || !download_size)
-		return -1;
 
-	t = mxmlFindElement(tree_out, tree_out, "soap_env:Body", NULL, NULL, MXML_DESCEND);
-	if (!t) return -1;
+	if (delay_seconds) {
+		delay = strtoul(delay_seconds, &c, 10);
+		if (*c != '\0' || *delay_seconds == '-')
+			delay_valid = false;
+	}
 
+	if (!url || !file_type || !file_size || !delay_valid ||
+	    (command_key && strlen(command_key) > 32))
+		return xml_create_generic_fault_message(t, true, "9003",
+							"Invalid arguments");
+
+	if (strncmp(url, "http://", 7) && strncmp(url, "https://", 8))
+		return xml_create_generic_fault_message(t, false, "9013",
+				"Unsupported protocol for file transfer");
+
+	switch (transfer_download(command_key, file_type, url, username,
+				  password, size, md5, delay)) {
+	case TRANSFER_OK:
+		break;
+	case TRANSFER_BUSY:
+		return xml_create_generic_fault_message(t, false, "9004",
+							"Resources exceeded");
+	case TRANSFER_UNSUPPORTED:
+		return xml_create_generic_fault_message(t, true, "9003",
+							"Invalid arguments");
+	default:
+		return xml_create_generic_fault_message(t, false, "9002",
+							"Internal error");
+	}
+
+	/* the download is queued and runs in the background, TransferComplete follows */
 	t = mxmlNewElement(t, "cwmp:DownloadResponse");
 	if (!t) return -1;
 
 	b = mxmlNewElement(t, "Status");
 	if (!b) return -1;
 
+	b = mxmlNewText(b, 0, "1");
+	if (!b) return -1;
+
 	b = mxmlNewElement(t, "StartTime");
 	if (!b) return -1;
 
-	b = mxmlNewText(b, 0, mix_get_time());
+	b = mxmlNewText(b, 0, "0001-01-01T00:00:00Z");
+	if (!b) return -1;
+
+	b = mxmlNewElement(t, "CompleteTime");
+	if (!b) return -1;
+
+	b = mxmlNewText(b, 0, "0001-01-01T00:00:00Z");
+	if (!b) return -1;
+
+	return 0;
+}
+
+static int xml_handle_upload(mxml_node_t *body_in,
+			     mxml_node_t *tree_in,
+			     mxml_node_t *tree_out)
+{
+	mxml_node_t *t, *b;
+	char *c, *url, *file_type, *command_key, *delay_seconds;
+	char *username, *password;
+	unsigned long delay = 0;
+	bool delay_valid = true;
+
+	command_key = xml_get_element_text(body_in, "CommandKey", NULL);
+	file_type = xml_get_element_text(body_in, "FileType", NULL);
+	url = xml_get_element_text(body_in, "URL", NULL);
+	username = xml_get_element_text(body_in, "Username", NULL);
+	password = xml_get_element_text(body_in, "Password", NULL);
+	delay_seconds = xml_get_element_text(body_in, "DelaySeconds", NULL);
+
+	t = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
+			    NULL, NULL, MXML_DESCEND);
+	if (!t) return -1;
+
+	if (delay_seconds) {
+		delay = strtoul(delay_seconds, &c, 10);
+		if (*c != '\0' || *delay_seconds == '-')
+			delay_valid = false;
+	}
+
+	if (!url || !file_type || !delay_valid ||
+	    (command_key && strlen(command_key) > 32))
+		return xml_create_generic_fault_message(t, true, "9003",
+							"Invalid arguments");
+
+	if (strncmp(url, "http://", 7) && strncmp(url, "https://", 8))
+		return xml_create_generic_fault_message(t, false, "9013",
+				"Unsupported protocol for file transfer");
+
+	switch (transfer_upload(command_key, file_type, url, username,
+				password, delay)) {
+	case TRANSFER_OK:
+		break;
+	case TRANSFER_BUSY:
+		return xml_create_generic_fault_message(t, false, "9004",
+							"Resources exceeded");
+	case TRANSFER_UNSUPPORTED:
+		return xml_create_generic_fault_message(t, true, "9003",
+							"Invalid arguments");
+	default:
+		return xml_create_generic_fault_message(t, false, "9002",
+							"Internal error");
+	}
+
+	/* the file is generated while it is sent, TransferComplete follows */
+	t = mxmlNewElement(t, "cwmp:UploadResponse");
+	if (!t) return -1;
+
+	b = mxmlNewElement(t, "Status");
 	if (!b) return -1;
 
-	b = mxmlFindElement(t, tree_out, "Status", NULL, NULL, MXML_DESCEND);
+	b = mxmlNewText(b, 0, "1");
 	if (!b) return -1;
 
-	if (external_download(download_url, download_size))
-		b = mxmlNewText(b, 0, "9000");
-	else
-		b = mxmlNewText(b, 0, "0");
+	b = mxmlNewElement(t, "StartTime");
+	if (!b) return -1;
+
+	b = mxmlNewText(b, 0, "0001-01-01T00:00:00Z");
+	if (!b) return -1;
 
 	b = mxmlNewElement(t, "CompleteTime");
 	if (!b) return -1;
 
-	b = mxmlNewText(b, 0, mix_get_time());
+	b = mxmlNewText(b, 0, "0001-01-01T00:00:00Z");
+	if (!b) return -1;
+
+	return 0;
+}
+
+struct xml_transfer_list {
+	mxml_node_t *list;
+	int counter;
+	bool all;
+};
+
+static int xml_add_text_element(mxml_node_t *parent, const char *name,
+				const char *value)
+{
+	mxml_node_t *n;
+
+	n = mxmlNewElement(parent, name);
+	if (!n) return -1;
+
+	n = mxmlNewText(n, 0, value);
+	if (!n) return -1;
+
+	return 0;
+}
+
+static int xml_add_queued_transfer(struct transfer *t, void *priv)
+{
+	struct xml_transfer_list *transfers = priv;
+	mxml_node_t *n;
+	char *c;
+	int rc;
+
+	n = mxmlNewElement(transfers->list, transfers->all ?
+			   "AllQueuedTransferStruct" : "QueuedTransferStruct");
+	if (!n) return -1;
+
+	if (xml_add_text_element(n, "CommandKey", t->command_key))
+		return -1;
+
+	if (asprintf(&c, "%d", t->state) == -1)
+		return -1;
+
+	rc = xml_add_text_element(n, "State", c);
+	FREE(c);
+	if (rc) return -1;
+
+	if (transfers->all) {
+		if (xml_add_text_element(n, "IsDownload", t->upload ? "0" : "1") ||
+		    xml_add_text_element(n, "FileType", t->file_type))
+			return -1;
+
+		if (asprintf(&c, "%llu", (unsigned long long) t->size) == -1)
+			return -1;
+
+		rc = xml_add_text_element(n, "FileSize", c);
+		FREE(c);
+		if (rc) return -1;
+
+		if (xml_add_text_element(n, "TargetFileName", ""))
+			return -1;
+	}
+
+	transfers->counter++;
+	return 0;
+}
+
+static int xml_create_queued_transfers(mxml_node_t *tree_out, bool all)
+{
+	struct xml_transfer_list transfers = { .all = all };
+	mxml_node_t *t;
+#ifdef ACS_MULTI
+	char *c;
+#endif
+
+	t = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
+			    NULL, NULL, MXML_DESCEND);
+	if (!t) return -1;
+
+	t = mxmlNewElement(t, all ? "cwmp:GetAllQueuedTransfersResponse" :
+				    "cwmp:GetQueuedTransfersResponse");
+	if (!t) return -1;
+
+	transfers.list = mxmlNewElement(t, "TransferList");
+	if (!transfers.list) return -1;
+
+#ifdef ACS_MULTI
+	mxmlElementSetAttr(transfers.list, "xsi:type", "soap_enc:Array");
+#endif
+
+	if (transfer_walk(xml_add_queued_transfer, &transfers))
+		return -1;
+
+#ifdef ACS_MULTI
+	if (asprintf(&c, "cwmp:%s[%d]", all ? "AllQueuedTransferStruct" :
+		     "QueuedTransferStruct", transfers.counter) == -1)
+		return -1;
+
+	mxmlElementSetAttr(transfers.list, "soap_enc:arrayType", c);
+	FREE(c);
+#endif
+
+	return 0;
+}
+
+static int xml_handle_get_queued_transfers(mxml_node_t *body_in,
+					   mxml_node_t *tree_in,
+					   mxml_node_t *tree_out)
+{
+	return xml_create_queued_transfers(tree_out, false);
+}
+
+static int xml_handle_get_all_queued_transfers(mxml_node_t *body_in,
+					       mxml_node_t *tree_in,
+					       mxml_node_t *tree_out)
+{
+	return xml_create_queued_transfers(tree_out, true);
+}
+
+static int xml_handle_cancel_transfer(mxml_node_t *body_in,
+				      mxml_node_t *tree_in,
+				      mxml_node_t *tree_out)
+{
+	mxml_node_t *t;
+	char *command_key;
+
+	command_key = xml_get_element_text(body_in, "CommandKey", NULL);
+
+	t = mxmlFindElement(tree_out, tree_out, "soap_env:Body",
+			    NULL, NULL, MXML_DESCEND);
+	if (!t) return -1;
+
+	switch (transfer_cancel(command_key)) {
+	case TRANSFER_OK:
+		break;
+	case TRANSFER_NOT_FOUND:
+		return xml_create_generic_fault_message(t, true, "9003",
+							"Invalid arguments");
+	case TRANSFER_NOT_PERMITTED:
+		return xml_create_generic_fault_message(t, false, "9021",
+				"Cancelation of file transfer not permitted in current transfer state");
+	default:
+		return xml_create_generic_fault_message(t, false, "9002",
+							"Internal error");
+	}
+
+	t = mxmlNewElement(t, "cwmp:CancelTransferResponse");
+	if (!t) return -1;
+
+	return 0;
+}
+
+static int xml_handle_schedule_inform(mxml_node_t *body_in,
+				      mxml_node_t *tree_in,
+				      mxml_node_t *tree_out)
+{
+	mxml_node_t *n, *t, *b = body_in;
+	char *c, *delay_seconds, *command_key;
+	unsigned long delay;
+
+	if (asprintf(&c, "%s:%s", ns.cwmp, "ScheduleInform") == -1)
+		return -1;
+
+	n = mxmlFindElement(tree_in, tree_in, c, NULL, NULL, MXML_DESCEND);
+	FREE(c);
+
+	if (!n) return -1;
+	b = n;
+
+	delay_seconds = NULL;
+	command_key = NULL;
+	while (b != NULL) {
+		if (b && b->type == MXML_TEXT &&
+		    b->value.text.string &&
+		    b->parent->type == MXML_ELEMENT &&
+		    !strcmp(b->parent->value.element.name, "DelaySeconds")) {
+			delay_seconds = b->value.text.string;
+		}
+		if (b && b->type == MXML_TEXT &&
+		    b->value.text.string &&
+		    b->parent->type == MXML_ELEMENT &&
+		    !strcmp(b->parent->value.element.name, "CommandKey")) {
+			command_key = b->value.text.string;
+		}
+		b = mxmlWalkNext(b, n, MXML_DESCEND);
+	}
+
+	t = mxmlFindElement(tree_out, tree_out, "soap_env:Body", NULL, NULL, MXML_DESCEND);
+	if (!t) return -1;
+
+	/* DelaySeconds is an unsignedInt and has to be greater than zero */
+	delay = 0;
+	if (delay_seconds && *delay_seconds != '-') {
+		delay = strtoul(delay_seconds, &c, 10);
+		if (*c != '\0' || delay > UINT32_MAX)
+			delay = 0;
+	}
+
+	if (!delay)
+		return xml_create_generic_fault_message(t, true, "9003",
+							"Invalid arguments");
+
+	if (command_key && strlen(command_key) > 32)
+		return xml_create_generic_fault_message(t, true, "9003",
+							"Invalid arguments");
+
+	if (cwmp_schedule_inform(delay, command_key))
+		return xml_create_generic_fault_message(t, false, "9002",
+							"Internal error");
+
+	b = mxmlNewElement(t, "cwmp:ScheduleInformResponse");
 	if (!b) return -1;
 
 	return 0;
@@ -872,7 +1978,7 @@ static int xml_handle_factory_reset(mxml_node_t *node,
 	b = mxmlNewElement(b, "cwmp:FactoryResetResponse");
 	if (!b) return -1;
 
-	if (external_simple("factory_reset"))
+	if (deferred_add(DEFERRED_FACTORY_RESET, NULL))
 		return -1;
 
 	return 0;
@@ -890,7 +1996,8 @@ static int xml_handle_reboot(mxml_node_t *node,
 	b = mxmlNewElement(b, "cwmp:RebootResponse");
 	if (!b) return -1;
 
-	if (external_simple("reboot"))
+	/* the device must stay up until the session has been closed */
+	if (deferred_add(DEFERRED_REBOOT, NULL))
 		return -1;
 
 	return 0;
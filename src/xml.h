@@ -10,12 +10,21 @@
 #ifndef _FREECWMP_XML_H__
 #define _FREECWMP_XML_H__
 
+#include <time.h>
 #include <microxml.h>
 
 void xml_exit(void);
 
 int xml_prepare_inform_message(char **msg_out);
+int xml_prepare_heartbeat_message(char **msg_out);
 int xml_parse_inform_response_message(char *msg_in);
+int xml_prepare_transfer_complete_message(char *command_key,
+					  const char *fault_code,
+					  const char *fault_string,
+					  time_t start_time,
+					  time_t complete_time,
+					  char **msg_out);
+int xml_parse_transfer_complete_response_message(char *msg_in);
 int xml_handle_message(char *msg_in, char **msg_out);
 
 static int xml_handle_set_parameter_values(mxml_node_t *body_in,
@@ -26,14 +35,50 @@ static int xml_handle_get_parameter_values(mxml_node_t *body_in,
 					   mxml_node_t *tree_in,
 					   mxml_node_t *tree_out);
 
+static int xml_handle_get_parameter_names(mxml_node_t *body_in,
+					  mxml_node_t *tree_in,
+					  mxml_node_t *tree_out);
+
 static int xml_handle_set_parameter_attributes(mxml_node_t *body_in,
 					       mxml_node_t *tree_in,
 					       mxml_node_t *tree_out);
 
+static int xml_handle_get_parameter_attributes(mxml_node_t *body_in,
+					       mxml_node_t *tree_in,
+					       mxml_node_t *tree_out);
+
+static int xml_handle_add_object(mxml_node_t *body_in,
+				 mxml_node_t *tree_in,
+				 mxml_node_t *tree_out);
+
+static int xml_handle_delete_object(mxml_node_t *body_in,
+				    mxml_node_t *tree_in,
+				    mxml_node_t *tree_out);
+
 static int xml_handle_download(mxml_node_t *body_in,
 			       mxml_node_t *tree_in,
 			       mxml_node_t *tree_out);
 
+static int xml_handle_upload(mxml_node_t *body_in,
+			     mxml_node_t *tree_in,
+			     mxml_node_t *tree_out);
+
+static int xml_handle_get_queued_transfers(mxml_node_t *body_in,
+					   mxml_node_t *tree_in,
+					   mxml_node_t *tree_out);
+
+static int xml_handle_get_all_queued_transfers(mxml_node_t *body_in,
+					       mxml_node_t *tree_in,
+					       mxml_node_t *tree_out);
+
+static int xml_handle_cancel_transfer(mxml_node_t *body_in,
+				      mxml_node_t *tree_in,
+				      mxml_node_t *tree_out);
+
+static int xml_handle_schedule_inform(mxml_node_t *body_in,
+				      mxml_node_t *tree_in,
+				      mxml_node_t *tree_out);
+
 static int xml_handle_factory_reset(mxml_node_t *body_in,
 				    mxml_node_t *tree_in,
 				    mxml_node_t *tree_out);